@@ -0,0 +1,7 @@
+# config.h for CreateRemdDirs
+# configured using: ./configure -openmp gnu
+
+CXX=g++
+CXXFLAGS= -O3 -Wall -fopenmp -D_LARGEFILE_SOURCE -D_FILE_OFFSET_BITS=64 
+DIRECTIVES= -DHAS_ZLIB
+LDFLAGS=-fopenmp  -lz
@@ -0,0 +1,98 @@
+#include <cerrno>
+#include <cstdio>     // rename, remove
+#include <cstdlib>    // atol, atoll
+#include <cstring>    // strerror
+#include <sys/stat.h> // mkdir
+#include "ArchiveManifest.h"
+#include "TextFile.h"
+#include "FileRoutines.h"
+#include "Messages.h"
+
+using namespace Messages;
+
+/** Manifest file header; change version if format changes. */
+const char* ArchiveManifest::HEADER_ = "#RemdArchiveManifest v1";
+
+/** Directory (under the top directory) holding a manifest for each run. */
+const char* ArchiveManifest::DIR_ = ".remdarchive";
+
+/** Each run has its own manifest so that runs can be archived at the same time. */
+std::string ArchiveManifest::FileName(std::string const& runDir) {
+  return std::string(DIR_) + "/" + runDir + ".manifest";
+}
+
+/** Read manifest. It is not an error if the file does not exist or is from
+  * an incompatible version; the manifest will just start empty and every
+  * file will be archived again.
+  */
+int ArchiveManifest::Read(std::string const& fname) {
+  entries_.clear();
+  dirty_ = false;
+  if (!FileRoutines::fileExists(fname)) return 0;
+  TextFile infile;
+  if (infile.OpenRead( fname )) return 1;
+  std::string header = infile.GetString();
+  if (header != HEADER_) {
+    Msg("Warning: Ignoring archive manifest '%s' with unrecognized header.\n", fname.c_str());
+    infile.Close();
+    return 0;
+  }
+  const char* SEP = " \t\n";
+  int ncols = infile.GetColumns( SEP );
+  while (ncols > -1) {
+    if (ncols == 5) {
+      Entry entry;
+      entry.size_    = atoll( infile.Token(1).c_str() );
+      entry.mtime_   = atol( infile.Token(2).c_str() );
+      entry.hash_    = infile.Token(3);
+      entry.archive_ = infile.Token(4);
+      entries_[ infile.Token(0) ] = entry;
+    } else if (ncols > 0)
+      Msg("Warning: Skipping malformed line in archive manifest '%s'\n", fname.c_str());
+    ncols = infile.GetColumns( SEP );
+  }
+  infile.Close();
+  return 0;
+}
+
+/** Write manifest to a temporary file and rename it, so an interrupted
+  * write leaves the previous manifest intact.
+  */
+int ArchiveManifest::Write(std::string const& fname) const {
+  if (!dirty_) return 0;
+  // Runs may be archived at the same time; another may have made the dir.
+  if (mkdir( DIR_, S_IRWXU ) != 0 && errno != EEXIST) {
+    ErrorMsg("Creating dir '%s': %s\n", DIR_, strerror( errno ));
+    return 1;
+  }
+  std::string tmpName( fname + ".tmp" );
+  TextFile outfile;
+  if (outfile.OpenWrite( tmpName )) return 1;
+  outfile.Printf("%s\n", HEADER_);
+  for (EntryMap::const_iterator it = entries_.begin(); it != entries_.end(); ++it)
+    outfile.Printf("%s %lli %li %s %s\n", it->first.c_str(), it->second.size_,
+                   it->second.mtime_, it->second.hash_.c_str(), it->second.archive_.c_str());
+  if (outfile.Close()) {
+    ErrorMsg("Could not write '%s'; previous manifest '%s' kept.\n", tmpName.c_str(), fname.c_str());
+    remove( tmpName.c_str() );
+    return 1;
+  }
+  if (rename( tmpName.c_str(), fname.c_str() ) != 0) {
+    ErrorMsg("Could not rename '%s' to '%s': %s\n", tmpName.c_str(), fname.c_str(),
+             strerror( errno ));
+    return 1;
+  }
+  FileRoutines::InvalidateStat( fname );
+  return 0;
+}
+
+ArchiveManifest::Entry const* ArchiveManifest::Find(std::string const& fname) const {
+  EntryMap::const_iterator it = entries_.find( fname );
+  if (it == entries_.end()) return 0;
+  return &(it->second);
+}
+
+void ArchiveManifest::Add(std::string const& fname, Entry const& entry) {
+  entries_[ fname ] = entry;
+  dirty_ = true;
+}
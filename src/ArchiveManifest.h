@@ -0,0 +1,48 @@
+#ifndef INC_ARCHIVEMANIFEST_H
+#define INC_ARCHIVEMANIFEST_H
+#include <string>
+#include <map>
+/// Record of the files of a run that have been archived and where they went.
+/** Each file (name relative to the top directory) is recorded with its size,
+  * modification time, xxHash64 of its contents, and the archive it was
+  * written to. Trajectories that are not archived themselves are recorded
+  * with size and modification time only, so it can be seen whether the
+  * sorted/stripped trajectories made from them are still current.
+  */
+class ArchiveManifest {
+  public:
+    /// Info for a single file.
+    class Entry {
+      public:
+        Entry() : size_(0), mtime_(0) {}
+        long long int size_; ///< File size in bytes.
+        long int mtime_;     ///< File modification time.
+        std::string hash_;   ///< xxHash64 of file contents, '-' if not hashed.
+        std::string archive_; ///< Archive file was written to, '-' if not archived.
+    };
+    typedef std::map<std::string, Entry> EntryMap;
+
+    ArchiveManifest() : dirty_(false) {}
+    /// \return Name of the manifest file for the given run directory.
+    static std::string FileName(std::string const&);
+    /// Read manifest from given file if present.
+    int Read(std::string const&);
+    /// Write manifest to given file if it has changed.
+    int Write(std::string const&) const;
+    /// \return Entry for given file name, 0 if not present.
+    Entry const* Find(std::string const&) const;
+    /// Add/replace entry for given file name.
+    void Add(std::string const&, Entry const&);
+    /// \return Number of entries in manifest.
+    unsigned int Size()  const { return entries_.size(); }
+
+    EntryMap::const_iterator begin() const { return entries_.begin(); }
+    EntryMap::const_iterator end()   const { return entries_.end();   }
+  private:
+    static const char* HEADER_;
+    static const char* DIR_;
+
+    EntryMap entries_; ///< Entries keyed on file name.
+    bool dirty_;       ///< True if manifest has changed since it was read.
+};
+#endif
@@ -0,0 +1,163 @@
+#include <cerrno>
+#include <cstdio>  // rename, remove
+#include <cstdlib> // atoi, atof
+#include <cstring> // strerror
+#include <sstream> // ostringstream
+#include <sys/stat.h>
+#include "CheckCache.h"
+#include "TextFile.h"
+#include "FileRoutines.h"
+#include "Messages.h"
+
+using namespace Messages;
+
+/** Cache file header; change version if format changes. */
+const char* CheckCache::HEADER_ = "#RemdCheckCache v4";
+
+const char* CheckCache::Entry::RoutineName(int r) {
+  static const char* NAMES[] = { "Nonbond", "Bond", "Angle", "Dihedral", "Shake",
+                                 "RunMD", "Other" };
+  return NAMES[r];
+}
+
+/** \return Nanoseconds part of modification time, 0 if not available. */
+static inline long int MtimeNsec(struct stat const& file_stat) {
+# if defined(__linux__)
+  return (long int)file_stat.st_mtim.tv_nsec;
+# elif defined(__APPLE__)
+  return (long int)file_stat.st_mtimespec.tv_nsec;
+# else
+  return 0;
+# endif
+}
+
+/** Key is formatted as '<inode>:<size>:<mtime>.<mtime nsec>', so a file
+  * rewritten to the same size within the same second gets a new key.
+  */
+std::string CheckCache::FileKey(std::string const& fname) {
+  struct stat file_stat;
+  if (stat(fname.c_str(), &file_stat) != 0) return std::string();
+  std::ostringstream oss;
+  oss << file_stat.st_ino << ':' << file_stat.st_size << ':' << file_stat.st_mtime
+      << '.' << MtimeNsec(file_stat);
+  return oss.str();
+}
+
+/** Read cache. It is not an error if the file does not exist or is
+  * from an incompatible version; the cache will just start empty.
+  */
+int CheckCache::Read(std::string const& fname) {
+  entries_.clear();
+  dirty_ = false;
+  if (!FileRoutines::fileExists(fname)) return 0;
+  TextFile infile;
+  if (infile.OpenRead( fname )) return 1;
+  std::string header = infile.GetString();
+  if (header != HEADER_) {
+    Msg("Warning: Ignoring check cache '%s' with unrecognized header.\n", fname.c_str());
+    infile.Close();
+    return 0;
+  }
+  const char* SEP = " \t\n";
+  int ncols = infile.GetColumns( SEP );
+  while (ncols > -1) {
+    if (ncols == 15 + Entry::NROUTINES) {
+      Entry entry;
+      entry.outKey_    = infile.Token(1);
+      entry.trajKey_   = infile.Token(2);
+      entry.nstlim_    = atoi( infile.Token(3).c_str() );
+      entry.dt_        = atof( infile.Token(4).c_str() );
+      entry.numexchg_  = atoi( infile.Token(5).c_str() );
+      entry.ntwx_      = atoi( infile.Token(6).c_str() );
+      entry.completed_ = (atoi( infile.Token(7).c_str() ) != 0);
+      entry.frames_    = atoi( infile.Token(8).c_str() );
+      entry.hasTime_   = (atoi( infile.Token(9).c_str() ) != 0);
+      entry.timeFirst_ = atof( infile.Token(10).c_str() );
+      entry.timeLast_  = atof( infile.Token(11).c_str() );
+      entry.hasTimings_ = (atoi( infile.Token(12).c_str() ) != 0);
+      entry.nsPerDay_  = atof( infile.Token(13).c_str() );
+      entry.elapsed_   = atof( infile.Token(14).c_str() );
+      for (int r = 0; r != Entry::NROUTINES; r++)
+        entry.routineSec_[r] = atof( infile.Token(15+r).c_str() );
+      entries_[ infile.Token(0) ] = entry;
+    } else if (ncols > 0)
+      Msg("Warning: Skipping malformed line in check cache '%s'\n", fname.c_str());
+    ncols = infile.GetColumns( SEP );
+  }
+  infile.Close();
+  return 0;
+}
+
+/** Write cache to a temporary file and rename it, so an interrupted write
+  * leaves the previous cache intact.
+  */
+int CheckCache::Write(std::string const& fname) const {
+  if (!dirty_) return 0;
+  std::string tmpName( fname + ".tmp" );
+  TextFile outfile;
+  if (outfile.OpenWrite( tmpName )) return 1;
+  outfile.Printf("%s\n", HEADER_);
+  for (EntryMap::const_iterator it = entries_.begin(); it != entries_.end(); ++it)
+  {
+    Entry const& entry = it->second;
+    outfile.Printf("%s %s %s %i %.17g %i %i %i %i %i %.17g %.17g %i %.17g %.17g", it->first.c_str(),
+                   entry.outKey_.c_str(), entry.trajKey_.c_str(), entry.nstlim_,
+                   entry.dt_, entry.numexchg_, entry.ntwx_, (int)entry.completed_,
+                   entry.frames_, (int)entry.hasTime_, entry.timeFirst_, entry.timeLast_,
+                   (int)entry.hasTimings_, entry.nsPerDay_, entry.elapsed_);
+    for (int r = 0; r != Entry::NROUTINES; r++)
+      outfile.Printf(" %.17g", entry.routineSec_[r]);
+    outfile.Printf("\n");
+  }
+  if (outfile.Close()) {
+    ErrorMsg("Could not write '%s'; previous cache '%s' kept.\n", tmpName.c_str(), fname.c_str());
+    remove( tmpName.c_str() );
+    return 1;
+  }
+  if (rename( tmpName.c_str(), fname.c_str() ) != 0) {
+    ErrorMsg("Could not rename '%s' to '%s': %s\n", tmpName.c_str(), fname.c_str(),
+             strerror( errno ));
+    return 1;
+  }
+  FileRoutines::InvalidateStat( fname );
+  return 0;
+}
+
+CheckCache::Entry const* CheckCache::Find(std::string const& outName,
+                                          std::string const& outKey,
+                                          std::string const& trajKey) const
+{
+  if (outKey.empty() || trajKey.empty()) return 0;
+  EntryMap::const_iterator it = entries_.find( outName );
+  if (it == entries_.end()) return 0;
+  if (it->second.outKey_ != outKey || it->second.trajKey_ != trajKey) return 0;
+  return &(it->second);
+}
+
+void CheckCache::Add(std::string const& outName, Entry const& entry) {
+  if (entry.outKey_.empty() || entry.trajKey_.empty()) return;
+  entries_[ outName ] = entry;
+  dirty_ = true;
+}
+
+/** Entries are named '<run dir>/...'; each run directory is checked once. */
+unsigned int CheckCache::Prune(std::string const& topDir) {
+  std::map<std::string, bool> runExists;
+  unsigned int nremoved = 0;
+  EntryMap::iterator it = entries_.begin();
+  while (it != entries_.end()) {
+    std::string runDir = it->first.substr(0, it->first.find('/'));
+    std::map<std::string, bool>::const_iterator run = runExists.find( runDir );
+    if (run == runExists.end())
+      run = runExists.insert( std::pair<std::string, bool>(runDir,
+                              FileRoutines::fileExists( topDir + "/" + runDir )) ).first;
+    if (run->second)
+      ++it;
+    else {
+      entries_.erase( it++ );
+      ++nremoved;
+    }
+  }
+  if (nremoved > 0) dirty_ = true;
+  return nremoved;
+}
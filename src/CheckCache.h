@@ -0,0 +1,67 @@
+#ifndef INC_CHECKCACHE_H
+#define INC_CHECKCACHE_H
+#include <string>
+#include <map>
+/// Persistent cache of info obtained from checking output/trajectory files.
+/** Each output/trajectory file pair is keyed on the output file name
+  * (relative to the top directory) and on the inode, size, and modification
+  * time of both files, so only files which have changed since the last
+  * check need to be examined again.
+  */
+class CheckCache {
+  public:
+    /// Info from a single output/trajectory file pair.
+    class Entry {
+      public:
+        /// Routines in the MDOUT 'NonSetup CPU Time in Major Routines' table.
+        enum RoutineType { NONBOND = 0, BOND, ANGLE, DIHEDRAL, SHAKE, RUNMD, OTHER, NROUTINES };
+        /// \return Name of routine as it appears in MDOUT.
+        static const char* RoutineName(int);
+
+        Entry() : nstlim_(0), dt_(0.0), numexchg_(0), ntwx_(0), frames_(-1), completed_(false),
+                  timeFirst_(0.0), timeLast_(0.0), hasTime_(false), nsPerDay_(0.0),
+                  elapsed_(0.0), hasTimings_(false)
+        {
+          for (int i = 0; i != NROUTINES; i++) routineSec_[i] = 0.0;
+        }
+
+        std::string outKey_;  ///< Output file inode/size/mtime key.
+        std::string trajKey_; ///< Trajectory file inode/size/mtime key.
+        int nstlim_;          ///< Number of steps (per exchange if REMD).
+        double dt_;           ///< Time step.
+        int numexchg_;        ///< Number of exchanges (REMD).
+        int ntwx_;            ///< Trajectory write frequency.
+        int frames_;          ///< Actual number of frames in trajectory, -1 if not checked.
+        bool completed_;      ///< True if output file indicates run completed.
+        double timeFirst_;    ///< Time of first trajectory frame.
+        double timeLast_;     ///< Time of last trajectory frame.
+        bool hasTime_;        ///< True if first/last frame times were read.
+        double nsPerDay_;     ///< Average ns/day from MDOUT timings.
+        double elapsed_;      ///< Elapsed wall time (s) from MDOUT timings.
+        double routineSec_[NROUTINES]; ///< CPU time (s) in each major routine.
+        bool hasTimings_;     ///< True if MDOUT timings were read.
+    };
+
+    CheckCache() : dirty_(false) {}
+    /// \return Key based on given file inode/size/mtime; empty if file cannot be stat'd.
+    static std::string FileKey(std::string const&);
+    /// Read cache from given file if present.
+    int Read(std::string const&);
+    /// Write cache to given file if it has changed.
+    int Write(std::string const&) const;
+    /// \return Entry for given output name if output/traj keys match, 0 otherwise.
+    Entry const* Find(std::string const&, std::string const&, std::string const&) const;
+    /// Add/replace entry for given output name.
+    void Add(std::string const&, Entry const&);
+    /// Remove entries for run directories no longer under given top directory. \return # removed.
+    unsigned int Prune(std::string const&);
+    /// \return Number of entries in cache.
+    unsigned int Size()  const { return entries_.size(); }
+  private:
+    typedef std::map<std::string, Entry> EntryMap;
+    static const char* HEADER_;
+
+    EntryMap entries_; ///< Cache entries keyed on output file name.
+    bool dirty_;       ///< True if cache has changed since it was read.
+};
+#endif
@@ -1,48 +1,222 @@
 #include <cmath>
+#include <cfloat>  // DBL_MAX
+#include <cstdio>  // vsnprintf
+#include <cstdarg>
 #include <cstdlib>
-#include <cstring> // strncmp
-#ifdef HAS_NETCDF
-# include "netcdf.h"
+#include <algorithm> // std::min, std::sort
+#include <vector>
+#ifdef _OPENMP
+# include <omp.h>
 #endif
 #include "CheckRuns.h"
+#include "Profile.h"
 #include "Messages.h"
 #include "TextFile.h"
+#include "NetcdfFile.h"
+#include "Rst7File.h"
 
 using namespace Messages;
 using namespace FileRoutines;
 
+// =============================================================================
+/** Hold check results for a single replica for machine-readable output.
+  * File names are relative to the top directory.
+  */
+class CheckRuns::RepRecord {
+  public:
+    RepRecord() : time_(0.0), frames_(0), expected_(0), rstTime_(0.0), completed_(false),
+                  problem_(false), hasRstTime_(false) {}
+    /// \return Replica status: 'incomplete', 'problem', 'warning', or 'ok'.
+    const char* Status() const {
+      if (!completed_)         return "incomplete";
+      if (problem_)            return "problem";
+      if (!warnings_.empty())  return "warning";
+      return "ok";
+    }
+
+    std::string outName_;  ///< Output file.
+    std::string trajName_; ///< Trajectory file.
+    std::string rstName_;  ///< Restart file, if checked.
+    StrArray warnings_;    ///< Any problems/warnings for this replica.
+    double time_;          ///< Expected total time (ps).
+    int frames_;           ///< Actual frames.
+    int expected_;         ///< Expected frames.
+    double rstTime_;       ///< Restart time, if checked.
+    bool completed_;       ///< True if output is complete.
+    bool problem_;         ///< True if a potential issue was found.
+    bool hasRstTime_;      ///< True if restart was checked.
+};
+
+// =============================================================================
+/** Hold output generated while checking a single run. Since runs may be
+  * checked in parallel, output is buffered here and printed in run order
+  * once all checks are complete.
+  */
+class CheckRuns::ResultType {
+  public:
+    ResultType() : nwarnings_(0), stat_(0), ncacheHit_(0) {}
+    /// Buffer formatted message.
+    void Msg(const char*, ...);
+    /// Buffer formatted error message.
+    void ErrorMsg(const char*, ...);
+    /// Print all buffered messages in order.
+    void Print() const;
+    /// Add messages and warnings from another result.
+    void Append(ResultType const& rhs) {
+      lines_.insert( lines_.end(), rhs.lines_.begin(), rhs.lines_.end() );
+      nwarnings_ += rhs.nwarnings_;
+    }
+    /// Record info for given output file to be added to the cache.
+    void AddCacheEntry(std::string const& n, CheckCache::Entry const& e) {
+      newEntries_.push_back( CachePair(n, e) );
+    }
+    /// Record a cache hit.
+    void AddCacheHit() { ++ncacheHit_; }
+    /// Increment warning count.
+    void AddWarning() { ++nwarnings_; }
+    /// Set run status: 0 = ok, 1 = potential issues, -1 = error.
+    void SetStat(int s) { stat_ = s; }
+    /// Record info for replica (in order) for checking time continuity.
+    void AddRep(CheckCache::Entry const& e) { reps_.push_back( e ); }
+    /// Record results for replica (in order) for machine-readable output.
+    void AddRecord(RepRecord const& r) { records_.push_back( r ); }
+    /// Get error and warning messages, without prefix and newline.
+    void Issues(StrArray&, StrArray&) const;
+
+    /// Pair output file name with cache entry.
+    typedef std::pair<std::string, CheckCache::Entry> CachePair;
+    typedef std::vector<CachePair> CacheArray;
+    typedef std::vector<CheckCache::Entry> EntryArray;
+    typedef std::vector<RepRecord> RecordArray;
+
+    int Nwarnings()                 const { return nwarnings_;   }
+    int Stat()                      const { return stat_;        }
+    unsigned int NcacheHit()        const { return ncacheHit_;   }
+    CacheArray const& NewEntries()  const { return newEntries_;  }
+    EntryArray const& Reps()        const { return reps_;        }
+    RecordArray const& Records()    const { return records_;     }
+    RecordArray& Records()                { return records_;     }
+  private:
+    /// Pair message with whether it is an error.
+    typedef std::pair<bool, std::string> LineType;
+    typedef std::vector<LineType> LineArray;
+
+    void AddLine(bool, const char*, va_list);
+
+    LineArray lines_; ///< Buffered messages.
+    int nwarnings_;   ///< Number of warnings encountered for run.
+    int stat_;        ///< Overall run status.
+    CacheArray newEntries_;  ///< Info to be added to cache.
+    unsigned int ncacheHit_; ///< Number of output/traj pairs found in cache.
+    EntryArray reps_;        ///< Info for each replica checked.
+    RecordArray records_;    ///< Results for each replica checked.
+};
+
+void CheckRuns::ResultType::AddLine(bool isError, const char* format, va_list args) {
+  char buffer[1024];
+  int len = vsnprintf(buffer, 1024, format, args);
+  if (len < 0) return;
+  if (len > 1023) len = 1023;
+  lines_.push_back( LineType(isError, std::string(buffer, len)) );
+}
+
+void CheckRuns::ResultType::Msg(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  AddLine(false, format, args);
+  va_end(args);
+}
+
+void CheckRuns::ResultType::ErrorMsg(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  AddLine(true, format, args);
+  va_end(args);
+}
+
+void CheckRuns::ResultType::Print() const {
+  for (LineArray::const_iterator it = lines_.begin(); it != lines_.end(); ++it) {
+    if (it->first)
+      Messages::ErrorMsg("%s", it->second.c_str());
+    else
+      Messages::Msg("%s", it->second.c_str());
+  }
+}
+
+void CheckRuns::ResultType::Issues(StrArray& errors, StrArray& warnings) const {
+  static const std::string WARNING = "Warning: ";
+  for (LineArray::const_iterator it = lines_.begin(); it != lines_.end(); ++it) {
+    std::string line = it->second;
+    size_t end = line.find_last_not_of("\n");
+    if (end == std::string::npos) continue;
+    line.resize( end + 1 );
+    if (it->first)
+      errors.push_back( line );
+    else if (line.compare(0, WARNING.size(), WARNING) == 0)
+      warnings.push_back( line.substr(WARNING.size()) );
+  }
+}
+
+// =============================================================================
+/** Hold info obtained from a single output/trajectory file pair. */
+class CheckRuns::RepInfo : public CheckCache::Entry {
+  public:
+    RepInfo() : err_(0), cached_(false) {}
+
+    int err_;            ///< 0 = ok, 1 = could not open output, 2 = could not open traj, -1 = error
+    bool cached_;        ///< True if info came from the check cache.
+    std::string ncErr_;  ///< Any error reading trajectory.
+};
+
+// =============================================================================
+/** Hold info obtained from a single REMD restart file. */
+class CheckRuns::RstInfo {
+  public:
+    RstInfo() : time_(-1.0), err_(0), hasTime_(false) {}
+
+    double time_;    ///< Restart time.
+    int err_;        ///< 0 = ok, 1 = possible issue, -1 = error
+    ResultType res_; ///< Messages from checking coordinates/velocities.
+    bool hasTime_;   ///< True if time could be read.
+};
+
+// =============================================================================
+/** Persistent check cache file name, in top directory. */
+const char* CheckRuns::CACHE_NAME_ = ".remdcheck.cache";
+
 /** CONSTRUCTOR */
 CheckRuns::CheckRuns() :
-  debug_(0)
+  debug_(0),
+  nthreads_(1),
+  useCache_(true),
+  deepScan_(false),
+  reportTimings_(false),
+  format_(TEXT)
 {}
 
-#ifdef HAS_NETCDF
-int CheckRuns::checkNCerr(int ncerr) {
-  if ( ncerr != NC_NOERR ) {
-    ErrorMsg("NETCDF: %s\n", nc_strerror(ncerr));
+int CheckRuns::SetFormat(std::string const& fmt) {
+  if (fmt == "text")
+    format_ = TEXT;
+  else if (fmt == "json")
+    format_ = JSON;
+  else if (fmt == "csv")
+    format_ = CSV;
+  else
     return 1;
-  }
   return 0;
 }
 
-int CheckRuns::GetDimInfo(int ncid, const char* attribute, int& length) {
-  int dimID;
-  size_t slength = 0;
-  length = 0;
-  // Get dimid 
-  if ( checkNCerr(nc_inq_dimid(ncid, attribute, &dimID)) ) {
-    ErrorMsg("Getting dimID for attribute %s\n", attribute);
-    return -1;
-  }
-  // get Dim length 
-  if ( checkNCerr(nc_inq_dimlen(ncid, dimID, &slength)) ) {
-    ErrorMsg("Getting length for attribute %s\n",attribute);
-    return -1;
-  }
-  length = (int) slength;
-  return dimID;
+/** \return String formatted like printf. */
+static std::string FormatStr(const char* format, ...) {
+  char buffer[1024];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(buffer, 1024, format, args);
+  va_end(args);
+  if (len < 0) return std::string();
+  if (len > 1023) len = 1023;
+  return std::string(buffer, len);
 }
-#endif
 
 std::string CheckRuns::Ext(std::string const& name) {
   size_t found = name.find_last_of(".");
@@ -54,289 +228,627 @@ std::string CheckRuns::Ext(std::string const& name) {
 /** Given two arrays of file names of different size try to determine
   * where they differ based on extension.
   */
-void CheckRuns::CompareStrArray(StrArray const& a1, StrArray const& a2) {
+void CheckRuns::CompareStrArray(StrArray const& a1, StrArray const& a2, ResultType& res) {
   unsigned int max = (unsigned int)std::min(a1.size(), a2.size());
   unsigned int idx = 0;
   for (idx = 0; idx != max; idx++) {
     std::string e1 = Ext(a1[idx]);
     std::string e2 = Ext(a2[idx]);
     if (e1 != e2) {
-      ErrorMsg("Differs at '%s', '%s'\n", a1[idx].c_str(), a2[idx].c_str());
+      res.ErrorMsg("Differs at '%s', '%s'\n", a1[idx].c_str(), a2[idx].c_str());
       return;
     }
   }
   if (idx < a1.size())
-    ErrorMsg("Differs at '%s'\n", a1[idx].c_str());
+    res.ErrorMsg("Differs at '%s'\n", a1[idx].c_str());
   if (idx < a2.size())
-    ErrorMsg("Differs at '%s'\n", a2[idx].c_str());
+    res.ErrorMsg("Differs at '%s'\n", a2[idx].c_str());
+}
+
+/** Max allowed coordinate magnitude in a restart, in box lengths. Amber
+  * does not wrap coordinates by default, so allow a few box lengths of
+  * diffusion out of the primary cell.
+  */
+static const double MAX_BOX_DISPLACEMENT = 5.0;
+/** Max allowed velocity component in a restart (Amber default vlimit). */
+static const double MAX_VELOCITY = 20.0;
+/** Number of atoms to read at once when scanning restarts. */
+static const long int SCAN_CHUNK = 8192;
+
+/** \return Number of atoms with an XYZ component that is not finite or whose
+  *         magnitude exceeds the corresponding limit. Branch-free so that it
+  *         can be vectorized.
+  */
+static inline long int CountBadAtoms(const double* xyz, long int natom, const double* limit)
+{
+  const double lx = limit[0];
+  const double ly = limit[1];
+  const double lz = limit[2];
+  long int nbad = 0;
+# if defined(_OPENMP) && _OPENMP >= 201307
+# pragma omp simd reduction(+:nbad)
+# endif
+  for (long int at = 0; at < natom; at++) {
+    const double* v = xyz + (3*at);
+    // Limits are finite and comparisons with NaN are false, so non-finite
+    // values always fail.
+    int ok = (fabs(v[0]) <= lx) & (fabs(v[1]) <= ly) & (fabs(v[2]) <= lz);
+    nbad += 1 - ok;
+  }
+  return nbad;
+}
+
+/** \return Index of first atom with a bad XYZ component, -1 if none. */
+static long int FirstBadAtom(const double* xyz, long int natom, const double* limit)
+{
+  for (long int at = 0; at < natom; at++) {
+    const double* v = xyz + (3*at);
+    if ( !(fabs(v[0]) <= limit[0] && fabs(v[1]) <= limit[1] && fabs(v[2]) <= limit[2]) )
+      return at;
+  }
+  return -1;
+}
+
+/** \return Prefix for errors from given restart file type. */
+static inline const char* RstErrPrefix(NetcdfFile const&) { return "NETCDF"; }
+static inline const char* RstErrPrefix(Rst7File const&) { return "RST7"; }
+
+/** Scan all coordinates (and velocities if present) in given restart.
+  * Coordinates must be finite and, if box info is present, within
+  * MAX_BOX_DISPLACEMENT box lengths of the origin; without box info any
+  * finite coordinate is allowed. Velocity components must
+  * be finite and no larger than MAX_VELOCITY.
+  * \return 0 if OK, 1 if bad coordinates found, -1 if error.
+  */
+template <class RstFile>
+int CheckRuns::DeepScanRestart(RstFile& rstfile, std::string const& fname, long int natom,
+                               ResultType& res)
+{
+  // DBL_MAX, not HUGE_VAL, so that +/-Inf exceeds the limit.
+  double climit[3];
+  climit[0] = climit[1] = climit[2] = DBL_MAX;
+  if ( rstfile.HasVar("cell_lengths") ) {
+    if ( rstfile.GetVar("cell_lengths", 0, 0, 3, climit) ) {
+      res.ErrorMsg("%s: %s\n", RstErrPrefix(rstfile), rstfile.Error().c_str());
+      return -1;
+    }
+    for (int i = 0; i < 3; i++)
+      climit[i] *= MAX_BOX_DISPLACEMENT;
+  }
+  double vlimit[3];
+  vlimit[0] = vlimit[1] = vlimit[2] = MAX_VELOCITY;
+
+  static const char* VarNames[] = { "coordinates", "velocities" };
+  const double* Limits[] = { climit, vlimit };
+  std::vector<double> buf( 3 * std::min(natom, SCAN_CHUNK) );
+  int err = 0;
+  for (int iv = 0; iv < 2; iv++) {
+    if (iv > 0 && !rstfile.HasVar( VarNames[iv] )) continue;
+    long int nbad = 0;
+    long int firstBad = -1;
+    for (long int at0 = 0; at0 < natom; at0 += SCAN_CHUNK) {
+      long int nat = std::min(SCAN_CHUNK, natom - at0);
+      if ( rstfile.GetVar(VarNames[iv], 0, 3*at0, 3*nat, &buf[0]) ) {
+        res.ErrorMsg("%s: %s\n", RstErrPrefix(rstfile), rstfile.Error().c_str());
+        return -1;
+      }
+      long int nbadChunk = CountBadAtoms( &buf[0], nat, Limits[iv] );
+      if (nbadChunk > 0 && firstBad < 0)
+        firstBad = at0 + FirstBadAtom( &buf[0], nat, Limits[iv] );
+      nbad += nbadChunk;
+    }
+    if (nbad > 0) {
+      if (iv == 0) {
+        res.ErrorMsg("%li atoms in restart '%s' have non-finite or out-of-box coordinates"
+                     " (first is atom %li). Probable corruption.\n",
+                     nbad, fname.c_str(), firstBad+1);
+        err = 1;
+      } else {
+        res.Msg("Warning: %li atoms in restart '%s' have non-finite velocities or a"
+                " component > %g (first is atom %li).\n", nbad, fname.c_str(), MAX_VELOCITY, firstBad+1);
+        res.AddWarning();
+      }
+    }
+  }
+  return err;
+}
+
+/** Get time from given open REMD restart and check its coordinates. The
+  * first two coordinates are checked for overlap; if deepScan_ is set, all
+  * coordinates and velocities are scanned.
+  */
+template <class RstFile>
+void CheckRuns::CheckRestartFile(RstFile& rstfile, std::string const& rfile, RstInfo& info) const
+{
+  ResultType& res = info.res_;
+  if ( rstfile.GetVar("time", 0, 0, 1, &info.time_) != 0 ) {
+    res.ErrorMsg("%s: %s\n", RstErrPrefix(rstfile), rstfile.Error().c_str());
+    info.err_ = -1;
+    return;
+  }
+  info.hasTime_ = true;
+  // Check first 2 coordinates
+  long int natom = rstfile.DimLength("atom");
+  if (natom < 0) {
+    res.ErrorMsg("Getting length for dimension atom in '%s'\n", rfile.c_str());
+    info.err_ = -1;
+    return;
+  }
+  if (natom > 1) {
+    double Coords[6]; // Hold first 2 coord sets
+    if ( rstfile.GetVar("coordinates", 0, 0, 6, Coords) ) {
+      res.ErrorMsg("%s: %s\n", RstErrPrefix(rstfile), rstfile.Error().c_str());
+      info.err_ = -1;
+      return;
+    }
+    // Calculate distance
+    double dx = Coords[0] - Coords[3];
+    double dy = Coords[1] - Coords[4];
+    double dz = Coords[2] - Coords[5];
+    double dist2 = (dx * dx) + (dy * dy) + (dz * dz);
+    if (dist2 < 0.0001) {
+      res.ErrorMsg("First two coordinates in restart '%s' overlap. Probable corruption.\n",
+                   rfile.c_str());
+      info.err_ = 1;
+      return;
+    }
+    // Get box info if present
+    if ( rstfile.HasVar("cell_lengths") ) {
+      if ( rstfile.GetVar("cell_lengths", 0, 0, 3, Coords) ) {
+        res.ErrorMsg("%s: %s\n", RstErrPrefix(rstfile), rstfile.Error().c_str());
+        info.err_ = -1;
+        return;
+      }
+      // Calc max distance allowed by box
+      double box2 = (Coords[0]*Coords[0]) + (Coords[1]*Coords[1]) + (Coords[2]*Coords[2]);
+      if (dist2 > box2) {
+        res.ErrorMsg("First two coordinates distance > box size in restart '%s'."
+                     " Probable corruption.\n", rfile.c_str());
+        info.err_ = 1;
+        return;
+      }
+    }
+  }
+  if (deepScan_)
+    info.err_ = DeepScanRestart( rstfile, rfile, natom, res );
+}
+
+/** Check given REMD restart, which may be NetCDF or ASCII. Nothing is
+  * printed so that restarts may be checked in parallel.
+  */
+void CheckRuns::CheckRestart(std::string const& rfile, RstInfo& info) const {
+  Profile::Timer timer("read restart");
+  NetcdfFile ncfile;
+  int ncerr = ncfile.Open( rfile );
+  if (ncerr == 0) {
+    CheckRestartFile( ncfile, rfile, info );
+    return;
+  } else if (ncerr == 2) {
+    // Not NetCDF; try ASCII.
+    Rst7File rst7;
+    if (rst7.Open( rfile ) == 0) {
+      CheckRestartFile( rst7, rfile, info );
+      return;
+    }
+    info.res_.ErrorMsg("RST7: %s\n", rst7.Error().c_str());
+  } else
+    info.res_.ErrorMsg("NETCDF: %s\n", ncfile.Error().c_str());
+  info.err_ = -1;
 }
 
 /** Check that number of REMD restarts matches number of output files
-  * and that final restart times are the same.
+  * and that final restart times are the same. Restarts are read in
+  * parallel; results are reported in file order.
+  * \param rdir Run directory prefix (with trailing slash).
   * \return 0 if OK, 1 if possible issue, -1 if error.
   */
-int CheckRuns::CheckRemdRestarts(StrArray const& output_files) {
-  StrArray restart_files = ExpandToFilenames("RST/*.rst7");
-  if (restart_files.empty())
-    restart_files = ExpandToFilenames("RST/*.ncrst");
+int CheckRuns::CheckRemdRestarts(std::string const& rdir, StrArray const& output_files,
+                                 ResultType& res) const
+{
+  StrArray restart_files = ExpandToFilenames(rdir + "RST/*.rst7", false);
+  if (restart_files.empty()) {
+    res.Msg("Warning: %sRST/*.rst7 matches no files.\n", rdir.c_str());
+    restart_files = ExpandToFilenames(rdir + "RST/*.ncrst", false);
+  }
   if (restart_files.size() != output_files.size()) {
-    ErrorMsg("Number of restart files %zu != # output files %zu\n",
+    res.ErrorMsg("Number of restart files %zu != # output files %zu\n",
              restart_files.size(), output_files.size());
-    CompareStrArray( restart_files, output_files );
-    //*runStat = false;
+    CompareStrArray( restart_files, output_files, res );
     return 1;
   }
-# ifdef HAS_NETCDF
+  int nrst = (int)restart_files.size();
+  std::vector<RstInfo> Info( nrst );
+  int idx;
+# ifdef _OPENMP
+  // This region is only active if runs/replicas are not already being checked in parallel.
+# pragma omp parallel for num_threads(nthreads_) schedule(dynamic) if (nthreads_ > 1 && nrst > 1)
+# endif
+  for (idx = 0; idx < nrst; idx++)
+    CheckRestart( restart_files[idx], Info[idx] );
+
   double rst_time0 = 0.0;
-  for (StrArray::const_iterator rfile = restart_files.begin();
-                                rfile != restart_files.end(); ++rfile)
+  ResultType::RecordArray& records = res.Records();
+  for (idx = 0; idx < nrst; idx++)
   {
-    int ncid = -1, timeVID = -1;
-    double rsttime = -1.0;
-    if ( checkNCerr(nc_open(rfile->c_str(), NC_NOWRITE, &ncid)) ) return -1; // TODO Ascii
-    if ( checkNCerr(nc_inq_varid(ncid, "time", &timeVID)      ) ) return -1;
-    if ( checkNCerr(nc_get_var_double(ncid, timeVID, &rsttime)) ) return -1;
-    if (rfile == restart_files.begin()) {
-      rst_time0 = rsttime;
-      Msg("\tInitial restart time: %g\n", rst_time0);
-    } else if ( fabs(rst_time0 - rsttime) > 0.00000000000001 ) {
-      ErrorMsg("File '%s' time %g does not match initial restart time %g\n",
-               rfile->c_str(), rsttime, rst_time0);
-      //*runStat = false;
-      return 1;
+    RstInfo const& info = Info[idx];
+    if (!info.hasTime_) {
+      res.Append( info.res_ );
+      return -1;
     }
-    // Check first 2 coordinates
-    int natom;
-    int atomDID = GetDimInfo(ncid, "atom", natom);
-    if (atomDID < 0) return -1;
-    if (natom > 1) {
-      size_t start[2], count[2];
-      int coordVID = -1;
-      if ( checkNCerr(nc_inq_varid(ncid, "coordinates", &coordVID)) ) return -1;
-      start[0] = 0;
-      start[1] = 0;
-      count[0] = 2; // Only 2 atoms
-      count[1] = 3;
-      double Coords[6]; // Hold first 2 coord sets
-      if ( checkNCerr(nc_get_vara_double(ncid, coordVID, start, count, Coords)) )
-        return -1;
-      // Calculate distance
-      double dx = Coords[0] - Coords[3];
-      double dy = Coords[1] - Coords[4];
-      double dz = Coords[2] - Coords[5];
-      double dist2 = (dx * dx) + (dy * dy) + (dz * dz);
-      if (dist2 < 0.0001) {
-        ErrorMsg("First two coordinates in restart '%s' overlap. Probable corruption.\n",
-                  rfile->c_str());
-        //*runStat = false;
-        return 1;
-      }
-      // Get box info if present
-      int cellVID = -1;
-      if ( nc_inq_varid(ncid, "cell_lengths", &cellVID) == NC_NOERR ) {
-        count[0] = 3;
-        count[1] = 0;
-        if ( checkNCerr(nc_get_vara_double(ncid, cellVID, start, count, Coords)) )
-          return -1;
-        // Calc max distance allowed by box
-        double box2 = (Coords[0]*Coords[0]) + (Coords[1]*Coords[1]) + (Coords[2]*Coords[2]);
-        if (dist2 > box2) {
-          ErrorMsg("First two coordinates distance > box size in restart '%s'."
-                   " Probable corruption.\n", rfile->c_str());
-          //*runStat = false;
-          return 1;
-        }
+    if (idx < (int)records.size()) {
+      records[idx].rstName_ = restart_files[idx].substr(topDir_.size()+1);
+      records[idx].rstTime_ = info.time_;
+      records[idx].hasRstTime_ = true;
+    }
+    if (idx == 0) {
+      rst_time0 = info.time_;
+      res.Msg("\tInitial restart time: %g\n", rst_time0);
+    } else if ( fabs(rst_time0 - info.time_) > 0.00000000000001 ) {
+      res.ErrorMsg("File '%s' time %g does not match initial restart time %g\n",
+                   restart_files[idx].c_str(), info.time_, rst_time0);
+      if (idx < (int)records.size()) {
+        records[idx].problem_ = true;
+        records[idx].warnings_.push_back( FormatStr("Restart time %g does not match initial"
+                                                    " restart time %g.", info.time_, rst_time0) );
       }
+      return 1;
     }
-    nc_close( ncid );
+    res.Append( info.res_ );
+    if (info.err_ != 0) return info.err_;
   } // END loop over restart files
-# endif /* HAS_NETCDF */
+  if (deepScan_ && debug_ > 0)
+    res.Msg("\tScanned %i restarts.\n", nrst);
   return 0;
 }
 
-/** Assume we are inside the run directory. Try to figure out what kind
-  * of run from the output files. Then check output files, trajectory
-  * files, and restart files (REMD only) for issues.
+/** Scan forward from the current position of given MDOUT looking for
+  * '5. TIMINGS'.
+  * \return true if found.
+  */
+bool CheckRuns::ScanForTimings(TextFile& mdout) {
+  TextFile::Span line;
+  while (mdout.GetLine( line )) {
+    if (line.StartsWith("   5.  TIMINGS"))
+      return true;
+  }
+  return false;
+}
+
+/** Determine whether given MDOUT completed by looking for '5. TIMINGS'.
+  * This section is near the end of the file, so first look only at the
+  * last TAIL_SIZE bytes. If the tail contains the final wall time but
+  * not the start of the TIMINGS section, the timings are larger than the
+  * tail; fall back to scanning forward from the current position.
+  * \return true if '5. TIMINGS' was found.
+  */
+bool CheckRuns::MdoutCompleted(TextFile& mdout) {
+  static const off_t TAIL_SIZE = 16384;
+  off_t currentPos = mdout.Tell();
+  off_t tailPos = mdout.Size() - TAIL_SIZE;
+  if (currentPos < 0 || tailPos <= currentPos)
+    return ScanForTimings( mdout );
+  if (mdout.Seek( tailPos ))
+    return ScanForTimings( mdout );
+  // Skip past what is likely a partial line.
+  TextFile::Span line;
+  mdout.GetLine( line );
+  bool wallTimeFound = false;
+  while (mdout.GetLine( line )) {
+    if (line.StartsWith("   5.  TIMINGS"))
+      return true;
+    if (line.Contains("wall time"))
+      wallTimeFound = true;
+  }
+  // If no wall time the run did not complete.
+  if (!wallTimeFound) return false;
+  // Tail is truncated; scan forward.
+  if (mdout.Seek( currentPos )) return false;
+  return ScanForTimings( mdout );
+}
+
+/** Read the '5. TIMINGS' section of MDOUT, scanning forward from the
+  * current position (just after the section header). Gets CPU time in
+  * each of the major routines, and the elapsed time and ns/day averaged
+  * over all steps (or the last average if there is no all-steps average).
+  * If there is no elapsed time, use the total wall time.
+  */
+void CheckRuns::ReadMdoutTimings(TextFile& mdout, CheckCache::Entry& info) {
+  const char* SEP = " |=\r\n";
+  bool inRoutines = false;
+  bool allSteps = false;
+  double wallTime = 0.0;
+  int ncols = mdout.GetSpans(SEP);
+  while (ncols > -1) {
+    if (ncols > 0) {
+      TextFile::Span const& token0 = mdout.SpanToken(0);
+      if (inRoutines) {
+        if (token0 == "Total")
+          inRoutines = false;
+        else if (ncols > 1) {
+          for (int r = 0; r != CheckCache::Entry::NROUTINES; r++) {
+            if (token0 == CheckCache::Entry::RoutineName(r)) {
+              info.routineSec_[r] = mdout.SpanToken(1).Double();
+              break;
+            }
+          }
+        }
+      } else if (ncols > 5 && token0 == "NonSetup" && mdout.SpanToken(5) == "Routines:")
+        inRoutines = true;
+      else if (ncols > 3 && token0 == "Average" && mdout.SpanToken(1) == "timings")
+        allSteps = (mdout.SpanToken(3) == "all");
+      else if (ncols > 1 && token0 == "Elapsed(s)") {
+        if (allSteps || info.elapsed_ <= 0.0)
+          info.elapsed_ = mdout.SpanToken(1).Double();
+      } else if (ncols > 1 && token0 == "ns/day") {
+        if (allSteps || info.nsPerDay_ <= 0.0)
+          info.nsPerDay_ = mdout.SpanToken(1).Double();
+      } else if (ncols > 3 && token0 == "Total" && mdout.SpanToken(1) == "wall")
+        wallTime = mdout.SpanToken(3).Double();
+    }
+    ncols = mdout.GetSpans(SEP);
+  }
+  if (info.elapsed_ <= 0.0) info.elapsed_ = wallTime;
+  info.hasTimings_ = (info.nsPerDay_ > 0.0);
+}
+
+/** Read nstlim, dt, numexchg, and ntwx from the '2. CONTROL DATA' section
+  * of an MDOUT, scanning forward from the current position and stopping
+  * at the start of the '3. ATOMIC' section.
+  * \return 0 if entire control section was read, 1 if end of file reached first.
+  */
+int CheckRuns::ReadMdoutControl(TextFile& mdout, CheckCache::Entry& info) {
+  int readInput = 0;
+  const char* SEP = " ,=\r\n";
+  int ncols = mdout.GetSpans(SEP);
+  while (ncols > -1) {
+    if (readInput == 0 && ncols > 2) {
+      if (mdout.SpanToken(0) == "2." && mdout.SpanToken(1) == "CONTROL")
+        readInput = 1;
+    } else if (readInput == 1 && ncols > 1) {
+      if (mdout.SpanToken(0) == "3." && mdout.SpanToken(1) == "ATOMIC")
+        return 0;
+      else {
+        for (int col = 0; col != ncols - 1; col++) {
+          TextFile::Span const& token = mdout.SpanToken(col);
+          if (token == "nstlim")
+            info.nstlim_ = mdout.SpanToken(col+1).Int();
+          else if (token == "dt")
+            info.dt_ = mdout.SpanToken(col+1).Double();
+          else if (token == "numexchg")
+            info.numexchg_ = mdout.SpanToken(col+1).Int();
+          else if (token == "ntwx")
+            info.ntwx_ = mdout.SpanToken(col+1).Int();
+        }
+      }
+    }
+    ncols = mdout.GetSpans(SEP);
+  }
+  return 1;
+}
+
+/** Read the '2. CONTROL DATA FOR THE RUN' section of given MDOUT to
+  * determine how many frames should be written, then look for
+  * '5. TIMINGS' to ensure run completed. Get the actual number of
+  * frames from the trajectory. If neither file has changed since it
+  * was last checked, use info from the check cache instead. Does not
+  * print anything so that it may be called in parallel; any problems
+  * are recorded in RepInfo.
+  */
+void CheckRuns::CheckOutputTraj(std::string const& fname, std::string const& tname,
+                                RepInfo& info)
+const
+{
+  if (useCache_) {
+    info.outKey_ = CheckCache::FileKey( fname );
+    info.trajKey_ = CheckCache::FileKey( tname );
+    CheckCache::Entry const* entry = cache_.Find( fname.substr(topDir_.size()+1),
+                                                  info.outKey_, info.trajKey_ );
+    // Entries written by versions that could not read trajectories have no frame count.
+    if (entry != 0 && entry->frames_ < 0) entry = 0;
+    if (entry != 0) {
+      (CheckCache::Entry&)info = *entry;
+      info.cached_ = true;
+      Profile::Count("check cache hit");
+      return;
+    }
+  }
+  Profile::Timer mdoutTimer("read mdout");
+  TextFile mdout;
+  if (mdout.OpenMapped( fname )) {
+    info.err_ = 1;
+    return;
+  }
+  ReadMdoutControl( mdout, info );
+  // Look for '5. TIMINGS'
+  info.completed_ = MdoutCompleted( mdout );
+  if (info.completed_)
+    ReadMdoutTimings( mdout, info );
+  mdout.Close();
+  mdoutTimer.Stop();
+  // Get actual number of frames from NetCDF trajectory header.
+  Profile::Timer trajTimer("read trajectory");
+  NetcdfFile ncfile;
+  int ncerr = ncfile.Open( tname );
+  if (ncerr == 1) {
+    info.err_ = 2;
+    info.ncErr_ = ncfile.Error();
+  } else if (ncerr != 0) {
+    info.err_ = -1;
+    info.ncErr_ = ncfile.Error();
+  } else {
+    long int nframes = ncfile.DimLength("frame");
+    if (nframes < 0) {
+      info.err_ = -1;
+      info.ncErr_ = "'" + tname + "': No frame dimension.";
+    } else {
+      info.frames_ = (int)nframes;
+      // Time of first and last frames, used to check continuity between runs.
+      if (nframes > 0 && ncfile.HasVar("time") &&
+          ncfile.GetVar("time", 0,         0, 1, &info.timeFirst_) == 0 &&
+          ncfile.GetVar("time", nframes-1, 0, 1, &info.timeLast_) == 0)
+        info.hasTime_ = true;
+    }
+  }
+}
+
+/** Try to figure out what kind of run is in the given run directory from
+  * the output files. Then check output files, trajectory files, and
+  * restart files (REMD only) for issues. All file names are resolved
+  * relative to the run directory so that runs may be checked in parallel.
+  * \param rdir Run directory prefix (with trailing slash).
   * \return 0 if ok, 1 if potential issues, -1 if error.
   */
-int CheckRuns::CheckRunFiles(bool firstOnly) {
+int CheckRuns::CheckRunFiles(std::string const& rdir, bool firstOnly, ResultType& res) const {
   // Try to determine the run type based on the output files.
   RunType runType = UNKNOWN;
   // Determine where the output files are. 
-  StrArray output_files = ExpandToFilenames("OUTPUT/rem.out.*", false);
+  StrArray output_files = ExpandToFilenames(rdir + "OUTPUT/rem.out.*", false);
   if (!output_files.empty()) {
     runType = REMD;
   } else {
     // Not REMD. Multiple MD?
-    output_files = ExpandToFilenames("md.out.*", false);
+    output_files = ExpandToFilenames(rdir + "md.out.*", false);
     if (!output_files.empty()) {
       runType = MULTI_MD;
     } else {
-      if (fileExists("md.out")) {
-        output_files.push_back("md.out");
+      if (fileExists(rdir + "md.out")) {
+        output_files.push_back(rdir + "md.out");
         runType = SINGLE_MD;
       }
     }
   }
-  if (debug_ > 0) Msg(" %zu output files.\n", output_files.size());
+  if (debug_ > 0) res.Msg(" %zu output files.\n", output_files.size());
   if (output_files.empty() || runType == UNKNOWN) {
-    ErrorMsg("Output file(s) not found.\n");
-    //*runStat = false;
+    res.ErrorMsg("Output file(s) not found.\n");
     return 1;
   }
   // Determine where the trajectory files are.
   StrArray traj_files;
   if (runType == REMD)
-    traj_files = ExpandToFilenames("TRAJ/rem.crd.*", false);
+    traj_files = ExpandToFilenames(rdir + "TRAJ/rem.crd.*", false);
   else if (runType == MULTI_MD)
-    traj_files = ExpandToFilenames("md.nc.*", false);
-  else if (fileExists("mdcrd.nc"))
-    traj_files.push_back("mdcrd.nc");
+    traj_files = ExpandToFilenames(rdir + "md.nc.*", false);
+  else if (fileExists(rdir + "mdcrd.nc"))
+    traj_files.push_back(rdir + "mdcrd.nc");
   else
-    ErrorMsg("Trajectory file(s) not found.");
+    res.ErrorMsg("Trajectory file(s) not found.");
 
   if (traj_files.size() != output_files.size()) {
-    ErrorMsg("Number of output files %zu != # of traj files %zu.\n",
-             output_files.size(), traj_files.size());
-    CompareStrArray( output_files, traj_files );
-    //*runStat = false;
+    res.ErrorMsg("Number of output files %zu != # of traj files %zu.\n",
+                 output_files.size(), traj_files.size());
+    CompareStrArray( output_files, traj_files, res );
     return 1;
   }
 
+  // Gather info from output and trajectory files.
+  int nreps = (int)output_files.size();
+  if (firstOnly) nreps = 1;
+  std::vector<RepInfo> Info( nreps );
+  int rep;
+# ifdef _OPENMP
+  // This region is only active if runs are not already being checked in parallel.
+# pragma omp parallel for num_threads(nthreads_) schedule(dynamic) if (nthreads_ > 1 && nreps > 1)
+# endif
+  for (rep = 0; rep < nreps; rep++)
+    CheckOutputTraj( output_files[rep], traj_files[rep], Info[rep] );
+
   int iRunStat = 0;
-  // Loop over output and trajectory files.
-# ifdef HAS_NETCDF
+  // Loop over output and trajectory file info.
   int badFrameCount = -1;
-# endif
   int numBadFrameCount = 0;
   bool check_restarts = false;
-  StrArray::const_iterator tname = traj_files.begin();
-  for (StrArray::const_iterator fname = output_files.begin();
-                                fname != output_files.end();
-                              ++fname, ++tname)
+  for (rep = 0; rep < nreps; rep++)
   {
-    if (debug_ > 0) Msg("    '%s'\n", fname->c_str());
-    // Determine how many frames should be written by the output file.
-    // Read the '2. CONTROL DATA FOR THE RUN' section of MDOUT. Look
-    // for '5. TIMINGS' to ensure run completed.
-    TextFile mdout;
-    if (mdout.OpenRead( *fname )) {
-      ErrorMsg("Could not open output file '%s'\n", fname->c_str());
+    RepInfo const& info = Info[rep];
+    std::string const& fname = output_files[rep];
+    if (debug_ > 0) res.Msg("    '%s'\n", fname.c_str());
+    if (info.err_ == 1) {
+      res.ErrorMsg("Could not open output file '%s'\n", fname.c_str());
       return -1;
     }
-    bool end_mdout_reached = false;
-    int readInput = 0;
-    int nstlim = 0;
-    double dt = 0;
-    int numexchg = 0;
-    int ntwx = 0;
-    int expectedFrames = 0;
-    int actualFrames = -1;
-    const char* SEP = " ,=\r\n";
-    int ncols = mdout.GetColumns(SEP);
-    while (ncols > -1) {
-      if (readInput == 0 && ncols > 2) {
-        if (mdout.Token(0) == "2." && mdout.Token(1) == "CONTROL")
-          readInput = 1;
-      } else if (readInput == 1 && ncols > 1) {
-        if (mdout.Token(0) == "3." && mdout.Token(1) == "ATOMIC")
-          break;
-        else {
-          for (int col = 0; col != ncols - 1; col++) {
-            if (mdout.Token(col) == "nstlim")
-              nstlim = atoi( mdout.Token(col+1).c_str() );
-            else if (mdout.Token(col) == "dt")
-              dt = atof( mdout.Token(col+1).c_str() );
-            else if (mdout.Token(col) == "numexchg")
-              numexchg = atoi( mdout.Token(col+1).c_str() );
-            else if (mdout.Token(col) == "ntwx")
-              ntwx = atoi( mdout.Token(col+1).c_str() );
-          }
-        }
-      }
-      ncols = mdout.GetColumns(SEP);
-    }
-    // Scan down to '5. TIMINGS'
-    const char* ptr = mdout.Gets();
-    while (ptr != 0) {
-      if (strncmp("   5.  TIMINGS", ptr, 14)==0) {
-        end_mdout_reached = true;
-        break;
-      }
-      ptr = mdout.Gets();
-    }
-    mdout.Close();
-    if (end_mdout_reached) {
-      if (debug_ > 0) Msg("\tRun completed.\n");
+    if (info.cached_) {
+      if (debug_ > 0) res.Msg("\tUsing cached info.\n");
+      res.AddCacheHit();
+    } else if (useCache_ && info.err_ == 0)
+      res.AddCacheEntry( fname.substr(topDir_.size()+1), info );
+    if (info.completed_) {
+      if (debug_ > 0) res.Msg("\tRun completed.\n");
     } else {
-      if (debug_ > 0) Msg("\tRun did not complete.\n");
-      //*runStat = false;
+      if (debug_ > 0) res.Msg("\tRun did not complete.\n");
       iRunStat = 1;
     }
     if (debug_ > 0) {
-      Msg("\tnstlim= %i\n", nstlim);
-      Msg("\tdt= %g\n", dt);
-      if (runType == REMD) Msg("\tnumexchg= %i\n", numexchg);
-      Msg("\tntwx= %i\n", ntwx);
+      res.Msg("\tnstlim= %i\n", info.nstlim_);
+      res.Msg("\tdt= %g\n", info.dt_);
+      if (runType == REMD) res.Msg("\tnumexchg= %i\n", info.numexchg_);
+      res.Msg("\tntwx= %i\n", info.ntwx_);
     }
+    int numexchg = info.numexchg_;
     if (numexchg == 0) numexchg = 1;
-    double totalTime = ((double)nstlim * dt) * (double)numexchg;
-    expectedFrames = (nstlim * numexchg) / ntwx;
+    double totalTime = ((double)info.nstlim_ * info.dt_) * (double)numexchg;
+    int expectedFrames = (info.nstlim_ * numexchg) / info.ntwx_;
     if (debug_ > 0) {
-      Msg("\tTotal time: %g ps\n", totalTime);
-      Msg("\tExpected Frames: %i\n", expectedFrames);
+      res.Msg("\tTotal time: %g ps\n", totalTime);
+      res.Msg("\tExpected Frames: %i\n", expectedFrames);
     }
 
     // Trajectory check.
-#   ifdef HAS_NETCDF
-    // Get actual number of frames from NetCDF file.
-    int ncid = -1;
-    if ( checkNCerr(nc_open(tname->c_str(), NC_NOWRITE, &ncid)) ) {
-      ErrorMsg("Could not open trajectory file '%s'\n", tname->c_str());
-      //*runStat = false;
+    if (info.err_ == 2) {
+      res.ErrorMsg("NETCDF: %s\n", info.ncErr_.c_str());
+      res.ErrorMsg("Could not open trajectory file '%s'\n", traj_files[rep].c_str());
       return 1;
+    } else if (info.err_ == -1) {
+      res.ErrorMsg("NETCDF: %s\n", info.ncErr_.c_str());
+      return -1;
     }
-    int dimID;
-    size_t slength = 0;
-    if ( checkNCerr(nc_inq_dimid(ncid, "frame", &dimID))  ) return -1;
-    if ( checkNCerr(nc_inq_dimlen(ncid, dimID, &slength)) ) return -1;
-    actualFrames = (int)slength;
-    nc_close( ncid );
+    int actualFrames = info.frames_;
     if (debug_ > 0)
-      Msg("\tActual Frames: %i\n", actualFrames);
+      res.Msg("\tActual Frames: %i\n", actualFrames);
+    RepRecord rec;
+    rec.outName_ = fname.substr(topDir_.size()+1);
+    rec.trajName_ = traj_files[rep].substr(topDir_.size()+1);
+    rec.time_ = totalTime;
+    rec.frames_ = actualFrames;
+    rec.expected_ = expectedFrames;
+    rec.completed_ = info.completed_;
     // If run did not complete, check restart files if replica.
     if (expectedFrames != actualFrames) {
       ++numBadFrameCount;
-      ++Nwarnings_;
+      res.AddWarning();
+      rec.problem_ = true;
+      rec.warnings_.push_back( FormatStr("# actual frames %i != # expected frames %i.",
+                                         actualFrames, expectedFrames) );
       if (badFrameCount != actualFrames) { // To avoid repeated checkall warnings
         if (debug_ > 0)
-          Msg("Warning: # actual frames %i != # expected frames %i.\n",
-              actualFrames, expectedFrames);
+          res.Msg("Warning: # actual frames %i != # expected frames %i.\n",
+                  actualFrames, expectedFrames);
         badFrameCount = actualFrames;
       }
       if (runType == REMD) check_restarts = true;
     } else {
-      if (debug_ > 0) Msg("\tOK.\n");
+      if (debug_ > 0) res.Msg("\tOK.\n");
     }
-#   endif /* HAS_NETCDF */
-    Msg("%04li %4i %12g %12i %12i\n", fname-output_files.begin()+1, iRunStat, totalTime,
-        actualFrames, expectedFrames);
-    if (firstOnly) break;
+    res.Msg("%04i %4i %12g %12i %12i\n", rep+1, iRunStat, totalTime,
+            info.frames_, expectedFrames);
+    res.AddRep( info );
+    res.AddRecord( rec );
   } // END loop over output/trajectory files for run
 
   if (numBadFrameCount > 0) {
-    if (debug_ > 0) Msg("Warning: Frame count did not match for %i replicas.\n", numBadFrameCount);
-    //*runStat = false;
+    if (debug_ > 0) res.Msg("Warning: Frame count did not match for %i replicas.\n", numBadFrameCount);
     iRunStat = 1;
   }
 
-  // Check restarts for REMD run if any OUTPUT/TRAJ files were bad.
-  if (check_restarts) {
-    int retval = CheckRemdRestarts(output_files);
+  if (reportTimings_)
+    ReportTimings( res );
+
+  // Check restarts for REMD run if any OUTPUT/TRAJ files were bad or
+  // if all restarts should be scanned.
+  if (check_restarts || (deepScan_ && runType == REMD)) {
+    int retval = CheckRemdRestarts(rdir, output_files, res);
     if (retval == -1) {
-      ErrorMsg("Problem checking REMD restart files.\n");
+      res.ErrorMsg("Problem checking REMD restart files.\n");
     } else if (retval == 1) {
-      //*runStat = false;
       iRunStat = 1;
     }
   } // END check restarts
@@ -344,52 +856,352 @@ int CheckRuns::CheckRunFiles(bool firstOnly) {
   return iRunStat;
 }
 
-/** Check trajectories and output files for specified runs. */
+/** \return Median of given values; values are sorted in place. */
+static double Median(std::vector<double>& values) {
+  std::sort( values.begin(), values.end() );
+  size_t mid = values.size() / 2;
+  if ((values.size() % 2) == 0)
+    return 0.5 * (values[mid-1] + values[mid]);
+  return values[mid];
+}
+
+/** Print throughput and CPU time in major routines for each replica with
+  * timings, then min/median/max ns/day and load imbalance. In REMD every
+  * exchange waits for the slowest replica, so imbalance is measured from
+  * the time each replica spent computing (CPU time in major routines, or
+  * elapsed time if not available) as (max - mean) / max. Replicas whose
+  * compute time is more than SLOW_FACTOR times the median are flagged.
+  */
+void CheckRuns::ReportTimings(ResultType& res) {
+  static const double SLOW_FACTOR = 1.2;
+  ResultType::EntryArray const& reps = res.Reps();
+  std::vector<unsigned int> repIdx;
+  std::vector<double> compute;
+  for (unsigned int rep = 0; rep != reps.size(); rep++) {
+    if (!reps[rep].hasTimings_) continue;
+    double sec = 0.0;
+    for (int r = 0; r != CheckCache::Entry::NROUTINES; r++)
+      sec += reps[rep].routineSec_[r];
+    if (sec <= 0.0) sec = reps[rep].elapsed_;
+    repIdx.push_back( rep );
+    compute.push_back( sec );
+  }
+  if (repIdx.empty()) {
+    res.Msg("\tNo timings found in output.\n");
+    return;
+  }
+  res.Msg("\t%-4s %10s %10s", "#Rep", "ns/day", "Elapsed(s)");
+  for (int r = 0; r != CheckCache::Entry::NROUTINES; r++)
+    res.Msg(" %8s", CheckCache::Entry::RoutineName(r));
+  res.Msg("\n");
+  std::vector<double> speeds;
+  unsigned int iMin = 0;
+  unsigned int iMax = 0;
+  unsigned int iSlowest = 0;
+  double nsTotal = 0.0;
+  double computeSum = 0.0;
+  for (unsigned int i = 0; i != repIdx.size(); i++) {
+    CheckCache::Entry const& info = reps[repIdx[i]];
+    res.Msg("\t%04u %10.2f %10.2f", repIdx[i]+1, info.nsPerDay_, info.elapsed_);
+    for (int r = 0; r != CheckCache::Entry::NROUTINES; r++)
+      res.Msg(" %8.2f", info.routineSec_[r]);
+    res.Msg("\n");
+    speeds.push_back( info.nsPerDay_ );
+    nsTotal += info.nsPerDay_;
+    computeSum += compute[i];
+    if (info.nsPerDay_ < reps[repIdx[iMin]].nsPerDay_) iMin = i;
+    if (info.nsPerDay_ > reps[repIdx[iMax]].nsPerDay_) iMax = i;
+    if (compute[i] > compute[iSlowest]) iSlowest = i;
+  }
+  double nsMedian = Median( speeds );
+  res.Msg("\tns/day: min %.2f (%04u) median %.2f max %.2f (%04u) total %.2f\n",
+          reps[repIdx[iMin]].nsPerDay_, repIdx[iMin]+1, nsMedian,
+          reps[repIdx[iMax]].nsPerDay_, repIdx[iMax]+1, nsTotal);
+  double computeMax = compute[iSlowest];
+  double imbalance = 0.0;
+  if (computeMax > 0.0)
+    imbalance = 100.0 * (computeMax - (computeSum / (double)compute.size())) / computeMax;
+  res.Msg("\tLoad imbalance: %.1f%% (slowest replica %04u, %.2f s)\n",
+          imbalance, repIdx[iSlowest]+1, computeMax);
+  std::vector<double> sorted = compute;
+  double computeMedian = Median( sorted );
+  for (unsigned int i = 0; i != compute.size(); i++) {
+    if (compute[i] > SLOW_FACTOR * computeMedian) {
+      std::string warning = FormatStr("Replica %04u compute time %.2f s is %.0f%% above median %.2f s.",
+                                      repIdx[i]+1, compute[i],
+                                      100.0 * (compute[i] - computeMedian) / computeMedian,
+                                      computeMedian);
+      res.Msg("Warning: %s\n", warning.c_str());
+      res.AddWarning();
+      if (repIdx[i] < res.Records().size())
+        res.Records()[repIdx[i]].warnings_.push_back( warning );
+    }
+  }
+}
+
+/** Check that trajectory times increase within the given run and that it
+  * starts one frame interval after the previous run ended, e.g. to catch
+  * runs restarted from the wrong coordinates. Runs must be checked in order.
+  * Only the first break for each replica is reported; runs with a break are
+  * marked as having potential issues.
+  * \param broken Set to true for each replica once a break is found.
+  * \return Number of run-to-run replica comparisons made.
+  */
+int CheckRuns::CheckTimeContinuity(StrArray const& RunDirs, std::vector<ResultType>& Results,
+                                   unsigned int ridx, std::vector<bool>& broken)
+{
+  int ncompared = 0;
+  ResultType& res = Results[ridx];
+  ResultType::EntryArray const& cur = res.Reps();
+  if (broken.size() < cur.size())
+    broken.resize( cur.size(), false );
+  for (unsigned int rep = 0; rep < cur.size(); rep++)
+  {
+    CheckCache::Entry const& crep = cur[rep];
+    if (broken[rep] || !crep.hasTime_) continue;
+    std::string msg;
+    if (crep.frames_ > 1 && crep.timeLast_ <= crep.timeFirst_) {
+      msg = FormatStr("Replica %u trajectory times in '%s' do not increase (%g to %g ps).",
+                      rep+1, RunDirs[ridx].c_str(), crep.timeFirst_, crep.timeLast_);
+      broken[rep] = true;
+    } else if (ridx > 0 && rep < Results[ridx-1].Reps().size()) {
+      CheckCache::Entry const& prep = Results[ridx-1].Reps()[rep];
+      if (!prep.hasTime_) continue;
+      ++ncompared;
+      double interval = crep.dt_ * (double)crep.ntwx_;
+      double expected = prep.timeLast_ + interval;
+      if (crep.timeFirst_ <= prep.timeLast_ || fabs(crep.timeFirst_ - expected) > 0.5 * interval) {
+        msg = FormatStr("Replica %u trajectory in '%s' starts at %g ps; expected %g ps after '%s'.",
+                        rep+1, RunDirs[ridx].c_str(), crep.timeFirst_, expected,
+                        RunDirs[ridx-1].c_str());
+        broken[rep] = true;
+      }
+    }
+    if (broken[rep]) {
+      res.ErrorMsg("%s\n", msg.c_str());
+      if (res.Stat() == 0) res.SetStat(1);
+      if (rep < res.Records().size()) {
+        res.Records()[rep].problem_ = true;
+        res.Records()[rep].warnings_.push_back( msg );
+      }
+    }
+  }
+  return ncompared;
+}
+
+/** \return Given number formatted for JSON, or null if it is not finite. */
+static std::string JsonNum(double val) {
+  if (!(fabs(val) <= DBL_MAX)) return std::string("null");
+  return FormatStr("%.10g", val);
+}
+
+/** \return Given number formatted for CSV, or empty if it is not finite. */
+static std::string CsvNum(double val) {
+  if (!(fabs(val) <= DBL_MAX)) return std::string();
+  return FormatStr("%.10g", val);
+}
+
+/** \return String quoted for JSON. */
+static std::string JsonStr(std::string const& str) {
+  std::string out(1, '"');
+  for (std::string::const_iterator c = str.begin(); c != str.end(); ++c) {
+    if (*c == '"' || *c == '\\') {
+      out += '\\';
+      out += *c;
+    } else if ((unsigned char)*c < 0x20)
+      out += FormatStr("\\u%04x", (unsigned int)(unsigned char)*c);
+    else
+      out += *c;
+  }
+  out += '"';
+  return out;
+}
+
+/** \return JSON array of given strings. */
+static std::string JsonArray(StrArray const& strs) {
+  std::string out(1, '[');
+  for (StrArray::const_iterator it = strs.begin(); it != strs.end(); ++it) {
+    if (it != strs.begin()) out += ',';
+    out += JsonStr( *it );
+  }
+  out += ']';
+  return out;
+}
+
+/** \return String quoted for CSV if it contains a separator, quote, or newline. */
+static std::string CsvStr(std::string const& str) {
+  if (str.find_first_of(",\"\r\n") == std::string::npos) return str;
+  std::string out(1, '"');
+  for (std::string::const_iterator c = str.begin(); c != str.end(); ++c) {
+    if (*c == '"') out += '"';
+    out += *c;
+  }
+  out += '"';
+  return out;
+}
+
+/** \return Given strings joined with '; ', quoted for CSV. */
+static std::string CsvList(StrArray const& strs) {
+  std::string out;
+  for (StrArray::const_iterator it = strs.begin(); it != strs.end(); ++it) {
+    if (it != strs.begin()) out += "; ";
+    out += *it;
+  }
+  return CsvStr( out );
+}
+
+/** Print one record per replica, then one for the run. JSON records are
+  * one object per line (JSON Lines) so they may be read as they are
+  * printed; CSV records follow the header printed by DoCheck().
+  */
+void CheckRuns::PrintRecords(std::string const& rdir, ResultType const& res) const {
+  ResultType::RecordArray const& records = res.Records();
+  for (unsigned int rep = 0; rep != records.size(); rep++) {
+    RepRecord const& rec = records[rep];
+    if (format_ == JSON)
+      Data("{\"record\":\"replica\",\"run\":%s,\"rep\":%u,\"status\":\"%s\","
+           "\"time_ps\":%s,\"frames\":%i,\"expected_frames\":%i,\"restart_time\":%s,"
+           "\"output\":%s,\"trajectory\":%s,\"restart\":%s,\"warnings\":%s}\n",
+           JsonStr(rdir).c_str(), rep+1, rec.Status(), JsonNum(rec.time_).c_str(),
+           rec.frames_, rec.expected_,
+           (rec.hasRstTime_ ? JsonNum(rec.rstTime_).c_str() : "null"), JsonStr(rec.outName_).c_str(),
+           JsonStr(rec.trajName_).c_str(),
+           (rec.rstName_.empty() ? "null" : JsonStr(rec.rstName_).c_str()),
+           JsonArray(rec.warnings_).c_str());
+    else
+      Data("replica,%s,%u,%s,%s,%i,%i,%s,%s,%s,%s,%s\n", CsvStr(rdir).c_str(), rep+1,
+           rec.Status(), CsvNum(rec.time_).c_str(), rec.frames_, rec.expected_,
+           (rec.hasRstTime_ ? CsvNum(rec.rstTime_).c_str() : ""),
+           CsvStr(rec.outName_).c_str(), CsvStr(rec.trajName_).c_str(),
+           CsvStr(rec.rstName_).c_str(), CsvList(rec.warnings_).c_str());
+  }
+  const char* status = "ok";
+  if (res.Stat() == -1)
+    status = "error";
+  else if (res.Stat() == 1)
+    status = "problem";
+  else if (res.Nwarnings() > 0)
+    status = "warning";
+  StrArray errors, warnings;
+  res.Issues( errors, warnings );
+  if (format_ == JSON)
+    Data("{\"record\":\"run\",\"run\":%s,\"status\":\"%s\",\"replicas\":%u,"
+         "\"errors\":%s,\"warnings\":%s}\n", JsonStr(rdir).c_str(), status,
+         (unsigned int)records.size(), JsonArray(errors).c_str(), JsonArray(warnings).c_str());
+  else {
+    errors.insert( errors.end(), warnings.begin(), warnings.end() );
+    Data("run,%s,,%s,,,,,,,,%s\n", CsvStr(rdir).c_str(), status, CsvList(errors).c_str());
+  }
+}
+
+/** Check trajectories and output files for specified runs. Runs (or
+  * replicas within a run) may be checked in parallel; output for each
+  * run is buffered and printed in the original run order as soon as it
+  * and all runs before it have been checked.
+  */
 int CheckRuns::DoCheck(std::string const& TopDir, StrArray const& RunDirs, bool firstOnly) {
   if (firstOnly)
     Msg("Checking only first output/traj for all runs.\n");
   else
     Msg("Checking all output/traj for all runs.\n");
-# ifndef HAS_NETCDF
-  Msg("Warning: Compiled without NetCDF; cannot get actual # frames, skipping trajectory/restart checks.\n");
+# ifdef _OPENMP
+  if (nthreads_ > 1)
+    Msg("Using %i threads to check runs.\n", nthreads_);
+# else
+  if (nthreads_ > 1)
+    Msg("Warning: Compiled without OpenMP; ignoring number of check threads (%i).\n", nthreads_);
 # endif
-  Nwarnings_ = 0;
-  std::vector<bool> run_is_ok(RunDirs.size(), false);
-  // Loop over all run directories
+  // Load info from previous checks.
+  topDir_ = TopDir;
+  std::string cacheName( TopDir + "/" + CACHE_NAME_ );
+  if (useCache_) {
+    Profile::Timer timer("check cache read");
+    if (cache_.Read( cacheName ))
+      Msg("Warning: Could not read check cache '%s'\n", cacheName.c_str());
+  }
+  int nruns = (int)RunDirs.size();
+  std::vector<ResultType> Results( nruns );
   Msg("%-4s %4s %12s %12s %12s\n", "#", "Stat", "Time(ps)", "Frames", "Expected");
-  std::vector<bool>::iterator runStat = run_is_ok.begin();
-  for (StrArray::const_iterator rdir = RunDirs.begin(); rdir != RunDirs.end(); ++rdir, ++runStat)
+  if (format_ == CSV)
+    Data("record,run,rep,status,time_ps,frames,expected_frames,restart_time,"
+         "output,trajectory,restart,warnings\n");
+  // Runs are finished in order: the next run to print, whether each run has
+  // been checked, and replicas whose trajectory times have already broken.
+  int nextPrint = 0;
+  std::vector<bool> checked( nruns, false );
+  std::vector<bool> broken;
+  int ncompared = 0;
+  bool failed = false;
+  unsigned int n_bad_runs = 0;
+  int Nwarnings = 0;
+  // If there are at least as many runs as threads, check runs in parallel.
+  // Otherwise check replicas within each run in parallel.
+  int ridx;
+# ifdef _OPENMP
+# pragma omp parallel for num_threads(nthreads_) schedule(dynamic) if (nthreads_ > 1 && nruns >= nthreads_)
+# endif
+  for (ridx = 0; ridx < nruns; ridx++)
   {
-    if (ChangeDir( TopDir )) {
-      ErrorMsg("Could not change to top directory '%s'\n", TopDir.c_str());
-      return 1;
+    ResultType& res = Results[ridx];
+    std::string const& rdir = RunDirs[ridx];
+    std::string runPath = TopDir + "/" + rdir;
+    if (!fileExists( runPath )) {
+      res.Msg("Warning: '%s' does not exist.\n", rdir.c_str());
+      res.SetStat(1);
+    } else {
+      res.Msg("  %s:\n", rdir.c_str());
+      res.SetStat( CheckRunFiles(runPath + "/", firstOnly, res) );
     }
-    if (!fileExists( *rdir ))
-      Msg("Warning: '%s' does not exist.\n", rdir->c_str());
-    else {
-      *runStat = true;
-      Msg("  %s:\n", rdir->c_str());
-      if (ChangeDir( *rdir )) {
-        ErrorMsg("Could not change to run directory '%s'\n", rdir->c_str());
-        return 1;
+    // Finish this run and any later runs already checked.
+#   ifdef _OPENMP
+#   pragma omp critical(checkprint)
+#   endif
+    {
+      checked[ridx] = true;
+      for (; nextPrint < nruns && checked[nextPrint]; ++nextPrint) {
+        ResultType& pres = Results[nextPrint];
+        ncompared += CheckTimeContinuity( RunDirs, Results, nextPrint, broken );
+        if (failed) continue;
+        pres.Print();
+        if (format_ != TEXT)
+          PrintRecords( RunDirs[nextPrint], pres );
+        if (pres.Stat() == -1) {
+          ErrorMsg("Checking run failed.\n");
+          failed = true;
+        } else if (pres.Stat() == 1)
+          ++n_bad_runs;
+        Nwarnings += pres.Nwarnings();
       }
-      int iRunStat = CheckRunFiles(firstOnly);
-      if (iRunStat == -1) {
-        ErrorMsg("Checking run failed.\n");
-        return 1;
-      } else if (iRunStat == 1)
-       *runStat = false;
-    } // END run directory exists
+    }
   } // END loop over runs
-  unsigned int n_bad_runs = 0;
-  for (std::vector<bool>::const_iterator it = run_is_ok.begin(); it != run_is_ok.end(); ++it)
-    if (!(*it))
-      ++n_bad_runs;
+  if (debug_ > 0)
+    Msg("Compared trajectory times for %i replica run transitions.\n", ncompared);
+  // Update the cache with any newly checked files.
+  if (useCache_) {
+    unsigned int ncacheHit = 0;
+    unsigned int ncacheMiss = 0;
+    for (std::vector<ResultType>::const_iterator res = Results.begin(); res != Results.end(); ++res)
+    {
+      ncacheHit += res->NcacheHit();
+      ncacheMiss += res->NewEntries().size();
+      for (ResultType::CacheArray::const_iterator it = res->NewEntries().begin();
+                                                  it != res->NewEntries().end(); ++it)
+        cache_.Add( it->first, it->second );
+    }
+    unsigned int nremoved = cache_.Prune( TopDir );
+    if (debug_ > 0)
+      Msg("Check cache: %u hits, %u new entries, %u entries for removed runs dropped.\n",
+          ncacheHit, ncacheMiss, nremoved);
+    Profile::Timer timer("check cache write");
+    if (cache_.Write( cacheName ))
+      Msg("Warning: Could not write check cache '%s'\n", cacheName.c_str());
+  }
+  if (failed) return 1;
   if (n_bad_runs > 0) {
     ErrorMsg("%u of %zu runs had problems.\n", n_bad_runs, RunDirs.size());
     return 1;
   }
-  if (Nwarnings_ == 0)
+  if (Nwarnings == 0)
     Msg("  All checks OK.\n");
   else
     Msg("  Runs seem OK, but some warnings were encountered.\n");
@@ -1,29 +1,77 @@
 #ifndef INC_CHECKRUNS_H
 #define INC_CHECKRUNS_H
 #include <string>
+#include <vector>
 #include "FileRoutines.h" // StrArray
+#include "CheckCache.h"
+class TextFile;
+class NetcdfFile;
 class CheckRuns {
   public:
     CheckRuns();
     /// Check runs in given directory with given subdirectories; optionally only checking first run
     int DoCheck(std::string const&, FileRoutines::StrArray const&, bool);
+    /// Set number of threads to use when checking runs/replicas.
+    void SetNthreads(int n) { nthreads_ = n; }
+    void SetDebug(int d)    { debug_ = d;    }
+    /// Set whether persistent check cache should be used.
+    void SetUseCache(bool u) { useCache_ = u; }
+    /// Set whether all REMD restarts should be fully scanned.
+    void SetDeepScan(bool d) { deepScan_ = d; }
+    /// Set whether per-replica performance from MDOUT timings should be reported.
+    void SetReportTimings(bool t) { reportTimings_ = t; }
+    /// Set check results format: 'text' (default), 'json' (JSON Lines), or 'csv'. \return 1 if unrecognized.
+    int SetFormat(std::string const&);
+    /// Read MD control info from MDOUT. \return 0 if entire control section read, 1 otherwise.
+    static int ReadMdoutControl(TextFile&, CheckCache::Entry&);
   private:
     enum RunType { UNKNOWN = 0, REMD, SINGLE_MD, MULTI_MD };
+    enum FormatType { TEXT = 0, JSON, CSV };
 
+    class RepRecord;
     class ResultType;
-#   ifdef HAS_NETCDF
-    static int checkNCerr(int);
-    static int GetDimInfo(int, const char*, int&);
-#   endif
-    static void CompareStrArray(FileRoutines::StrArray const&, FileRoutines::StrArray const&);
+    class RepInfo;
+    class RstInfo;
+    static void CompareStrArray(FileRoutines::StrArray const&, FileRoutines::StrArray const&, ResultType&);
     /// \return Extension of given file name.
     static std::string Ext(std::string const&);
+    /// Scan all coordinates/velocities in restart (NetcdfFile or Rst7File) for problems.
+    template <class RstFile>
+    static int DeepScanRestart(RstFile&, std::string const&, long int, ResultType&);
+    /// Check time/coordinates in an open restart (NetcdfFile or Rst7File).
+    template <class RstFile>
+    void CheckRestartFile(RstFile&, std::string const&, RstInfo&) const;
+    /// Check a single REMD restart
+    void CheckRestart(std::string const&, RstInfo&) const;
     /// Check REMD restarts
-    static int CheckRemdRestarts(FileRoutines::StrArray const&);
+    int CheckRemdRestarts(std::string const&, FileRoutines::StrArray const&, ResultType&) const;
+    /// \return true if '5. TIMINGS' found scanning forward in MDOUT.
+    static bool ScanForTimings(TextFile&);
+    /// \return true if MDOUT completed, checking the end of the file first.
+    static bool MdoutCompleted(TextFile&);
+    /// Read performance info from the MDOUT '5. TIMINGS' section.
+    static void ReadMdoutTimings(TextFile&, CheckCache::Entry&);
+    /// Report per-replica performance and load imbalance for a run.
+    static void ReportTimings(ResultType&);
+    /// Get info from a single output/trajectory file pair.
+    void CheckOutputTraj(std::string const&, std::string const&, RepInfo&) const;
     /// Check Output/Traj files
-    int CheckRunFiles(bool);
+    int CheckRunFiles(std::string const&, bool, ResultType&) const;
+    /// Check that trajectory times continue into given run from the previous one. \return # comparisons.
+    static int CheckTimeContinuity(FileRoutines::StrArray const&, std::vector<ResultType>&,
+                                   unsigned int, std::vector<bool>&);
+    /// Print machine-readable records for replicas and run in given run dir.
+    void PrintRecords(std::string const&, ResultType const&) const;
+
+    static const char* CACHE_NAME_;
 
     int debug_;
-    int Nwarnings_;
+    int nthreads_;       ///< Number of threads to use for checking runs/replicas.
+    bool useCache_;      ///< If true, use the persistent check cache.
+    bool deepScan_;      ///< If true, check and fully scan all REMD restarts.
+    bool reportTimings_; ///< If true, report performance from MDOUT timings.
+    FormatType format_;  ///< Format for check results.
+    std::string topDir_; ///< Top directory; cache names are relative to this.
+    CheckCache cache_;   ///< Info from previous checks.
 };
 #endif
@@ -0,0 +1,564 @@
+#include <cmath>     // fabs
+#include <cstdio>    // snprintf
+#include <algorithm> // std::sort, std::swap, std::lower_bound
+#include "ExchangeStats.h"
+#include "Messages.h"
+#include "TextFile.h"
+
+using namespace Messages;
+using namespace FileRoutines;
+
+// =============================================================================
+void ExchangeStats::TripState::Visit(signed char end, long int exchg) {
+  if (end == lastEnd_) return;
+  lastEnd_ = end;
+  if (nvisits_ == 0) firstEnd_ = end;
+  if (nvisits_ < 3) first_[nvisits_] = exchg;
+  ++nvisits_;
+  if (end == 1) {
+    if (bottom_ > -1) sawTop_ = true;
+  } else {
+    if (sawTop_) {
+      ++ntrips_;
+      tripTime_ += (double)(exchg - bottom_);
+    }
+    bottom_ = exchg;
+    sawTop_ = false;
+  }
+}
+
+/** Only the first 3 visits in a run can depend on what happened before
+  * the run (the first visit is ignored if it repeats the last end, and a
+  * round trip ending at the third visit starts at the first). Replay
+  * those, then add round trips from later visits, which depend only on
+  * the run itself.
+  */
+void ExchangeStats::TripState::Append(TripState const& run, long int offset) {
+  long int nreplay = (run.nvisits_ < 3) ? run.nvisits_ : 3;
+  signed char end = run.firstEnd_;
+  for (long int idx = 0; idx != nreplay; idx++, end = 1 - end)
+    Visit( end, offset + run.first_[idx] );
+  if (run.nvisits_ < 4) return;
+  long int ntrips = run.ntrips_;
+  double tripTime = run.tripTime_;
+  if (run.firstEnd_ == 0) {
+    // Round trip ending at third visit was counted in the replay.
+    --ntrips;
+    tripTime -= (double)(run.first_[2] - run.first_[0]);
+  }
+  ntrips_ += ntrips;
+  tripTime_ += tripTime;
+  lastEnd_ = run.lastEnd_;
+  bottom_ = offset + run.bottom_;
+  sawTop_ = run.sawTop_;
+  nvisits_ += run.nvisits_ - nreplay;
+}
+
+// =============================================================================
+/** Hold results from reading a single rem.log. Structures are labeled by
+  * the slot they were in at the start of the run.
+  */
+class ExchangeStats::RunStats {
+  public:
+    RunStats() : nexchange_(0), nskipped_(0), err_(0) {}
+
+    std::vector<Larray> attempts_;      ///< Attempts for each neighbor pair in each dim.
+    std::vector<Larray> accepted_;      ///< Accepted exchanges for each neighbor pair in each dim.
+    Iarray label_;                      ///< Label of structure currently in each slot.
+    std::vector<TripState> trips_;      ///< Round trip state for each label/dim.
+    std::vector<int> startPos_;         ///< First ladder position of each label/dim, -1 if none.
+    std::vector<int> endPos_;           ///< Last ladder position of each label/dim, -1 if none.
+    Larray nswap_;                      ///< Number of accepted exchanges for each label.
+    std::vector< std::vector<double> > ladder_; ///< Ladder temperatures seen in each dim.
+    long int nexchange_;                ///< Number of exchanges read.
+    long int nskipped_;                 ///< Number of lines not recognized.
+    int err_;                           ///< 1 if log could not be opened.
+    // Current exchange
+    std::vector<char> seen_;            ///< True if slot was in current exchange.
+    std::vector<char> isTemp_;          ///< True if slot line had temperature format.
+    std::vector<double> temp_;          ///< Temperature before exchange (temperature format).
+    std::vector<double> newTemp_;       ///< Temperature after exchange (temperature format).
+    Iarray nbr_;                        ///< Neighbor replica (from 1) (neighbor format).
+    std::vector<char> success_;         ///< True if exchange succeeded (neighbor format).
+    std::vector<int> slotAt_;           ///< Slot at each ladder position before exchange (temperature format).
+    std::vector<int> newPos_;           ///< Ladder position of each group member after exchange (temperature format).
+};
+
+// =============================================================================
+/** CONSTRUCTOR */
+ExchangeStats::ExchangeStats() :
+  nreps_(0), nlogs_(0), nexchange_(0), nskipped_(0), debug_(0), nthreads_(1)
+{}
+
+/** Read dimension exchange types, descriptions, and groups from remd.dim
+  * as written by Groups::WriteRemdDim().
+  */
+int ExchangeStats::ReadRemdDim(std::string const& fname) {
+  TextFile infile;
+  if (infile.OpenRead( fname )) return 1;
+  const char* SEP = " ,=()':\t\r\n";
+  int ncols = infile.GetSpans( SEP );
+  while (ncols > -1) {
+    if (ncols > 0) {
+      TextFile::Span const& token0 = infile.SpanToken(0);
+      if (token0 == "Dimension")
+        Dims_.push_back( DimType() );
+      else if (Dims_.empty()) {
+        if (token0 != "&multirem" && token0 != "/") {
+          ErrorMsg("Line '%s' in '%s' before first dimension.\n", token0.str().c_str(), fname.c_str());
+          return 1;
+        }
+      } else if (token0 == "exch_type" && ncols > 1)
+        Dims_.back().type_ = infile.SpanToken(1).str();
+      else if (token0 == "desc") {
+        std::string& desc = Dims_.back().desc_;
+        for (int col = 1; col < ncols; col++) {
+          if (col > 1) desc.append(" ");
+          desc.append( infile.SpanToken(col).str() );
+        }
+      } else if (token0 == "group" && ncols > 2) {
+        Iarray group;
+        for (int col = 2; col < ncols; col++) {
+          int rep = infile.SpanToken(col).Int();
+          if (rep < 1) {
+            ErrorMsg("Bad replica index '%s' in '%s'\n", infile.SpanToken(col).str().c_str(),
+                     fname.c_str());
+            return 1;
+          }
+          group.push_back( rep - 1 );
+          if ((unsigned int)rep > nreps_) nreps_ = (unsigned int)rep;
+        }
+        Dims_.back().groups_.push_back( group );
+      }
+    }
+    ncols = infile.GetSpans( SEP );
+  }
+  infile.Close();
+  return 0;
+}
+
+/** If the run directory has remd.dim read dimensions from it, otherwise
+  * all replicas (one per output file) are in a single group. Then set
+  * the group and ladder position of each slot in each dimension.
+  */
+int ExchangeStats::SetupDims(std::string const& rdir) {
+  Dims_.clear();
+  nreps_ = 0;
+  std::string dimName = rdir + "/remd.dim";
+  if (fileExists( dimName )) {
+    if (ReadRemdDim( dimName )) {
+      ErrorMsg("Could not read '%s'\n", dimName.c_str());
+      return 1;
+    }
+  } else {
+    nreps_ = ExpandToFilenames(rdir + "/OUTPUT/rem.out.*", false).size();
+    Dims_.resize( 1 );
+    Dims_[0].groups_.resize( 1 );
+    for (unsigned int slot = 0; slot != nreps_; slot++)
+      Dims_[0].groups_[0].push_back( slot );
+  }
+  if (Dims_.empty() || nreps_ < 2) {
+    ErrorMsg("Could not determine replicas for '%s'\n", rdir.c_str());
+    return 1;
+  }
+  for (std::vector<DimType>::iterator dim = Dims_.begin(); dim != Dims_.end(); ++dim)
+  {
+    unsigned int dimNum = (unsigned int)(dim - Dims_.begin()) + 1;
+    dim->grpOf_.assign( nreps_, 0 );
+    dim->posOf_.assign( nreps_, 0 );
+    std::vector<char> inGroup( nreps_, 0 );
+    dim->npairs_ = 0;
+    for (unsigned int gidx = 0; gidx != dim->groups_.size(); gidx++) {
+      Iarray const& group = dim->groups_[gidx];
+      dim->pairStart_.push_back( dim->npairs_ );
+      if (group.size() > 1) dim->npairs_ += group.size() - 1;
+      for (unsigned int pos = 0; pos != group.size(); pos++) {
+        unsigned int slot = group[pos];
+        if (inGroup[slot]) {
+          ErrorMsg("Replica %u is in more than one group in dimension %u.\n", slot+1, dimNum);
+          return 1;
+        }
+        inGroup[slot] = 1;
+        dim->grpOf_[slot] = gidx;
+        dim->posOf_[slot] = pos;
+      }
+    }
+    if (std::find( inGroup.begin(), inGroup.end(), 0 ) != inGroup.end()) {
+      ErrorMsg("Not all replicas are in a group in dimension %u.\n", dimNum);
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/** Record ladder position of structure in slot, and a visit if it is at
+  * the bottom or top of the ladder.
+  * \param pos Position in ladder (from 0).
+  * \param size Number of positions in ladder.
+  */
+void ExchangeStats::Observe(unsigned int slot, unsigned int dim, int pos, unsigned int size,
+                            long int exchg, RunStats& run)
+const
+{
+  unsigned int idx = run.label_[slot] * Dims_.size() + dim;
+  if (run.startPos_[idx] < 0) run.startPos_[idx] = pos;
+  run.endPos_[idx] = pos;
+  if (pos == 0)
+    run.trips_[idx].Visit( 0, exchg );
+  else if (pos + 1 == (int)size)
+    run.trips_[idx].Visit( 1, exchg );
+}
+
+/** \return Position of given temperature in sorted ladder, -1 if not present. */
+static int LadderPosition(std::vector<double> const& ladder, double temp) {
+  std::vector<double>::const_iterator it = std::lower_bound(ladder.begin(), ladder.end(), temp - 0.000001);
+  if (it == ladder.end() || fabs(*it - temp) > 0.000001) return -1;
+  return (int)(it - ladder.begin());
+}
+
+/** Count attempted/accepted exchanges between neighbors in each group of
+  * the dimension for this exchange, and record ladder positions of
+  * structures before (at exchg - 1) and after the exchange. Lines with a
+  * neighbor and success flag (e.g. Hamiltonian) give each pair directly,
+  * and structures in an accepted pair swap slots. Lines with temperatures
+  * (Rep#, Velocity Scaling, T, Eptot, Temp, NewTemp, ...) give ladder
+  * position from the rank of the temperature in the group; a pair
+  * succeeded if the lower replica moved up, and structures stay in their
+  * slots with the new temperature. Since Amber
+  * alternates between even and odd pairs, pair P (from 0) is counted as
+  * attempted if P + K is even or if it succeeded, where K is the exchange
+  * number within the dimension. Groups not completely
+  * present in the exchange (e.g. run still in progress) are skipped.
+  * \param exchNum Exchange number N from the log.
+  * \param exchg Exchange index from start of run.
+  */
+void ExchangeStats::EndExchange(int exchNum, long int exchg, RunStats& run) const {
+  unsigned int dim = (unsigned int)((exchNum - 1) % (int)Dims_.size());
+  unsigned int dimExchNum = (unsigned int)((exchNum - 1) / (int)Dims_.size()) + 1;
+  DimType const& Dim = Dims_[dim];
+  Larray& attempts = run.attempts_[dim];
+  Larray& accepted = run.accepted_[dim];
+  for (unsigned int gidx = 0; gidx != Dim.groups_.size(); gidx++)
+  {
+    Iarray const& group = Dim.groups_[gidx];
+    if (group.size() < 2) continue;
+    unsigned int pair0 = Dim.pairStart_[gidx];
+    bool allSeen = true;
+    bool allTemp = true;
+    for (Iarray::const_iterator slot = group.begin(); slot != group.end(); ++slot) {
+      if (!run.seen_[*slot])
+        allSeen = false;
+      else if (!run.isTemp_[*slot])
+        allTemp = false;
+    }
+    if (!allSeen) continue;
+    if (allTemp) {
+      std::vector<double> ladder;
+      ladder.reserve( group.size() );
+      for (Iarray::const_iterator slot = group.begin(); slot != group.end(); ++slot)
+        ladder.push_back( run.temp_[*slot] );
+      std::sort( ladder.begin(), ladder.end() );
+      if (run.ladder_[dim].empty())
+        run.ladder_[dim] = ladder;
+      std::vector<char> movedUp( group.size(), 0 );
+      std::vector<int>& slotAt = run.slotAt_;
+      std::vector<int>& newPos = run.newPos_;
+      slotAt.assign( group.size(), -1 );
+      newPos.assign( group.size(), -1 );
+      for (unsigned int idx = 0; idx != group.size(); idx++) {
+        unsigned int slot = group[idx];
+        int oldPos = LadderPosition( ladder, run.temp_[slot] );
+        newPos[idx] = LadderPosition( ladder, run.newTemp_[slot] );
+        if (oldPos > -1) {
+          slotAt[oldPos] = (int)slot;
+          Observe( slot, dim, oldPos, group.size(), exchg - 1, run );
+          if (newPos[idx] == oldPos + 1)
+            movedUp[oldPos] = 1;
+        }
+      }
+      for (unsigned int pos = 0; pos + 1 < group.size(); pos++) {
+        if (movedUp[pos] || ((pos + dimExchNum) % 2) == 0)
+          attempts[pair0 + pos]++;
+        if (movedUp[pos]) {
+          accepted[pair0 + pos]++;
+          if (slotAt[pos] > -1)   run.nswap_[run.label_[slotAt[pos]]]++;
+          if (slotAt[pos+1] > -1) run.nswap_[run.label_[slotAt[pos+1]]]++;
+        }
+      }
+      for (unsigned int idx = 0; idx != group.size(); idx++)
+        if (newPos[idx] > -1)
+          Observe( group[idx], dim, newPos[idx], group.size(), exchg, run );
+    } else {
+      for (unsigned int pos = 0; pos != group.size(); pos++)
+        Observe( group[pos], dim, pos, group.size(), exchg - 1, run );
+      for (unsigned int pos = 0; pos + 1 < group.size(); pos++) {
+        unsigned int slot = group[pos];
+        if (run.isTemp_[slot] || run.nbr_[slot] != group[pos+1] + 1) continue;
+        attempts[pair0 + pos]++;
+        if (run.success_[slot]) {
+          accepted[pair0 + pos]++;
+          std::swap( run.label_[slot], run.label_[group[pos+1]] );
+          run.nswap_[run.label_[slot]]++;
+          run.nswap_[run.label_[group[pos+1]]]++;
+        }
+      }
+      for (unsigned int pos = 0; pos != group.size(); pos++)
+        Observe( group[pos], dim, pos, group.size(), exchg, run );
+    }
+  }
+  run.seen_.assign( nreps_, 0 );
+}
+
+/** Read rem.log in a single pass, evaluating each exchange as soon as it
+  * has been read. Only the current exchange is kept in memory.
+  */
+void ExchangeStats::ReadLog(std::string const& fname, RunStats& run) const {
+  unsigned int ndim = Dims_.size();
+  run.attempts_.resize( ndim );
+  run.accepted_.resize( ndim );
+  run.ladder_.assign( ndim, std::vector<double>() );
+  for (unsigned int dim = 0; dim != ndim; dim++) {
+    run.attempts_[dim].assign( Dims_[dim].npairs_, 0 );
+    run.accepted_[dim].assign( Dims_[dim].npairs_, 0 );
+  }
+  run.label_.resize( nreps_ );
+  for (unsigned int slot = 0; slot != nreps_; slot++)
+    run.label_[slot] = slot;
+  run.trips_.assign( nreps_ * ndim, TripState() );
+  run.startPos_.assign( nreps_ * ndim, -1 );
+  run.endPos_.assign( nreps_ * ndim, -1 );
+  run.nswap_.assign( nreps_, 0 );
+  run.seen_.assign( nreps_, 0 );
+  run.isTemp_.assign( nreps_, 0 );
+  run.temp_.assign( nreps_, 0.0 );
+  run.newTemp_.assign( nreps_, 0.0 );
+  run.nbr_.assign( nreps_, 0 );
+  run.success_.assign( nreps_, 0 );
+
+  TextFile remlog;
+  if (remlog.OpenMapped( fname )) {
+    run.err_ = 1;
+    return;
+  }
+  const char* SEP = " \t\r\n";
+  int exchNum = 0;
+  int ncols = remlog.GetSpans( SEP );
+  while (ncols > -1) {
+    if (ncols > 0) {
+      TextFile::Span const& token0 = remlog.SpanToken(0);
+      if (token0.ptr()[0] == '#') {
+        if (ncols > 2 && token0 == "#" && remlog.SpanToken(1) == "exchange") {
+          if (exchNum > 0) EndExchange( exchNum, run.nexchange_, run );
+          exchNum = remlog.SpanToken(2).Int();
+          if (exchNum < 1) exchNum = 1;
+          run.nexchange_++;
+        }
+      } else if (exchNum > 0) {
+        int rep = token0.Int();
+        if (rep < 1 || (unsigned int)rep > nreps_)
+          run.nskipped_++;
+        else if (ncols > 8 && (remlog.SpanToken(7) == "T" || remlog.SpanToken(7) == "F")) {
+          // Replica#, Neighbor#, Temperature, PotE(x_1), PotE(x_2), left_fr, right_fr, Success, Success_rate
+          unsigned int slot = (unsigned int)rep - 1;
+          run.seen_[slot] = 1;
+          run.isTemp_[slot] = 0;
+          int nbr = remlog.SpanToken(1).Int();
+          run.nbr_[slot] = (nbr > 0) ? (unsigned int)nbr : 0;
+          run.success_[slot] = (remlog.SpanToken(7) == "T");
+        } else if (ncols > 5) {
+          // Rep#, Velocity Scaling, T, Eptot, Temp, NewTemp, Success rate (i,i+1), ResStruct#
+          unsigned int slot = (unsigned int)rep - 1;
+          run.seen_[slot] = 1;
+          run.isTemp_[slot] = 1;
+          run.temp_[slot] = remlog.SpanToken(4).Double();
+          run.newTemp_[slot] = remlog.SpanToken(5).Double();
+        } else
+          run.nskipped_++;
+      }
+    }
+    ncols = remlog.GetSpans( SEP );
+  }
+  if (exchNum > 0) EndExchange( exchNum, run.nexchange_, run );
+  remlog.Close();
+}
+
+/** Read and report rem.log from each run. */
+int ExchangeStats::Process(std::string const& TopDir, StrArray const& RunDirs) {
+  if (Read( TopDir, RunDirs )) return 1;
+  Report();
+  return 0;
+}
+
+/** Read rem.log from each run (in parallel if possible), then combine in
+  * run order. Structures are identified by the replica they started in
+  * for the first run.
+  */
+int ExchangeStats::Read(std::string const& TopDir, StrArray const& RunDirs) {
+  StrArray logNames;
+  for (StrArray::const_iterator rdir = RunDirs.begin(); rdir != RunDirs.end(); ++rdir) {
+    std::string logName = TopDir + "/" + *rdir + "/rem.log";
+    if (!fileExists( logName )) {
+      if (!logNames.empty())
+        Msg("Warning: '%s' not found; only using logs from previous runs.\n", logName.c_str());
+      break;
+    }
+    logNames.push_back( logName );
+  }
+  if (logNames.empty()) {
+    ErrorMsg("No rem.log found in '%s'\n", RunDirs.front().c_str());
+    return 1;
+  }
+  if (SetupDims( TopDir + "/" + RunDirs.front() )) return 1;
+  nlogs_ = (int)logNames.size();
+  std::vector<RunStats> Runs( nlogs_ );
+  int ridx;
+# ifdef _OPENMP
+# pragma omp parallel for num_threads(nthreads_) schedule(dynamic) if (nthreads_ > 1 && nlogs_ > 1)
+# endif
+  for (ridx = 0; ridx < nlogs_; ridx++)
+    ReadLog( logNames[ridx], Runs[ridx] );
+
+  unsigned int ndim = Dims_.size();
+  attempts_.assign( ndim, Larray() );
+  accepted_.assign( ndim, Larray() );
+  for (unsigned int dim = 0; dim != ndim; dim++) {
+    attempts_[dim].assign( Dims_[dim].npairs_, 0 );
+    accepted_[dim].assign( Dims_[dim].npairs_, 0 );
+  }
+  // Structure in each slot at the start of the current run.
+  Iarray structure( nreps_ );
+  for (unsigned int slot = 0; slot != nreps_; slot++)
+    structure[slot] = slot;
+  nswap_.assign( nreps_, 0 );
+  trips_.assign( nreps_ * ndim, TripState() );
+  // Ladder position of each structure/dim at the end of the previous run.
+  std::vector<int> lastPos( nreps_ * ndim, -1 );
+  nexchange_ = 0;
+  nskipped_ = 0;
+  for (ridx = 0; ridx < nlogs_; ridx++)
+  {
+    RunStats const& run = Runs[ridx];
+    if (run.err_ != 0) {
+      ErrorMsg("Could not open '%s'\n", logNames[ridx].c_str());
+      return 1;
+    }
+    if (debug_ > 0)
+      Msg("\t'%s': %li exchanges.\n", logNames[ridx].c_str(), run.nexchange_);
+    for (unsigned int dim = 0; dim != ndim; dim++) {
+      for (unsigned int pair = 0; pair != Dims_[dim].npairs_; pair++) {
+        attempts_[dim][pair] += run.attempts_[dim][pair];
+        accepted_[dim][pair] += run.accepted_[dim][pair];
+      }
+    }
+    for (unsigned int label = 0; label != nreps_; label++) {
+      unsigned int str = structure[label];
+      nswap_[str] += run.nswap_[label];
+      for (unsigned int dim = 0; dim != ndim; dim++) {
+        unsigned int sidx = str * ndim + dim;
+        unsigned int lidx = label * ndim + dim;
+        if (lastPos[sidx] > -1 && run.startPos_[lidx] > -1 && run.startPos_[lidx] != lastPos[sidx])
+          trips_[sidx].Restart();
+        trips_[sidx].Append( run.trips_[lidx], nexchange_ );
+        if (run.endPos_[lidx] > -1) lastPos[sidx] = run.endPos_[lidx];
+      }
+    }
+    Iarray nextStructure( nreps_ );
+    for (unsigned int slot = 0; slot != nreps_; slot++)
+      nextStructure[slot] = structure[ run.label_[slot] ];
+    structure.swap( nextStructure );
+    nexchange_ += run.nexchange_;
+    nskipped_ += run.nskipped_;
+  }
+  ladders_ = Runs.back().ladder_;
+  return 0;
+}
+
+/** Acceptance between ladder position P and P+1 is combined over all
+  * groups in the dimension that have position P+1.
+  * \param minAttempts Minimum number of exchange attempts for each position.
+  * \return 1 if fewer than minAttempts (or no) exchanges were attempted for
+  *         a position, 0 otherwise.
+  */
+int ExchangeStats::LadderAcceptance(unsigned int dim, long int minAttempts,
+                                    std::vector<double>& ratio) const
+{
+  DimType const& Dim = Dims_[dim];
+  Larray attempts, accepted;
+  for (unsigned int gidx = 0; gidx != Dim.groups_.size(); gidx++) {
+    unsigned int npairs = Dim.groups_[gidx].size();
+    if (npairs < 2) continue;
+    npairs--;
+    if (attempts.size() < npairs) {
+      attempts.resize( npairs, 0 );
+      accepted.resize( npairs, 0 );
+    }
+    for (unsigned int pos = 0; pos != npairs; pos++) {
+      attempts[pos] += attempts_[dim][Dim.pairStart_[gidx] + pos];
+      accepted[pos] += accepted_[dim][Dim.pairStart_[gidx] + pos];
+    }
+  }
+  ratio.clear();
+  for (unsigned int pos = 0; pos != attempts.size(); pos++) {
+    if (attempts[pos] < 1 || attempts[pos] < minAttempts) return 1;
+    ratio.push_back( (double)accepted[pos] / (double)attempts[pos] );
+  }
+  return 0;
+}
+
+void ExchangeStats::Report() const {
+  unsigned int ndim = Dims_.size();
+  Msg("Exchange statistics from %i rem.log files, %li exchanges.\n", nlogs_, nexchange_);
+  unsigned int nNeverAccepted = 0;
+  for (unsigned int dim = 0; dim != ndim; dim++)
+  {
+    DimType const& Dim = Dims_[dim];
+    Msg("  Dimension %u:", dim + 1);
+    if (!Dim.type_.empty()) Msg(" %s", Dim.type_.c_str());
+    if (!Dim.desc_.empty()) Msg(" '%s'", Dim.desc_.c_str());
+    Msg("\n");
+    Msg("  %6s %4s %-11s %10s %10s %8s\n", "#Group", "Pair", "Replicas", "Attempts",
+        "Accepted", "Ratio");
+    for (unsigned int gidx = 0; gidx != Dim.groups_.size(); gidx++) {
+      Iarray const& group = Dim.groups_[gidx];
+      for (unsigned int pos = 0; pos + 1 < group.size(); pos++) {
+        unsigned int pair = Dim.pairStart_[gidx] + pos;
+        double ratio = 0.0;
+        if (attempts_[dim][pair] > 0)
+          ratio = (double)accepted_[dim][pair] / (double)attempts_[dim][pair];
+        if (accepted_[dim][pair] == 0)
+          ++nNeverAccepted;
+        char reps[32];
+        snprintf(reps, 32, "%u-%u", group[pos] + 1, group[pos+1] + 1);
+        Msg("  %6u %4u %-11s %10li %10li %8.3f\n", gidx + 1, pos + 1, reps,
+            attempts_[dim][pair], accepted_[dim][pair], ratio);
+      }
+    }
+    long int dimTrips = 0;
+    double tripTime = 0.0;
+    unsigned int noTrips = 0;
+    for (unsigned int str = 0; str != nreps_; str++) {
+      TripState const& state = trips_[str * ndim + dim];
+      dimTrips += state.Ntrips();
+      tripTime += state.TripTime();
+      if (state.Ntrips() == 0) ++noTrips;
+    }
+    if (dimTrips > 0)
+      Msg("  Round trips: %li, mean %.1f exchanges; %u of %u replicas completed none.\n",
+          dimTrips, tripTime / (double)dimTrips, noTrips, nreps_);
+    else
+      Msg("  Round trips: 0.\n");
+  }
+  if (nNeverAccepted > 0)
+    Msg("Warning: %u neighbor pairs never exchanged.\n", nNeverAccepted);
+  unsigned int nNeverSwapped = 0;
+  for (unsigned int str = 0; str != nreps_; str++) {
+    if (nswap_[str] == 0) {
+      if (nNeverSwapped == 0) Msg("Warning: Structures starting in replicas");
+      Msg(" %u", str + 1);
+      ++nNeverSwapped;
+    }
+  }
+  if (nNeverSwapped > 0) Msg(" never exchanged.\n");
+  if (nskipped_ > 0)
+    Msg("Warning: Skipped %li unrecognized lines.\n", nskipped_);
+}
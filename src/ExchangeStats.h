@@ -0,0 +1,120 @@
+#ifndef INC_EXCHANGESTATS_H
+#define INC_EXCHANGESTATS_H
+#include <string>
+#include <vector>
+#include "FileRoutines.h" // StrArray
+/// Calculate replica exchange statistics from the rem.log of a chain of REMD runs.
+/** Each rem.log is read in a single pass, keeping only the current
+  * exchange in memory, so logs may be processed in parallel. A replica
+  * "slot" is a replica index in the groupfile. As in Amber, accepted
+  * temperature exchanges move temperatures between slots and leave
+  * structures in place, so the ladder position of a structure is the rank
+  * of its slot's current temperature; other exchanges (e.g. Hamiltonian)
+  * move structures between slots with fixed ladder positions. Per-run
+  * results are merged in run order to follow each structure across the
+  * whole chain; each run starts with the structure a slot ended the previous
+  * run with. Round trips are not counted across a restart that changes the
+  * ladder position of a structure (e.g. temperatures reset by the new
+  * input). Memory
+  * use depends only on the number of replicas, not on the log size.
+  * Dimensions and groups are read from remd.dim if present; otherwise all
+  * replicas are in a single group. For multi-dimensional runs Amber cycles
+  * through dimensions, so exchange N is in dimension (N-1) % # dimensions.
+  */
+class ExchangeStats {
+  public:
+    ExchangeStats();
+    void SetDebug(int d)    { debug_ = d;    }
+    /// Set number of threads to use when reading logs.
+    void SetNthreads(int n) { nthreads_ = n; }
+    /// Read and report rem.log in each of given run subdirectories of top dir, in order.
+    int Process(std::string const&, FileRoutines::StrArray const&);
+    /// Read rem.log in each of given run subdirectories of top dir, in order.
+    int Read(std::string const&, FileRoutines::StrArray const&);
+    /// Print statistics from logs that have been read.
+    void Report() const;
+    /// \return Number of exchange dimensions.
+    unsigned int Ndims() const { return Dims_.size(); }
+    /// Get acceptance between each ladder position and the next in dimension, all groups combined; require given min # attempts.
+    int LadderAcceptance(unsigned int, long int, std::vector<double>&) const;
+    /// \return Ladder temperatures of dimension in last log read; empty if not temperature exchange.
+    std::vector<double> const& LadderTemps(unsigned int d) const { return ladders_[d]; }
+  private:
+    typedef std::vector<unsigned int> Iarray;
+    typedef std::vector<long int> Larray;
+    class DimType;
+    class RunStats;
+    class TripState;
+
+    /// Set up dimensions/groups from remd.dim in given run dir, or single group.
+    int SetupDims(std::string const&);
+    /// Read dimensions/groups from remd.dim file.
+    int ReadRemdDim(std::string const&);
+    /// Read given rem.log.
+    void ReadLog(std::string const&, RunStats&) const;
+    /// Evaluate exchanges in the current exchange block.
+    void EndExchange(int, long int, RunStats&) const;
+    /// Record ladder position of structure in slot for a dimension/group size at an exchange.
+    void Observe(unsigned int, unsigned int, int, unsigned int, long int, RunStats&) const;
+
+    std::vector<DimType> Dims_; ///< Exchange dimensions.
+    unsigned int nreps_;        ///< Total number of replicas.
+    std::vector<Larray> attempts_;      ///< Attempts for each neighbor pair in each dim.
+    std::vector<Larray> accepted_;      ///< Accepted exchanges for each neighbor pair in each dim.
+    std::vector<TripState> trips_;      ///< Round trip state for each structure/dim.
+    Larray nswap_;                      ///< Number of accepted exchanges for each structure.
+    std::vector< std::vector<double> > ladders_; ///< Ladder temperatures for each dim.
+    int nlogs_;                 ///< Number of logs read.
+    long int nexchange_;        ///< Total number of exchanges read.
+    long int nskipped_;         ///< Total number of lines not recognized.
+    int debug_;
+    int nthreads_;              ///< Number of threads to use reading logs.
+};
+
+/** Exchange dimension. */
+class ExchangeStats::DimType {
+  public:
+    DimType() : npairs_(0) {}
+
+    std::string type_;           ///< Exchange type, e.g. TEMPERATURE, HAMILTONIAN.
+    std::string desc_;           ///< Description.
+    std::vector<Iarray> groups_; ///< Slots (from 0) in each group, in ladder order.
+    Iarray grpOf_;               ///< Group index of each slot.
+    Iarray posOf_;               ///< Position in group of each slot.
+    Iarray pairStart_;           ///< Index of first neighbor pair of each group.
+    unsigned int npairs_;        ///< Total number of neighbor pairs.
+};
+
+/** Round trip state for a structure in one dimension. Ladder ends visited
+  * alternate between bottom and top once repeat visits are ignored. A
+  * round trip is counted each time a structure returns to the bottom after
+  * having been at the top since it was last at the bottom; the round trip
+  * time is the number of exchanges between the two visits to the bottom.
+  */
+class ExchangeStats::TripState {
+  public:
+    TripState() : lastEnd_(-1), firstEnd_(-1), nvisits_(0), bottom_(-1), sawTop_(false),
+                  ntrips_(0), tripTime_(0.0)
+    {
+      first_[0] = first_[1] = first_[2] = 0;
+    }
+    /// Record visit to bottom (0) or top (1) of ladder at given exchange.
+    void Visit(signed char, long int);
+    /// Add state from a later run; exchanges in run are offset by given amount.
+    void Append(TripState const&, long int);
+    /// Forget ends visited so far, so no round trip spans this point.
+    void Restart() { lastEnd_ = -1; bottom_ = -1; sawTop_ = false; }
+
+    long int Ntrips()   const { return ntrips_;   }
+    double TripTime()   const { return tripTime_; }
+  private:
+    signed char lastEnd_;  ///< Last end visited; -1 none, 0 bottom, 1 top.
+    signed char firstEnd_; ///< First end visited.
+    long int first_[3];    ///< Exchanges of the first 3 visits.
+    long int nvisits_;     ///< Number of visits.
+    long int bottom_;      ///< Exchange of last visit to the bottom, -1 if none.
+    bool sawTop_;          ///< True if top visited since last visit to the bottom.
+    long int ntrips_;      ///< Number of round trips.
+    double tripTime_;      ///< Total round trip time (exchanges).
+};
+#endif
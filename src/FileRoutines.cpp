@@ -1,16 +1,137 @@
 #include <cstdio>    // fopen, fclose
 #include <cerrno>
 #include <cstring>
-#include <sys/stat.h> // mkdir
-#include <unistd.h> // getcwd 
+#include <map>
+#include <sys/stat.h> // mkdir, stat
+#include <unistd.h> // getcwd, access
 #ifndef __PGI
 #  include <glob.h>  // For tilde expansion
 #endif
 #include "FileRoutines.h"
 #include "Messages.h"
+#include "Profile.h"
 
 using namespace Messages;
 
+// ----- Stat cache ------------------------------------------------------------
+/** Result of stat()/access() for a single path. */
+struct StatEntry {
+  int err_;        ///< errno from stat(), 0 if successful.
+  bool isDir_;     ///< True if path is a directory.
+  bool readable_;  ///< True if path is readable.
+  int accessErr_;  ///< errno from access(), 0 if readable.
+};
+typedef std::map<std::string, StatEntry> StatMap;
+static StatMap StatCache_;             ///< Cached stat results by absolute path.
+static std::string StatCwd_;           ///< Current working dir used to make paths absolute.
+static unsigned int StatHits_ = 0;     ///< Number of stat cache hits.
+static unsigned int StatMisses_ = 0;   ///< Number of stat cache misses.
+
+/** \return Absolute path used as stat cache key. Empty and '.' components
+  * are removed; '..' is kept since the preceding component may be a symbolic
+  * link. Must be called inside the statcache critical section.
+  */
+static std::string StatKey(std::string const& fname) {
+  std::string path;
+  if (fname[0] != '/') {
+    if (StatCwd_.empty())
+      StatCwd_ = FileRoutines::GetWorkingDir();
+    path = StatCwd_ + "/" + fname;
+  } else
+    path = fname;
+  // Remove empty and '.' components
+  std::vector<std::string> comps;
+  std::string::size_type beg = 0;
+  while (beg < path.size()) {
+    std::string::size_type end = path.find('/', beg);
+    if (end == std::string::npos) end = path.size();
+    std::string comp = path.substr(beg, end - beg);
+    if (!comp.empty() && comp != ".")
+      comps.push_back( comp );
+    beg = end + 1;
+  }
+  std::string key;
+  for (std::vector<std::string>::const_iterator it = comps.begin(); it != comps.end(); ++it)
+    key.append( "/" + *it );
+  if (key.empty()) key.assign("/");
+  return key;
+}
+
+/** \return stat info for given path, calling stat()/access() only if
+  *         the path is not already in the cache. Paths that do not exist
+  *         are not cached since other programs (e.g. cpptraj, tar, or
+  *         scripts) may create them at any time.
+  */
+static StatEntry CachedStat(std::string const& fname) {
+  std::string key;
+  bool found = false;
+  StatEntry entry;
+# ifdef _OPENMP
+# pragma omp critical(statcache)
+# endif
+  {
+  key = StatKey( fname );
+  StatMap::const_iterator it = StatCache_.find( key );
+  if (it != StatCache_.end()) {
+    entry = it->second;
+    found = true;
+    StatHits_++;
+  } else
+    StatMisses_++;
+  }
+  if (found) return entry;
+  // Not found. Do the actual file system calls outside the critical section.
+  struct stat frame_stat;
+  Profile::Count("stat()");
+  if (stat(key.c_str(), &frame_stat) == -1) {
+    entry.err_ = errno;
+    entry.isDir_ = false;
+    entry.readable_ = false;
+    entry.accessErr_ = entry.err_;
+  } else {
+    entry.err_ = 0;
+    entry.isDir_ = S_ISDIR(frame_stat.st_mode);
+    Profile::Count("access()");
+    if (access(key.c_str(), R_OK) == 0) {
+      entry.readable_ = true;
+      entry.accessErr_ = 0;
+    } else {
+      entry.readable_ = false;
+      entry.accessErr_ = errno;
+    }
+  }
+  if (entry.err_ == 0) {
+#   ifdef _OPENMP
+#   pragma omp critical(statcache)
+#   endif
+    StatCache_[key] = entry;
+  }
+  return entry;
+}
+
+/** Remove given path from the stat cache, e.g. after it has been created. */
+void FileRoutines::InvalidateStat(std::string const& fname) {
+  if (fname.empty()) return;
+# ifdef _OPENMP
+# pragma omp critical(statcache)
+# endif
+  StatCache_.erase( StatKey(fname) );
+}
+
+/** Remove all paths from the stat cache. */
+void FileRoutines::ClearStatCache() {
+# ifdef _OPENMP
+# pragma omp critical(statcache)
+# endif
+  StatCache_.clear();
+}
+
+/** Print stat cache hit/miss counts. */
+void FileRoutines::PrintStatCacheStats() {
+  Msg("Stat cache: %u hits, %u misses, %zu paths.\n",
+      StatHits_, StatMisses_, StatCache_.size());
+}
+
 // tildeExpansion()
 /** Use glob.h to perform tilde expansion on a filename, returning the
   * expanded filename. If the file does not exist or globbing fails return an
@@ -65,6 +186,7 @@ FileRoutines::StrArray FileRoutines::ExpandToFilenames(std::string const& fnameA
     Msg("Warning: Currently wildcards in filenames not supported with PGI compilers.\n");
   fnames.push_back( fnameArg );
 # else
+  Profile::Timer timer("glob");
   glob_t globbuf;
   int err = glob(fnameArg.c_str(), GLOB_TILDE, NULL, &globbuf );
   //Msg("DEBUG: %s matches %zu files.\n", fnameArg.c_str(), (size_t)globbuf.gl_pathc);
@@ -87,17 +209,27 @@ FileRoutines::StrArray FileRoutines::ExpandToFilenames(std::string const& fnameA
 }
 
 // fileExists()
-/** \return true if file can be opened "r".  */
+/** \return true if file can be opened "r". Names with tildes or wildcards
+  * are expanded first; otherwise the result of stat()/access() is cached so
+  * that each unique path only needs to be looked up once.
+  */
 bool FileRoutines::fileExists(std::string const& filenameIn) {
-  // Perform tilde expansion
-  std::string fname = tildeExpansion(filenameIn);
-  if (fname.empty()) return false;
-  FILE *infile = fopen(fname.c_str(), "rb");
-  if (infile==0) {
-    ErrorMsg("File '%s': %s\n", fname.c_str(), strerror( errno ));
+  if (filenameIn.empty()) return false;
+  Profile::Timer timer("fileExists");
+  std::string fname;
+  if (filenameIn.find_first_of("~*?[") != std::string::npos) {
+    // Perform tilde expansion
+    fname = tildeExpansion(filenameIn);
+    if (fname.empty()) return false;
+  } else
+    fname = filenameIn;
+  StatEntry entry = CachedStat( fname );
+  // A path component that is a file (ENOTDIR) also means it does not exist.
+  if (entry.err_ == ENOENT || entry.err_ == ENOTDIR) return false;
+  if (!entry.readable_) {
+    ErrorMsg("File '%s': %s\n", fname.c_str(), strerror( entry.accessErr_ ));
     return false;
   }
-  fclose(infile);
   return true;
 }
 
@@ -112,14 +244,15 @@ int FileRoutines::CheckExists(const char* type, std::string const& fname) {
 /** \return 1 if file is a directory, 0 if not, -1 if error. */
 int FileRoutines::IsDirectory(std::string const& filenameIn) {
   if (filenameIn.empty()) return -1;
-  struct stat frame_stat;
-  if (stat(filenameIn.c_str(), &frame_stat) == -1) {
+  StatEntry entry = CachedStat( filenameIn );
+  if (entry.err_ != 0) {
     ErrorMsg( "Could not find file status for %s\n", filenameIn.c_str());
     //if (debug_>0)
+    errno = entry.err_;
     perror("     Error from stat: ");
     return -1;
   }
-  if (frame_stat.st_mode & S_IFDIR)
+  if (entry.isDir_)
     return 1;
   return 0;
 }
@@ -127,7 +260,10 @@ int FileRoutines::IsDirectory(std::string const& filenameIn) {
 int FileRoutines::Mkdir(std::string const& dname) {
   if (!fileExists(dname)) {
     //Msg("Creating directory '%s'\n", dname.c_str());
-    if (mkdir( dname.c_str(), S_IRWXU ) != 0) {
+    Profile::Count("mkdir()");
+    int err = mkdir( dname.c_str(), S_IRWXU );
+    InvalidateStat( dname );
+    if (err != 0) {
       ErrorMsg("Creating dir '%s': %s\n", dname.c_str(), strerror( errno ));
       return 1;
     }
@@ -150,16 +286,21 @@ int FileRoutines::ChangeDir(std::string const& dname) {
     ErrorMsg("Cannot change dir; dir name is empty.\n");
     return 1;
   }
+  Profile::Count("chdir()");
   if (chdir( dname.c_str() ) != 0) {
     ErrorMsg("Changing to dir '%s': %s\n", dname.c_str(), strerror( errno ));
     return 1;
   }
+  // Relative stat cache paths are now relative to the new dir.
+  StatCwd_.clear();
   return 0;
 }
 
 int FileRoutines::ChangePermissions(std::string const& fname) {
   // For now only 775
-  return chmod(fname.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+  int err = chmod(fname.c_str(), S_IRWXU | S_IRWXG | S_IROTH | S_IXOTH);
+  InvalidateStat( fname );
+  return err;
 }
 
 std::string FileRoutines::UserName() {
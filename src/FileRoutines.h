@@ -27,5 +27,11 @@ int ChangeDir(std::string const&);
 int ChangePermissions(std::string const&);
 /// \return The current user name
 std::string UserName();
+/// Remove given path from the stat cache used by fileExists/IsDirectory
+void InvalidateStat(std::string const&);
+/// Remove all paths from the stat cache
+void ClearStatCache();
+/// Print stat cache hit/miss counts
+void PrintStatCacheStats();
 }
 #endif
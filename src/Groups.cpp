@@ -3,57 +3,49 @@
 
 using namespace Messages;
 
-int Groups::SetupGroups(unsigned int Ndims) {
-  dimGroups_.clear();
-  dimGroups_.resize( Ndims );
+int Groups::SetupGroups(Iarray const& sizes) {
+  sizes_ = sizes;
+  strides_.assign( sizes_.size(), 1 );
+  total_ = 1;
+  for (unsigned int dim = 0; dim != sizes_.size(); dim++) {
+    if (sizes_[dim] == 0) {
+      ErrorMsg("Dimension %u has no replicas.\n", dim);
+      sizes_.clear();
+      strides_.clear();
+      return 1;
+    }
+    strides_[dim] = total_;
+    total_ *= sizes_[dim];
+  }
   return 0;
 }
 
-void Groups::PrintArray(Iarray const& idxs) {
-  for (Iarray::const_iterator it = idxs.begin(); it != idxs.end(); ++it)
-    Msg("{ %u", *it);
-  Msg(" }\n");
-}
-
-/** It is expected that the replica number passed in starts from 1. */
-int Groups::AddReplica(Iarray const& Indices, unsigned int rep) {
-  // Put replica in its place in each dimension.
-  for (unsigned int dim = 0; dim != dimGroups_.size(); dim++)
-  {
-    Iarray idxs;
-    idxs.reserve( dimGroups_.size()-1 );
-    // Put indices not corresponding to this dimension in idxs.
-    for (unsigned int idxDim = 0; idxDim != dimGroups_.size(); idxDim++)
-      if (idxDim != dim)
-        idxs.push_back( Indices[idxDim] );
-    // Find the corresponding group
-    GroupArrayType::iterator grp = dimGroups_[dim].find( idxs );
-    if (grp == dimGroups_[dim].end()) { // New group
-      //Msg("\tNew group for dim %u: rep %u:", dim, rep);
-      //PrintArray(idxs);
-      dimGroups_[dim].insert( std::pair<Iarray,Iarray>( idxs, Iarray(1, rep) ) );
-    } else {
-      //Msg("\tAdding to group for dim %u: rep %u:", dim, rep);
-      //PrintArray(grp->first);
-      grp->second.push_back( rep );
+/** Groups of a dimension are ordered by the indices of the remaining
+  * dimensions, with the lowest dimension being most significant. Decode
+  * the group index with the last remaining dimension growing fastest.
+  */
+unsigned int Groups::FirstRep(unsigned int dim, unsigned int gidx) const {
+  unsigned int rep = 1;
+  for (unsigned int idxDim = sizes_.size(); idxDim-- > 0; ) {
+    if (idxDim != dim) {
+      rep += (gidx % sizes_[idxDim]) * strides_[idxDim];
+      gidx /= sizes_[idxDim];
     }
   }
-  return 0;
+  return rep;
 }
 
 void Groups::PrintGroups() const {
-  for (DimGroupType::const_iterator dim = dimGroups_.begin();
-                                    dim != dimGroups_.end(); ++dim)
+  for (unsigned int dim = 0; dim != sizes_.size(); dim++)
   {
-    Msg("  Dim %u:\n", dim - dimGroups_.begin());
-    unsigned int gidx = 0;
-    for (GroupArrayType::const_iterator grp = dim->begin();
-                                        grp != dim->end(); ++grp, ++gidx)
+    Msg("  Dim %u:\n", dim);
+    unsigned int ngroups = Ngroups(dim);
+    for (unsigned int gidx = 0; gidx != ngroups; gidx++)
     {
       Msg("    Group %u: ", gidx);
-      for (Iarray::const_iterator rep = grp->second.begin();
-                                  rep != grp->second.end(); ++rep)
-        Msg(" %u", *rep);
+      unsigned int rep = FirstRep(dim, gidx);
+      for (unsigned int i = 0; i != sizes_[dim]; i++, rep += strides_[dim])
+        Msg(" %u", rep);
       Msg("\n");
     }
   }
@@ -64,16 +56,16 @@ void Groups::WriteRemdDim(TextFile& REMDDIM, unsigned int id,
 {
   REMDDIM.Printf("Dimension %u\n", id); // Title
   REMDDIM.Printf("&multirem\n   exch_type = '%s',\n", exch_type);
-  unsigned int gidx = 1;
-  for (GroupArrayType::const_iterator grp = dimGroups_[id].begin();
-                                      grp != dimGroups_[id].end();
-                                    ++grp, ++gidx)
+  unsigned int ngroups = Ngroups(id);
+  for (unsigned int gidx = 0; gidx != ngroups; gidx++)
   {
-    REMDDIM.Printf("   group(%u,:) = ", gidx);
-    for (Iarray::const_iterator rep = grp->second.begin();
-                                rep != grp->second.end(); ++rep)
-      REMDDIM.Printf("%u,", *rep);
-    REMDDIM.Printf("\n");
+    REMDDIM.Printf("   group(%u,:) = ", gidx + 1);
+    unsigned int rep = FirstRep(id, gidx);
+    for (unsigned int i = 0; i != sizes_[id]; i++, rep += strides_[id]) {
+      REMDDIM.PutInt( rep );
+      REMDDIM.PutChar(',');
+    }
+    REMDDIM.PutChar('\n');
   }
   REMDDIM.Printf("   desc = '%s'\n/\n", desc);
 }
@@ -1,31 +1,36 @@
 #ifndef INC_GROUPS_H
 #define INC_GROUPS_H
 #include <vector>
-#include <map>
 #include "TextFile.h"
 /// Class for setting up MREMD groups.
+/** Replica indices are assumed to form a full grid with the first dimension
+  * growing fastest, i.e. replica (starting from 1) is
+  *   1 + Sum(Indices[dim] * Stride[dim]), Stride[dim] = Prod(Size[0..dim-1]).
+  * For a given dimension, a group is all replicas that share the indices of
+  * every other dimension, so group membership is computed directly from
+  * the dimension sizes.
+  */
 class Groups {
   public:
     typedef std::vector<unsigned int> Iarray;
-    Groups() {}
-    /// Prepare Groups for given # of dimensions.
-    int SetupGroups(unsigned int);
-    /// Add replica with given indices to its proper group in each dim.
-    int AddReplica(Iarray const&, unsigned int);
+    Groups() : total_(0) {}
+    /// Prepare Groups for dimensions with given sizes.
+    int SetupGroups(Iarray const&);
     /// Print groups to screen
     void PrintGroups() const;
     /// Print groups for dimension to remd.dim file
     void WriteRemdDim(TextFile&, unsigned int, const char*, const char*) const;
     /// \return true if not yet set up
-    bool Empty() const { return dimGroups_.empty(); }
+    bool Empty() const { return sizes_.empty(); }
+    /// \return Number of groups in given dimension.
+    unsigned int Ngroups(unsigned int dim) const { return total_ / sizes_[dim]; }
+    /// \return Number of replicas in each group of given dimension.
+    unsigned int GroupSize(unsigned int dim) const { return sizes_[dim]; }
+    /// \return First replica (starting from 1) of given group in given dimension.
+    unsigned int FirstRep(unsigned int, unsigned int) const;
   private:
-    static inline void PrintArray(Iarray const&); 
-    /** Map indices to group, 1 per dim. First Iarray is Ndims-1 (all
-      * dimensions not including that dim), second is size of that dim.
-      */
-    typedef std::map<Iarray, Iarray> GroupArrayType;
-    /// Hold GroupArrayType for each dimension.
-    typedef std::vector<GroupArrayType> DimGroupType;
-    DimGroupType dimGroups_;
+    Iarray sizes_;        ///< Size of each dimension.
+    Iarray strides_;      ///< Replica index stride for each dimension.
+    unsigned int total_;  ///< Total number of replicas.
 };
 #endif
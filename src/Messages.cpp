@@ -2,6 +2,9 @@
 #include <cstdio>
 #include <cstdarg>
 
+/// If true, Msg() output goes to stderr.
+static bool msgToStderr_ = false;
+
 void Messages::ErrorMsg(const char* format, ...) {
   fprintf(stderr,"Error: ");
   va_list args;
@@ -11,8 +14,20 @@ void Messages::ErrorMsg(const char* format, ...) {
 }
 
 void Messages::Msg(const char* format, ...) {
+  va_list args;
+  va_start(args, format);
+  vfprintf((msgToStderr_ ? stderr : stdout),format,args);
+  va_end(args);
+}
+
+void Messages::SetMsgToStderr(bool toStderr) {
+  msgToStderr_ = toStderr;
+}
+
+void Messages::Data(const char* format, ...) {
   va_list args;
   va_start(args, format);
   vfprintf(stdout,format,args);
   va_end(args);
+  fflush(stdout);
 }
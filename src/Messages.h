@@ -4,6 +4,10 @@ namespace Messages {
 
 void ErrorMsg(const char*, ...);
 void Msg(const char*, ...);
+/// Send Msg() output to stderr instead of stdout, e.g. when stdout holds data.
+void SetMsgToStderr(bool);
+/// Print data to stdout and flush so it may be read as it is produced.
+void Data(const char*, ...);
 
 }
 #endif
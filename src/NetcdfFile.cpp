@@ -0,0 +1,502 @@
+#include <cerrno>
+#include <cstring>    // memcpy, strcmp, strerror
+#include <fcntl.h>    // open
+#include <unistd.h>   // pread, close
+#include <sys/stat.h> // fstat
+#ifdef HAS_NETCDF
+# include "netcdf.h"
+#endif
+#include "NetcdfFile.h"
+#include "Profile.h"
+
+/** NetCDF classic header tags. */
+enum CdfTag { CDF_DIMENSION = 10, CDF_VARIABLE = 11, CDF_ATTRIBUTE = 12 };
+/** NetCDF external data types. */
+enum CdfType { CDF_BYTE = 1, CDF_CHAR, CDF_SHORT, CDF_INT, CDF_FLOAT, CDF_DOUBLE,
+               CDF_UBYTE, CDF_USHORT, CDF_UINT, CDF_INT64, CDF_UINT64 };
+
+/** \return Size in bytes of given NetCDF type, 0 if unknown. */
+static inline size_t CdfTypeSize(int type) {
+  switch (type) {
+    case CDF_BYTE   :
+    case CDF_CHAR   :
+    case CDF_UBYTE  : return 1;
+    case CDF_SHORT  :
+    case CDF_USHORT : return 2;
+    case CDF_INT    :
+    case CDF_UINT   :
+    case CDF_FLOAT  : return 4;
+    case CDF_DOUBLE :
+    case CDF_INT64  :
+    case CDF_UINT64 : return 8;
+  }
+  return 0;
+}
+
+/** \return Given size rounded up to a multiple of 4. */
+static inline size_t Pad4(size_t n) { return (n + 3) & ~((size_t)3); }
+
+static inline unsigned int BigEndian32(const unsigned char* p) {
+  return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) |
+         ((unsigned int)p[2] <<  8) |  (unsigned int)p[3];
+}
+
+static inline unsigned long long BigEndian64(const unsigned char* p) {
+  return ((unsigned long long)BigEndian32(p) << 32) | BigEndian32(p + 4);
+}
+
+/** Read the given number of bytes at given position, retrying partial reads.
+  * \return 0 if all bytes were read.
+  */
+static int ReadFull(int fd, unsigned char* buf, size_t nbytes, off_t pos) {
+  while (nbytes > 0) {
+    ssize_t nread = pread(fd, buf, nbytes, pos);
+    if (nread < 0 && errno == EINTR) continue;
+    if (nread <= 0) return 1;
+    buf += nread;
+    pos += nread;
+    nbytes -= (size_t)nread;
+  }
+  return 0;
+}
+
+/** Largest header that will be read. Amber headers are only a few KB. */
+static const size_t MAX_HEADER_SIZE = 4194304;
+
+// =============================================================================
+/** Read values from a NetCDF classic header buffer. If the end of the
+  * buffer is reached, zero values are returned and Short() is set so the
+  * header may be re-read with a larger buffer. Lengths and counts that could
+  * not fit in the largest header that would be read (the limit) set Bad().
+  */
+class HeaderReader {
+  public:
+    HeaderReader(const unsigned char* b, size_t s, size_t l, int v) :
+      buf_(b), size_(s), limit_(l), pos_(0), version_(v), short_(false), bad_(false) {}
+    /// \return True if end of buffer was reached.
+    bool Short() const { return short_; }
+    /// \return True if a length or count extends past the limit.
+    bool Bad() const { return bad_; }
+    unsigned long long U32() {
+      if (!Need(4)) return 0;
+      pos_ += 4;
+      return BigEndian32(buf_ + pos_ - 4);
+    }
+    unsigned long long U64() {
+      if (!Need(8)) return 0;
+      pos_ += 8;
+      return BigEndian64(buf_ + pos_ - 8);
+    }
+    /// \return Non-negative size/count; 8 bytes in CDF-5, 4 bytes otherwise.
+    unsigned long long Size() { return (version_ == 5) ? U64() : U32(); }
+    /// \return Count of list entries; each entry takes at least 4 bytes.
+    unsigned long long Count() {
+      unsigned long long n = Size();
+      if (n > (limit_ - pos_) / 4) SetBad();
+      return (bad_) ? 0 : n;
+    }
+    /// \return File offset; 4 bytes in CDF-1, 8 bytes otherwise.
+    unsigned long long Offset() { return (version_ == 1) ? U32() : U64(); }
+    /// \return Padded name.
+    std::string Name() {
+      unsigned long long len = Size();
+      if (!Need(len) || !Need(Pad4((size_t)len))) return std::string();
+      std::string name((const char*)buf_ + pos_, (size_t)len);
+      pos_ += Pad4((size_t)len);
+      return name;
+    }
+    /// Skip given number of values of given size, padded.
+    void SkipValues(unsigned long long nvals, size_t tsize) {
+      if (tsize > 0 && nvals > (limit_ - pos_) / tsize) {
+        SetBad();
+        return;
+      }
+      size_t n = Pad4((size_t)nvals * tsize);
+      if (Need(n)) pos_ += n;
+    }
+  private:
+    /// \return True if given number of bytes are available in the buffer.
+    bool Need(unsigned long long n) {
+      if (n > limit_ - pos_) {
+        SetBad();
+        return false;
+      }
+      if (n > size_ - pos_) {
+        short_ = true;
+        pos_ = size_;
+        return false;
+      }
+      return true;
+    }
+    /// Mark header bad; also short so that reading stops.
+    void SetBad() {
+      bad_ = true;
+      short_ = true;
+      pos_ = size_;
+    }
+
+    const unsigned char* buf_;
+    size_t size_;
+    size_t limit_; ///< Bytes that could be header; never less than size_.
+    size_t pos_;
+    int version_;
+    bool short_;
+    bool bad_;
+};
+
+/** Skip an attribute list. \return 0 if OK, -1 if bad tag. */
+static int SkipAttributes(HeaderReader& hdr) {
+  unsigned long long tag = hdr.U32();
+  unsigned long long natt = hdr.Count();
+  if (tag == 0 && natt == 0) return 0; // ABSENT
+  if (tag != CDF_ATTRIBUTE) return -1;
+  for (unsigned long long i = 0; i < natt && !hdr.Short(); i++) {
+    hdr.Name();
+    size_t tsize = CdfTypeSize( (int)hdr.U32() );
+    unsigned long long nvals = hdr.Size();
+    hdr.SkipValues( nvals, tsize );
+  }
+  return 0;
+}
+
+// =============================================================================
+/** CONSTRUCTOR */
+NetcdfFile::NetcdfFile() : recsize_(0), fd_(-1), ncid_(-1) {}
+
+/** DESTRUCTOR */
+NetcdfFile::~NetcdfFile() { Close(); }
+
+int NetcdfFile::SetError(std::string const& msg) {
+  err_ = "'" + fname_ + "': " + msg;
+  return -1;
+}
+
+void NetcdfFile::Close() {
+  if (fd_ != -1) {
+    close( fd_ );
+    fd_ = -1;
+  }
+# ifdef HAS_NETCDF
+  if (ncid_ != -1) {
+    // NetCDF library calls are not thread-safe.
+#   ifdef _OPENMP
+#   pragma omp critical(netcdf)
+#   endif
+    nc_close( ncid_ );
+    ncid_ = -1;
+  }
+# endif
+  dims_.clear();
+  vars_.clear();
+  recsize_ = 0;
+}
+
+/** Parse dimensions and variables from header.
+  * \param buf Start of file.
+  * \param bufsize Number of bytes in buf.
+  * \param fileSize Total size of file.
+  * \return 0 if OK, 1 if header extends past end of buffer, -1 on error.
+  */
+int NetcdfFile::ParseHeader(const unsigned char* buf, size_t bufsize, off_t fileSize) {
+  dims_.clear();
+  vars_.clear();
+  int version = buf[3];
+  if (version != 1 && version != 2 && version != 5)
+    return SetError("Unsupported NetCDF version.");
+  size_t limit = MAX_HEADER_SIZE;
+  if ((off_t)limit > fileSize) limit = (size_t)fileSize;
+  HeaderReader hdr(buf + 4, bufsize - 4, limit - 4, version);
+  unsigned long long numrecs = hdr.Size();
+  bool streaming = (version == 5) ? (numrecs == ~0ULL) : (numrecs == 0xFFFFFFFFULL);
+  // Dimensions
+  unsigned long long tag = hdr.U32();
+  unsigned long long ndims = hdr.Count();
+  if (tag != CDF_DIMENSION && !(tag == 0 && ndims == 0))
+    return SetError("Bad dimension list in header.");
+  for (unsigned long long i = 0; i < ndims && !hdr.Short(); i++) {
+    Dim dim;
+    dim.name_ = hdr.Name();
+    dim.len_ = (size_t)hdr.Size();
+    dim.unlimited_ = (dim.len_ == 0);
+    dims_.push_back( dim );
+  }
+  // Global attributes
+  if (SkipAttributes(hdr)) return SetError("Bad global attribute list in header.");
+  // Variables
+  tag = hdr.U32();
+  unsigned long long nvars = hdr.Count();
+  if (tag != CDF_VARIABLE && !(tag == 0 && nvars == 0))
+    return SetError("Bad variable list in header.");
+  for (unsigned long long i = 0; i < nvars && !hdr.Short(); i++) {
+    Var var;
+    var.name_ = hdr.Name();
+    unsigned long long vdims = hdr.Count();
+    for (unsigned long long j = 0; j < vdims && !hdr.Short(); j++)
+      var.dimids_.push_back( (size_t)hdr.Size() );
+    if (SkipAttributes(hdr)) return SetError("Bad attribute list for variable " + var.name_);
+    var.type_ = (int)hdr.U32();
+    hdr.Size(); // vsize; calculated below since it may be clamped for large variables.
+    var.begin_ = (off_t)hdr.Offset();
+    if (hdr.Short()) break;
+    var.typeSize_ = CdfTypeSize( var.type_ );
+    if (var.typeSize_ == 0) return SetError("Unknown type for variable " + var.name_);
+    for (std::vector<size_t>::const_iterator id = var.dimids_.begin(); id != var.dimids_.end(); ++id)
+    {
+      if (*id >= dims_.size()) return SetError("Bad dimension ID for variable " + var.name_);
+      if (dims_[*id].unlimited_) {
+        if (id != var.dimids_.begin())
+          return SetError("Unlimited dimension not first for variable " + var.name_);
+        var.isRec_ = true;
+      } else
+        var.nelems_ *= dims_[*id].len_;
+    }
+    vars_.push_back( var );
+  }
+  if (hdr.Bad()) {
+    if (fileSize <= (off_t)MAX_HEADER_SIZE)
+      return SetError("Bad header; lengths or counts extend past end of file.");
+    return SetError("Header too large/corrupt.");
+  }
+  if (hdr.Short()) return 1;
+  // Size of each record is the sum of all record variable sizes. If there
+  // is only one record variable, its size is not padded.
+  unsigned int nrecvars = 0;
+  off_t firstRec = fileSize;
+  recsize_ = 0;
+  for (VarArray::const_iterator var = vars_.begin(); var != vars_.end(); ++var) {
+    if (var->isRec_) {
+      nrecvars++;
+      recsize_ += (off_t)Pad4(var->nelems_ * var->typeSize_);
+      if (var->begin_ < firstRec) firstRec = var->begin_;
+    }
+  }
+  if (nrecvars == 1) {
+    for (VarArray::const_iterator var = vars_.begin(); var != vars_.end(); ++var)
+      if (var->isRec_) recsize_ = (off_t)(var->nelems_ * var->typeSize_);
+  }
+  // Number of records may not have been written yet.
+  if (streaming)
+    numrecs = (recsize_ > 0 && fileSize > firstRec) ? (fileSize - firstRec) / recsize_ : 0;
+  for (DimArray::iterator dim = dims_.begin(); dim != dims_.end(); ++dim)
+    if (dim->unlimited_) dim->len_ = (size_t)numrecs;
+  return 0;
+}
+
+/** Open file and read dimension/variable info from the header. */
+int NetcdfFile::Open(std::string const& fname) {
+  Profile::Timer timer("NetCDF open");
+  Close();
+  fname_ = fname;
+  err_.clear();
+  fd_ = open(fname.c_str(), O_RDONLY);
+  if (fd_ == -1) {
+    SetError( strerror(errno) );
+    return 1;
+  }
+  struct stat file_stat;
+  if (fstat(fd_, &file_stat) != 0) {
+    SetError( strerror(errno) );
+    Close();
+    return 1;
+  }
+  off_t fileSize = file_stat.st_size;
+  // Amber headers are only a few KB; read more only if needed, up to MAX_HEADER_SIZE.
+  size_t hsize = 8192;
+  std::vector<unsigned char> header;
+  int err = 1;
+  while (err == 1) {
+    size_t nread = hsize;
+    if ((off_t)nread > fileSize) nread = (size_t)fileSize;
+    if (nread < 8) {
+      SetError("File too small to be NetCDF.");
+      err = 2;
+      break;
+    }
+    header.resize( nread );
+    if (ReadFull(fd_, &header[0], nread, 0)) {
+      SetError("Could not read header.");
+      break;
+    }
+    if (header[0] == 0x89 && header[1] == 'H' && header[2] == 'D' && header[3] == 'F') {
+      close( fd_ );
+      fd_ = -1;
+#     ifdef HAS_NETCDF
+      err = OpenLibrary( fname );
+#     else
+      SetError("NetCDF4/HDF5 format requires NetCDF library.");
+#     endif
+      break;
+    }
+    if (header[0] != 'C' || header[1] != 'D' || header[2] != 'F') {
+      SetError("Not a NetCDF file.");
+      err = 2;
+      break;
+    }
+    err = ParseHeader(&header[0], nread, fileSize);
+    if (err == 1) {
+      // Should not happen; ParseHeader() marks lengths past the limit bad.
+      if ((off_t)nread == fileSize || nread >= MAX_HEADER_SIZE) {
+        SetError("Header too large/corrupt.");
+        err = -1;
+      } else {
+        hsize *= 4;
+        if (hsize > MAX_HEADER_SIZE) hsize = MAX_HEADER_SIZE;
+      }
+    }
+  }
+  if (err != 0) {
+    Close();
+    if (err == 2) return 2;
+    return -1;
+  }
+  return 0;
+}
+
+long int NetcdfFile::DimLength(const char* name) const {
+  for (DimArray::const_iterator dim = dims_.begin(); dim != dims_.end(); ++dim)
+    if (dim->name_ == name) return (long int)dim->len_;
+  return -1;
+}
+
+const NetcdfFile::Var* NetcdfFile::FindVar(const char* name) const {
+  for (VarArray::const_iterator var = vars_.begin(); var != vars_.end(); ++var)
+    if (var->name_ == name) return &(*var);
+  return 0;
+}
+
+bool NetcdfFile::HasVar(const char* name) const {
+  return (FindVar(name) != 0);
+}
+
+/** Read values from variable, converting to double.
+  * \param name Variable name.
+  * \param rec Record (frame) to read from; must be 0 for non-record variables.
+  * \param offset Element to start reading at (within record for record variables).
+  * \param nvals Number of elements to read.
+  * \param out Output array, must hold at least nvals elements.
+  * \return 0 if OK, -1 on error.
+  */
+int NetcdfFile::GetVar(const char* name, size_t rec, size_t offset, size_t nvals, double* out)
+{
+  const Var* var = FindVar( name );
+  if (var == 0) return SetError("Variable " + std::string(name) + " not found.");
+  if (offset + nvals > var->nelems_)
+    return SetError("Read past end of variable " + var->name_);
+  if (var->isRec_) {
+    if (rec >= dims_[var->dimids_[0]].len_)
+      return SetError("Record out of range for variable " + var->name_);
+  } else if (rec != 0)
+    return SetError("Variable " + var->name_ + " has no records.");
+# ifdef HAS_NETCDF
+  if (ncid_ != -1) return GetVarLibrary(*var, rec, offset, nvals, out);
+# endif
+  if (fd_ == -1) return SetError("File not open.");
+  off_t pos = var->begin_ + (off_t)rec * recsize_ + (off_t)(offset * var->typeSize_);
+  std::vector<unsigned char> buf( nvals * var->typeSize_ );
+  if (nvals > 0 && ReadFull(fd_, &buf[0], buf.size(), pos))
+    return SetError("Could not read variable " + var->name_);
+  const unsigned char* ptr = &buf[0];
+  for (size_t i = 0; i != nvals; i++, ptr += var->typeSize_) {
+    switch (var->type_) {
+      case CDF_DOUBLE : {
+        unsigned long long ival = BigEndian64( ptr );
+        memcpy(out + i, &ival, sizeof(double));
+        break; }
+      case CDF_FLOAT : {
+        unsigned int ival = BigEndian32( ptr );
+        float fval;
+        memcpy(&fval, &ival, sizeof(float));
+        out[i] = (double)fval;
+        break; }
+      case CDF_INT   : out[i] = (double)(int)BigEndian32( ptr ); break;
+      case CDF_SHORT : out[i] = (double)(short)((ptr[0] << 8) | ptr[1]); break;
+      case CDF_BYTE  : out[i] = (double)(signed char)ptr[0]; break;
+      default: return SetError("Unsupported type for variable " + var->name_);
+    }
+  }
+  return 0;
+}
+
+#ifdef HAS_NETCDF
+/** Get dimension and variable info with the NetCDF library. */
+int NetcdfFile::OpenLibrary(std::string const& fname) {
+  int err = 0;
+  // NetCDF library calls are not thread-safe.
+# ifdef _OPENMP
+# pragma omp critical(netcdf)
+# endif
+  {
+  int ncerr = nc_open(fname.c_str(), NC_NOWRITE, &ncid_);
+  if (ncerr != NC_NOERR) {
+    SetError( nc_strerror(ncerr) );
+    ncid_ = -1;
+    err = -1;
+  } else {
+    int ndims = 0, nvars = 0, unlimitedID = -1;
+    nc_inq(ncid_, &ndims, &nvars, 0, &unlimitedID);
+    char name[NC_MAX_NAME+1];
+    dims_.resize( ndims );
+    for (int id = 0; id != ndims; id++) {
+      nc_inq_dim(ncid_, id, name, &(dims_[id].len_));
+      dims_[id].name_.assign( name );
+      dims_[id].unlimited_ = (id == unlimitedID);
+    }
+    vars_.resize( nvars );
+    for (int vid = 0; vid != nvars; vid++) {
+      Var& var = vars_[vid];
+      nc_type vtype;
+      int vdims = 0;
+      int dimids[NC_MAX_VAR_DIMS];
+      nc_inq_var(ncid_, vid, name, &vtype, &vdims, dimids, 0);
+      var.name_.assign( name );
+      var.type_ = (int)vtype;
+      var.typeSize_ = CdfTypeSize( var.type_ );
+      for (int j = 0; j != vdims; j++) {
+        var.dimids_.push_back( dimids[j] );
+        if (j == 0 && dimids[j] == unlimitedID)
+          var.isRec_ = true;
+        else
+          var.nelems_ *= dims_[dimids[j]].len_;
+      }
+    }
+  }
+  }
+  return err;
+}
+
+/** Read variable values with the NetCDF library. The element range must
+  * correspond to whole rows of the first non-record dimension.
+  */
+int NetcdfFile::GetVarLibrary(Var const& var, size_t rec, size_t offset, size_t nvals,
+                              double* out)
+{
+  size_t start[NC_MAX_VAR_DIMS];
+  size_t count[NC_MAX_VAR_DIMS];
+  size_t ndims = var.dimids_.size();
+  size_t firstDim = 0;
+  if (var.isRec_) {
+    start[0] = rec;
+    count[0] = 1;
+    firstDim = 1;
+  }
+  if (firstDim < ndims) {
+    size_t rowSize = 1;
+    for (size_t j = firstDim + 1; j < ndims; j++) {
+      start[j] = 0;
+      count[j] = dims_[var.dimids_[j]].len_;
+      rowSize *= count[j];
+    }
+    if (offset % rowSize != 0 || nvals % rowSize != 0)
+      return SetError("Partial row read not supported for variable " + var.name_);
+    start[firstDim] = offset / rowSize;
+    count[firstDim] = nvals / rowSize;
+  }
+  int ncerr;
+# ifdef _OPENMP
+# pragma omp critical(netcdf)
+# endif
+  ncerr = nc_get_vara_double(ncid_, (int)(&var - &vars_[0]), start, count, out);
+  if (ncerr != NC_NOERR) return SetError( nc_strerror(ncerr) );
+  return 0;
+}
+#endif /* HAS_NETCDF */
@@ -0,0 +1,74 @@
+#ifndef INC_NETCDFFILE_H
+#define INC_NETCDFFILE_H
+#include <string>
+#include <vector>
+#include <sys/types.h> // off_t
+/// Minimal read-only access to dimensions and variables in a NetCDF file.
+/** Classic (CDF-1), 64-bit offset (CDF-2) and 64-bit data (CDF-5) files
+  * are read directly: one read of the header, then one targeted read per
+  * variable access. Other formats (NetCDF4/HDF5) are read with the NetCDF
+  * library if available. Nothing is printed so that different files may
+  * be read in parallel; errors are available via Error().
+  */
+class NetcdfFile {
+  public:
+    NetcdfFile();
+    ~NetcdfFile();
+    /// Open file and read header. \return 0 if OK, 1 if file could not be opened, 2 if not NetCDF, -1 if bad format.
+    int Open(std::string const&);
+    /// Close file.
+    void Close();
+    /// \return Length of dimension with given name, -1 if not present.
+    long int DimLength(const char*) const;
+    /// \return True if variable with given name is present.
+    bool HasVar(const char*) const;
+    /// Read # values from variable starting at element offset in given record (0 for non-record vars).
+    int GetVar(const char*, size_t, size_t, size_t, double*);
+    /// \return Description of last error.
+    std::string const& Error() const { return err_; }
+  private:
+    /// Dimension name and length.
+    class Dim {
+      public:
+        Dim() : len_(0), unlimited_(false) {}
+        std::string name_;
+        size_t len_;
+        bool unlimited_;
+    };
+    /// Variable name, shape, type, and location in file.
+    class Var {
+      public:
+        Var() : type_(0), typeSize_(0), nelems_(1), begin_(0), isRec_(false) {}
+        std::string name_;
+        std::vector<size_t> dimids_;
+        int type_;        ///< NetCDF external type.
+        size_t typeSize_; ///< Size of single element in bytes.
+        size_t nelems_;   ///< # elements (per record if record variable).
+        off_t begin_;     ///< Offset of data (first record if record variable).
+        bool isRec_;      ///< True if first dimension is the unlimited dimension.
+    };
+    typedef std::vector<Dim> DimArray;
+    typedef std::vector<Var> VarArray;
+
+    /// Read header from start of file with given # bytes. \return 0 if OK, 1 if more needed, -1 on error.
+    int ParseHeader(const unsigned char*, size_t, off_t);
+    /// \return Pointer to variable with given name, 0 if not present.
+    const Var* FindVar(const char*) const;
+    /// Set error message. \return -1
+    int SetError(std::string const&);
+#   ifdef HAS_NETCDF
+    /// Read header info with the NetCDF library.
+    int OpenLibrary(std::string const&);
+    /// Read variable with the NetCDF library.
+    int GetVarLibrary(Var const&, size_t, size_t, size_t, double*);
+#   endif
+
+    DimArray dims_;      ///< File dimensions.
+    VarArray vars_;      ///< File variables.
+    std::string err_;    ///< Last error message.
+    std::string fname_;  ///< File name.
+    off_t recsize_;      ///< Size of a single record (all record variables).
+    int fd_;             ///< File descriptor (native read).
+    int ncid_;           ///< NetCDF ID (library read).
+};
+#endif
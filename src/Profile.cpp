@@ -0,0 +1,209 @@
+#include <cstdio>     // snprintf
+#include <cstdlib>    // atexit
+#include <cstring>    // strcmp
+#include <string>
+#include <vector>
+#include <sys/time.h> // gettimeofday
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+#include "Profile.h"
+#include "Messages.h"
+
+using namespace Messages;
+
+/** A timed region or an event counter. */
+struct Node {
+  const char* name_;         ///< Region name; points to a string literal.
+  int parent_;               ///< Parent region index, -1 for the root.
+  bool timed_;               ///< True if a timed region, false if a counter.
+  double time_;              ///< Total wall time in region (summed over threads).
+  long int calls_;           ///< Number of times region entered or events counted.
+  std::vector<int> children_; ///< Child regions/counters in the order first seen.
+};
+typedef std::vector<Node> NodeArray;
+
+static bool enabled_ = false; ///< True if profiling.
+static bool json_ = false;    ///< True if report should be JSON.
+static double start_ = 0.0;   ///< Time profiling was enabled.
+static NodeArray Nodes_;      ///< All regions; the first is the root.
+static int outer_ = 0;        ///< Region active outside of parallel loops.
+static int current_ = -1;     ///< Region active on this thread, -1 to use outer_.
+#ifdef _OPENMP
+#pragma omp threadprivate(current_)
+#endif
+
+/** \return Current wall time in seconds. */
+static double WallTime() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return (double)tv.tv_sec + ((double)tv.tv_usec / 1000000.0);
+}
+
+/** \return Region active on this thread. Must be called inside the profile
+  *         critical section.
+  */
+static int CurrentNode() {
+  if (current_ != -1) return current_;
+  return outer_;
+}
+
+/** Set region active on this thread. Must be called inside the profile
+  * critical section.
+  */
+static void SetCurrentNode(int node) {
+  current_ = node;
+# ifdef _OPENMP
+  if (!omp_in_parallel())
+# endif
+    outer_ = (node == -1) ? 0 : node;
+}
+
+/** \return Index of child of parent with given name and type, creating it
+  *         if necessary. Must be called inside the profile critical section.
+  */
+static int ChildNode(int parent, const char* name, bool timed) {
+  std::vector<int> const& children = Nodes_[parent].children_;
+  for (std::vector<int>::const_iterator it = children.begin(); it != children.end(); ++it)
+    if (Nodes_[*it].timed_ == timed && strcmp(Nodes_[*it].name_, name) == 0)
+      return *it;
+  Node node;
+  node.name_ = name;
+  node.parent_ = parent;
+  node.timed_ = timed;
+  node.time_ = 0.0;
+  node.calls_ = 0;
+  Nodes_.push_back( node );
+  int idx = (int)Nodes_.size() - 1;
+  Nodes_[parent].children_.push_back( idx );
+  return idx;
+}
+
+/** Enable profiling. The report is printed at exit.
+  * \param format Report format, "text" or "json".
+  * \return 0 if OK, 1 if format not recognized.
+  */
+int Profile::Enable(const char* format) {
+  if (strcmp(format, "json") == 0)
+    json_ = true;
+  else if (strcmp(format, "text") == 0)
+    json_ = false;
+  else
+    return 1;
+  if (!enabled_) {
+    enabled_ = true;
+    start_ = WallTime();
+    Nodes_.clear();
+    Node root;
+    root.name_ = "total";
+    root.parent_ = -1;
+    root.timed_ = true;
+    root.time_ = 0.0;
+    root.calls_ = 1;
+    Nodes_.push_back( root );
+    outer_ = 0;
+    atexit( Report );
+  }
+  return 0;
+}
+
+bool Profile::Enabled() { return enabled_; }
+
+/** Add events to the named counter beneath the current region. */
+void Profile::Count(const char* name, long int nevents) {
+  if (!enabled_) return;
+# ifdef _OPENMP
+# pragma omp critical(profile)
+# endif
+  Nodes_[ ChildNode(CurrentNode(), name, false) ].calls_ += nevents;
+}
+
+/** Start timing named region beneath the current region. */
+Profile::Timer::Timer(const char* name) : node_(-1), prev_(-1), start_(0.0) {
+  if (!enabled_) return;
+# ifdef _OPENMP
+# pragma omp critical(profile)
+# endif
+  {
+  prev_ = current_;
+  node_ = ChildNode(CurrentNode(), name, true);
+  SetCurrentNode( node_ );
+  }
+  start_ = WallTime();
+}
+
+Profile::Timer::~Timer() {
+  Stop();
+}
+
+/** Stop timing and restore the previous region. */
+void Profile::Timer::Stop() {
+  if (node_ == -1) return;
+  double elapsed = WallTime() - start_;
+# ifdef _OPENMP
+# pragma omp critical(profile)
+# endif
+  {
+  Nodes_[node_].time_ += elapsed;
+  Nodes_[node_].calls_++;
+  SetCurrentNode( prev_ );
+  }
+  node_ = -1;
+}
+
+/** Print region and its children as text. */
+static void PrintText(int idx, int depth, double total) {
+  Node const& node = Nodes_[idx];
+  std::string name( 2 * depth, ' ' );
+  name.append( node.name_ );
+  if (node.timed_)
+    Msg("  %-40s %12.6f %6.1f %10li\n", name.c_str(), node.time_,
+        (total > 0.0) ? 100.0 * node.time_ / total : 0.0, node.calls_);
+  else
+    Msg("  %-40s %12s %6s %10li\n", name.c_str(), "-", "-", node.calls_);
+  for (std::vector<int>::const_iterator it = node.children_.begin(); it != node.children_.end(); ++it)
+    PrintText(*it, depth + 1, total);
+}
+
+/** \return Region and its children as a JSON object. */
+static std::string JsonNode(int idx) {
+  Node const& node = Nodes_[idx];
+  char buffer[128];
+  std::string out("{\"name\":\"");
+  out.append( node.name_ );
+  out.append( "\"" );
+  if (node.timed_) {
+    snprintf(buffer, 128, ",\"time_s\":%.6f,\"calls\":%li", node.time_, node.calls_);
+    out.append( buffer );
+  } else {
+    snprintf(buffer, 128, ",\"count\":%li", node.calls_);
+    out.append( buffer );
+  }
+  if (!node.children_.empty()) {
+    out.append( ",\"regions\":[" );
+    for (std::vector<int>::const_iterator it = node.children_.begin(); it != node.children_.end(); ++it) {
+      if (it != node.children_.begin()) out.append( "," );
+      out.append( JsonNode(*it) );
+    }
+    out.append( "]" );
+  }
+  out.append( "}" );
+  return out;
+}
+
+/** Print report of all regions. Text goes to the same place as other
+  * messages; JSON is printed as a single record line on stdout.
+  */
+void Profile::Report() {
+  if (!enabled_ || Nodes_.empty()) return;
+  Nodes_[0].time_ = WallTime() - start_;
+  if (json_) {
+    std::string root = JsonNode(0);
+    // Replace the opening brace of the root object with the record type.
+    Data("{\"record\":\"profile\",%s\n", root.c_str() + 1);
+  } else {
+    Msg("Profile (time in parallel loops is summed over threads; '-' is a count):\n");
+    Msg("  %-40s %12s %6s %10s\n", "Region", "Time(s)", "%", "Calls");
+    PrintText(0, 0, Nodes_[0].time_);
+  }
+}
@@ -0,0 +1,36 @@
+#ifndef INC_PROFILE_H
+#define INC_PROFILE_H
+/// Wall time and call counts for nested regions of the program.
+/** When enabled, each Timer adds its elapsed time to a region named after it
+  * beneath whatever region is active on the current thread; regions started
+  * in worker threads of a parallel loop go beneath the region active when the
+  * loop started. Count() records events (e.g. system calls) that are too
+  * cheap to time. When disabled, Timer and Count() do nothing.
+  */
+namespace Profile {
+
+/// Enable profiling; the report is printed in the given format at exit.
+int Enable(const char*);
+/// \return true if profiling is enabled.
+bool Enabled();
+/// Add given number of events to the named counter beneath the current region.
+void Count(const char*, long int = 1);
+/// Print report of all regions; called at exit when profiling is enabled.
+void Report();
+
+/// Time a region from construction until destruction.
+class Timer {
+  public:
+    /// Start timing region with given name (a string literal).
+    Timer(const char*);
+    ~Timer();
+    /// Stop timing region before destruction.
+    void Stop();
+  private:
+    int node_;     ///< Region being timed, -1 if not profiling.
+    int prev_;     ///< Region active before this one.
+    double start_; ///< Start wall time.
+};
+
+}
+#endif
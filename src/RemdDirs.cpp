@@ -1,10 +1,14 @@
 #include <cstring> // strstr
 #include <cstdlib> // atoi, atof
+#include <algorithm> // std::copy
 #include "RemdDirs.h"
 #include "Messages.h"
 #include "TextFile.h"
 #include "StringRoutines.h"
 #include "ReplicaDimension.h"
+#include "ExchangeStats.h"
+#include "Profile.h"
+#include "ArchiveManifest.h"
 
 using namespace Messages;
 using namespace StringRoutines;
@@ -22,12 +26,15 @@ RemdDirs::RemdDirs() :
   temp0_dim_(-1),
   ph_dim_(-1),
   debug_(0),
+  nthreads_(1),
   n_md_runs_(0),
   umbrella_(0),
+  templateIsRun0_(false),
   override_irest_(false),
   override_ntx_(false),
   uselog_(true),
-  crdDirSpecified_(false)
+  crdDirSpecified_(false),
+  rebalance_(false)
 {}
 
 // DESTRUCTOR
@@ -237,14 +244,17 @@ int RemdDirs::LoadDimension(std::string const& dfile) {
     return 1;
   }
   infile.Close(); 
-  // Allocate proper dimension type and load.
-  ReplicaDimension* dim = ReplicaAllocator::Allocate( firstLine );
+  // Allocate proper dimension type and load. The type is the first word;
+  // the rest of the line may hold options for the dimension.
+  std::string dimKey = firstLine.substr(0, firstLine.find_first_of(" \t\r"));
+  ReplicaDimension* dim = ReplicaAllocator::Allocate( dimKey );
   if (dim == 0) {
-    ErrorMsg("Unrecognized dimension type: %s\n", firstLine.c_str());
+    ErrorMsg("Unrecognized dimension type: %s\n", dimKey.c_str());
     return 2;
   }
   // Push it here so it will be deallocated if there is an error
   Dims_.push_back( dim ); 
+  dimFiles_.push_back( dfile );
   if (dim->LoadDim( dfile )) {
     ErrorMsg("Loading info from dimension file '%s'\n", dfile.c_str());
     return 1;
@@ -384,6 +394,23 @@ int RemdDirs::CreateRuns(std::string const& TopDir, StrArray const& RunDirs,
     ErrorMsg("No starting coords directory/file specified.\n");
     return 1;
   }
+# ifdef _OPENMP
+  if (nthreads_ > 1 && runType_ != MD)
+    Msg("Using %i threads to create replica input.\n", nthreads_);
+# else
+  if (nthreads_ > 1)
+    Msg("Warning: Compiled without OpenMP; ignoring number of create threads (%i).\n", nthreads_);
+# endif
+  if (rebalance_ && runType_ != MD) {
+    if (start < 1) {
+      ErrorMsg("Rebalancing dimensions requires a previous run.\n");
+      return 1;
+    }
+    // Run directory names all have the width of the last run (see main()).
+    int stop = start + (int)RunDirs.size() - 1;
+    std::string prevDir = "run." + integerToString(start - 1, std::max(DigitWidth(stop), 3));
+    if (RebalanceDims(TopDir, prevDir)) return 1;
+  }
   int run = start;
   for (StrArray::const_iterator runDir = RunDirs.begin();
                                 runDir != RunDirs.end(); ++runDir, ++run)
@@ -402,6 +429,56 @@ int RemdDirs::CreateRuns(std::string const& TopDir, StrArray const& RunDirs,
     else
       err = CreateRemd(start, run, *runDir);
     if (err) return 1;
+    if (run == start && WriteRebalancedDims()) return 1;
+  }
+  return 0;
+}
+
+/** Set dimension values for uniform acceptance from the exchange
+  * acceptance observed in the given run. Temperatures are taken from the
+  * run's rem.log when present, so the run need not have used the current
+  * dimension files.
+  */
+int RemdDirs::RebalanceDims(std::string const& TopDir, std::string const& prevDir) {
+  Msg("Rebalancing dimensions from exchanges in '%s'\n", prevDir.c_str());
+  ExchangeStats stats;
+  stats.SetDebug(debug_);
+  if (stats.Read( TopDir, StrArray(1, prevDir) )) return 1;
+  if (stats.Ndims() != Dims_.size()) {
+    ErrorMsg("'%s' has %u exchange dimensions, expected %u.\n", prevDir.c_str(),
+             stats.Ndims(), (unsigned int)Dims_.size());
+    return 1;
+  }
+  // Acceptance from fewer attempts is too noisy to rebalance with.
+  static const long int MIN_ATTEMPTS = 10;
+  rebalanced_.assign( Dims_.size(), false );
+  for (unsigned int id = 0; id != Dims_.size(); id++) {
+    std::vector<double> acceptance;
+    if (stats.LadderAcceptance( id, MIN_ATTEMPTS, acceptance )) {
+      ErrorMsg("Fewer than %li exchanges attempted between some neighbors in dimension %u.\n",
+               MIN_ATTEMPTS, id + 1);
+      return 1;
+    }
+    int err = Dims_[id]->Rebalance( stats.LadderTemps(id), acceptance );
+    if (err == -1)
+      Msg("    Dim %u: %s values cannot be rebalanced; unchanged.\n", id + 1, Dims_[id]->name());
+    else if (err != 0) {
+      ErrorMsg("Rebalancing dimension %u failed.\n", id + 1);
+      return 1;
+    } else
+      rebalanced_[id] = true;
+  }
+  return 0;
+}
+
+/** Dimension files are written with the same name as the original. */
+int RemdDirs::WriteRebalancedDims() const {
+  for (unsigned int id = 0; id != rebalanced_.size(); id++) {
+    if (rebalanced_[id]) {
+      std::string fname = dimFiles_[id].substr( dimFiles_[id].find_last_of('/') + 1 );
+      Msg("    Writing rebalanced dimension %u to '%s'\n", id + 1, fname.c_str());
+      if (Dims_[id]->WriteDim( fname )) return 1;
+    }
   }
   return 0;
 }
@@ -517,17 +594,26 @@ int RemdDirs::CreateAnalyzeArchive(std::string const& TopDir, StrArray const& Ru
     int run = start;
     for (StrArray::const_iterator rdir = RunDirs.begin(); rdir != RunDirs.end(); ++rdir, ++run)
     {
-      // Check if traj archive already exists for this run.
-      std::string TARFILE( ARDIR + "/traj." + *rdir + ".tgz" );
-      if (!overwrite && fileExists(TARFILE)) {
-        ErrorMsg("Trajectory archive %s already exists.\n", TARFILE.c_str());
-        return 1;
-      }
-      // Check if non-traj archive exists for this run
-      TARFILE.assign( *rdir + ".tgz" );
-      if (!overwrite && fileExists(TARFILE)) {
-        ErrorMsg("Run archive %s already exists.\n", TARFILE.c_str());
-        return 1;
+      // Check if traj or non-traj archive (gzip or zstd) already exists for this run.
+      // Runs archived with a manifest can have gzip archives; later passes
+      // add new archives (--archive-exec for new/changed files, or tar for
+      // everything) under the next free name, so none are overwritten.
+      static const char* TAREXT[] = { ".tgz", ".tar.zst", 0 };
+      bool hasManifest = fileExists( ArchiveManifest::FileName(*rdir) );
+      if (hasManifest)
+        Msg("Archive manifest present for %s; only new/changed files will be archived.\n",
+            rdir->c_str());
+      for (const char** ext = TAREXT + (hasManifest ? 1 : 0); *ext != 0; ++ext) {
+        std::string TARFILE( ARDIR + "/traj." + *rdir + *ext );
+        if (!overwrite && fileExists(TARFILE)) {
+          ErrorMsg("Trajectory archive %s already exists.\n", TARFILE.c_str());
+          return 1;
+        }
+        TARFILE.assign( *rdir + *ext );
+        if (!overwrite && fileExists(TARFILE)) {
+          ErrorMsg("Run archive %s already exists.\n", TARFILE.c_str());
+          return 1;
+        }
       }
       // Create cpptraj input
       TextFile ARIN;
@@ -553,7 +639,7 @@ int RemdDirs::CreateAnalyzeArchive(std::string const& TopDir, StrArray const& Ru
 
     // Create run script.
     const char* CPPTRAJERR =
-      "  if [[ $? -ne 0 ]] ; then\n    echo \"CPPTRAJ error.\"\n    exit 1\n  fi";
+      "    if [[ $? -ne 0 ]] ; then\n      echo \"CPPTRAJ error.\"\n      return 1\n    fi";
     std::string scriptName("RunArchive." + integerToString(start) + "."
                            + integerToString(stop) + ".sh");
     if (!overwrite && fileExists(scriptName)) {
@@ -562,51 +648,126 @@ int RemdDirs::CreateAnalyzeArchive(std::string const& TopDir, StrArray const& Ru
     }
     TextFile runScript;
     if (runScript.OpenWrite( scriptName )) return 1;
-    runScript.Printf("#!/bin/bash\n\nTOTALTIME0=`date +%%s`\nRUN=%i\nfor DIR in", start);
-    for (StrArray::const_iterator rdir = RunDirs.begin(); rdir != RunDirs.end(); ++rdir)
-      runScript.Printf(" %s", rdir->c_str());
+    runScript.Printf(
+      "#!/bin/bash\n\nTOTALTIME0=`date +%%s`\n"
+      "# Number of runs to archive at once, and threads for each.\n"
+      "if [[ -z $ARCHIVE_JOBS ]] ; then\n  ARCHIVE_JOBS=1\nfi\n"
+      "if [[ -z $ARCHIVE_THREADS ]] ; then\n  ARCHIVE_THREADS=1\nfi\n"
+      "# Compress with pigz (parallel gzip) if available. Set ARCHIVE_COMPRESS=zstd\n"
+      "# to use multithreaded zstd instead.\n"
+      "EXT=tgz\n"
+      "if [[ $ARCHIVE_COMPRESS = 'zstd' ]] ; then\n"
+      "  EXT=tar.zst\n  COMPRESS=\"zstd -q -T$ARCHIVE_THREADS\"\n"
+      "elif [[ ! -z `which pigz 2> /dev/null` ]] ; then\n"
+      "  COMPRESS=\"pigz -p $ARCHIVE_THREADS\"\n"
+      "else\n  COMPRESS=gzip\nfi\n"
+      "# For gzip archives, have CreateRemdDirs (from PATH unless CREATEREMDDIRS is\n"
+      "# set) walk each run once and compress in-process (--archive-exec). Set\n"
+      "# CREATEREMDDIRS=none to use tar instead.\n"
+      "if [[ -z $CREATEREMDDIRS ]] ; then\n  CREATEREMDDIRS=`command -v CreateRemdDirs`\nfi\n"
+      "if [[ $EXT != 'tgz' || ! -x $CREATEREMDDIRS ]] ; then\n  CREATEREMDDIRS=\nfi\n\n"
+      "# Archive <archive> <files>: Create compressed tar archive.\n"
+      "Archive() {\n  TARFILE=$1\n  shift\n"
+      "  echo \"tar -cvf - | $COMPRESS > $TARFILE\"\n"
+      "  tar -cvf - $* | $COMPRESS > $TARFILE\n"
+      "  if [[ ${PIPESTATUS[0]} -ne 0 || ${PIPESTATUS[1]} -ne 0 ]] ; then\n"
+      "    echo \"Error: Could not create $TARFILE\" >> /dev/stderr\n"
+      "    return 1\n  fi\n  return 0\n}\n\n"
+      "# NextArchive <prefix>: Print <prefix>.$EXT, or <prefix>.<#>.$EXT with the\n"
+      "# lowest # that does not exist yet, so earlier archives are never replaced.\n"
+      "NextArchive() {\n  NAME=$1.$EXT\n  N=1\n"
+      "  while [[ -e $NAME ]] ; do\n    NAME=$1.$N.$EXT\n    ((N++))\n  done\n"
+      "  echo $NAME\n}\n\n");
     const char* tprefix;
     if (runType_ == MD)
       tprefix = "md.nc";
     else
       tprefix = "TRAJ";
-    runScript.Printf(" ; do\n  TIME0=`date +%%s`\n"
-                     "  # Put everything but trajectories into a separate archive.\n"
-                     "  TARFILE=$DIR.tgz\n"
-                     "  FILELIST=""\n  for FILE in `find $DIR -name \"*\"` ; do\n"
-                     "    if [[ ! -d $FILE ]] ; then\n"
-                     "      if [[ `echo \"$FILE\" | awk '{print index($0,\"%s\");}'` -eq 0 ]] ; then\n"
-                     "        # Not a TRAJ directory file\n"
-                     "        FILELIST=$FILELIST\" $FILE\"\n      fi\n    fi\n"
-                     "  done\n  echo \"tar -czvf $TARFILE\"\n  tar -czvf $TARFILE $FILELIST\n", tprefix);
+    runScript.Printf("# ArchiveRun <dir> <run #>: Archive the given run.\n"
+                     "ArchiveRun() {\n  DIR=$1\n  RUN=$2\n  TIME0=`date +%%s`\n"
+                     "  if [[ -z $CREATEREMDDIRS ]] ; then\n"
+                     "    # Put everything but trajectories into a separate archive.\n"
+                     "    FILELIST=""\n    for FILE in `find $DIR -name \"*\"` ; do\n"
+                     "      if [[ ! -d $FILE ]] ; then\n"
+                     "        if [[ `echo \"$FILE\" | awk '{print index($0,\"%s\");}'` -eq 0 ]] ; then\n"
+                     "          # Not a TRAJ directory file\n"
+                     "          FILELIST=$FILELIST\" $FILE\"\n        fi\n      fi\n"
+                     "    done\n    Archive `NextArchive $DIR` $FILELIST || return 1\n  fi\n", tprefix);
+    // Sorted/stripped trajectories recorded in the archive manifest as
+    // unchanged and made from unchanged trajectories do not need cpptraj.
+    runScript.Printf(
+        "  TRAJCURRENT=0\n"
+        "  if [[ ! -z $CREATEREMDDIRS ]] ; then\n"
+        "    $CREATEREMDDIRS --archive-current $DIR && TRAJCURRENT=1\n"
+        "  fi\n"
+        "  if [[ $TRAJCURRENT -eq 0 ]] ; then\n");
     if ( fullarchive_ != "NONE") {
       // Add command to script for full archive of this run
       runScript.Printf(
-        "  # Sort and save the unbiased fully-solvated trajs\n"
-        "  cd %s\n  $MPIRUN $EXEPATH -i ar1.$RUN.cpptraj.in\n%s\n"
-        "  cd ..\n  FILELIST=`ls $DIR/TRAJ/wat.nc.*`\n"
-        "  if [[ -z $FILELIST ]] ; then\n"
-        "    echo \"Error: Sorted solvated trajectories not found.\" >> /dev/stderr\n"
-        "    exit 1\n  fi\n", ARDIR.c_str(), CPPTRAJERR); 
-    }
+        "    # Sort and save the unbiased fully-solvated trajs\n"
+        "    cd %s\n    $MPIRUN $EXEPATH -i ar1.$RUN.cpptraj.in\n%s\n"
+        "    cd ..\n    FILELIST=`ls $DIR/TRAJ/wat.nc.*`\n"
+        "    if [[ -z $FILELIST ]] ; then\n"
+        "      echo \"Error: Sorted solvated trajectories not found.\" >> /dev/stderr\n"
+        "      return 1\n    fi\n", ARDIR.c_str(), CPPTRAJERR); 
+    } else
+      runScript.Printf("    FILELIST=\n");
     // Add command to script for stripped archive of this run
     runScript.Printf(
-        "  # Save all of the stripped trajs.\n"
-        "  cd %s\n  $MPIRUN $EXEPATH -i ar2.$RUN.cpptraj.in\n%s\n" 
-        "  cd ..\n"
-        "  for OUTTRAJ in `ls $DIR/TRAJ/nowat.nc.*` ; do\n"
-        "    FILELIST=$FILELIST\" $OUTTRAJ\"\n"
-        "  done\n  TARFILE=%s/traj.$DIR.tgz\n"
-        "  echo \"tar -czvf $TARFILE\"\n"
-        "  tar -czvf $TARFILE $FILELIST\n"
+        "    # Save all of the stripped trajs.\n"
+        "    cd %s\n    $MPIRUN $EXEPATH -i ar2.$RUN.cpptraj.in\n%s\n" 
+        "    cd ..\n"
+        "  fi\n"
+        "  if [[ -z $CREATEREMDDIRS ]] ; then\n"
+        "    for OUTTRAJ in `ls $DIR/TRAJ/nowat.nc.*` ; do\n"
+        "      FILELIST=$FILELIST\" $OUTTRAJ\"\n"
+        "    done\n"
+        "    TRAJTAR=`NextArchive %s/traj.$DIR`\n"
+        "    Archive $TRAJTAR $FILELIST || return 1\n"
+        "    echo \"$TRAJTAR\" > %s/archive.$DIR.trajs\n"
+        "  else\n"
+        "    # New/changed files only: everything but trajectories, then\n"
+        "    # sorted/stripped trajectories.\n"
+        "    $CREATEREMDDIRS --archive-exec $DIR %s || return 1\n"
+        "  fi\n"
         "  TIME1=`date +%%s`\n  ((TOTAL = $TIME1 - $TIME0))\n"
         "  echo \"$DIR took $TOTAL seconds to archive.\"\n"
-        "  echo \"$TARFILE\" >> TrajArchives.txt\n"
+        "  return 0\n}\n\n",
+        ARDIR.c_str(), CPPTRAJERR, ARDIR.c_str(), ARDIR.c_str(), ARDIR.c_str());
+    std::string LOGFILE( ARDIR + "/archive.${DIRS[0]}.log" );
+    std::string TRAJLIST( ARDIR + "/archive.${DIRS[0]}.trajs" );
+    runScript.Printf(
+        "# Each run is archived in the background with output to a log. Jobs are\n"
+        "# finished in run order so output and TrajArchives.txt are in run order.\n"
+        "PIDS=()\nDIRS=()\nERR=0\n"
+        "# FinishJob: Wait for the oldest job, print its output, and record the\n"
+        "# trajectory archives it wrote.\n"
+        "FinishJob() {\n  wait ${PIDS[0]}\n  JOBERR=$?\n"
+        "  cat %s\n  rm %s\n"
+        "  if [[ $JOBERR -eq 0 ]] ; then\n"
+        "    cat %s >> TrajArchives.txt\n"
+        "  else\n"
+        "    echo \"Error: Archiving ${DIRS[0]} failed.\" >> /dev/stderr\n"
+        "    ERR=1\n  fi\n"
+        "  rm -f %s\n"
         "  echo \"--------------------------------------------------------------\"\n"
+        "  PIDS=(${PIDS[@]:1})\n  DIRS=(${DIRS[@]:1})\n}\n"
+        "RUN=%i\nfor DIR in", LOGFILE.c_str(), LOGFILE.c_str(), TRAJLIST.c_str(),
+        TRAJLIST.c_str(), start);
+    for (StrArray::const_iterator rdir = RunDirs.begin(); rdir != RunDirs.end(); ++rdir)
+      runScript.Printf(" %s", rdir->c_str());
+    runScript.Printf(
+        " ; do\n"
+        "  # Do not start any more runs after an error.\n"
+        "  if [[ $ERR -ne 0 ]] ; then\n    break\n  fi\n"
+        "  ArchiveRun $DIR $RUN > %s/archive.$DIR.log 2>&1 &\n"
+        "  PIDS+=($!)\n  DIRS+=($DIR)\n"
+        "  if [[ ${#PIDS[@]} -ge $ARCHIVE_JOBS ]] ; then\n    FinishJob\n  fi\n"
         "  ((RUN++))\n"
-        "done\nTOTALTIME1=`date +%%s`\n((TOTAL = $TOTALTIME1 - $TOTALTIME0))\n"
-        "echo \"$TOTAL seconds total.\"\nexit 0\n",
-        ARDIR.c_str(), CPPTRAJERR, ARDIR.c_str());
+        "done\n"
+        "while [[ ${#PIDS[@]} -gt 0 ]] ; do\n  FinishJob\ndone\n"
+        "TOTALTIME1=`date +%%s`\n((TOTAL = $TOTALTIME1 - $TOTALTIME0))\n"
+        "echo \"$TOTAL seconds total.\"\nexit $ERR\n", ARDIR.c_str());
     runScript.Close();
     ChangePermissions( scriptName );
   } // END archive input
@@ -643,109 +804,92 @@ void RemdDirs::WriteNamelist(TextFile& MDIN, std::string const& namelist,
                              MdinFile::TokenArray const& tokens)
 const
 {
-  MDIN.Printf(" %s\n", namelist.c_str());
+  MDIN.PutChar(' ');
+  MDIN.Puts(namelist);
+  MDIN.PutChar('\n');
   unsigned int col = 0;
   for (MdinFile::token_iterator tkn = tokens.begin(); tkn != tokens.end(); ++tkn)
   {
     if (col == 0)
-      MDIN.Printf("   ");
+      MDIN.Puts("   ");
     
-    MDIN.Printf("%s = %s, ", tkn->first.c_str(), tkn->second.c_str());
+    MDIN.Puts(tkn->first);
+    MDIN.Puts(" = ");
+    MDIN.Puts(tkn->second);
+    MDIN.Puts(", ");
     col++;
     if (col == 4) {
-      MDIN.Printf("\n");
+      MDIN.PutChar('\n');
       col = 0;
     }
   }
   if (col != 0)
-    MDIN.Printf("\n");
-  MDIN.Printf(" &end\n");
+    MDIN.PutChar('\n');
+  MDIN.Puts(" &end\n");
 }
 
-// RemdDirs::CreateRemd()
-int RemdDirs::CreateRemd(int start_run, int run_num, std::string const& run_dir) {
-  typedef std::vector<unsigned int> Iarray;
-  // Create and change to run directory.
-  if (Mkdir(run_dir)) return 1;
-  if (ChangeDir(run_dir)) return 1;
-  // Ensure that coords directory exists.
-  if (crdDirSpecified_ && !fileExists(crd_dir_)) {
-    ErrorMsg("Coords directory '%s' not found. Must specify absolute path"
-             " or path relative to '%s'\n", crd_dir_.c_str(), run_dir.c_str());
-    return 1;
-  }
-  // If constant pH, ensure CPIN file exists
-  if (ph_dim_ != -1 && !fileExists(cpin_file_)) {
-    ErrorMsg("CPIN file '%s' not found. Must specify absolute path"
-             " or path relative to '%s'\n", cpin_file_.c_str(), run_dir.c_str());
-    return 1;
+/** Hold input info generated for a single replica. */
+class RemdDirs::RepInput {
+  public:
+    RepInput() : temp0_(0.0), singleCrd_(false) {}
+
+    std::string top_;       ///< Replica topology.
+    double temp0_;          ///< Replica temperature.
+    std::string mdin_;      ///< Replica MDIN file name.
+    std::string crd_;       ///< Replica input coordinates.
+    std::string groupline_; ///< Replica groupfile line.
+    std::string mdinText_;  ///< Replica MDIN contents if newly generated.
+    std::string error_;     ///< Set if an error occurred.
+    bool singleCrd_;        ///< True if crd_dir_ is used for all input coordinates.
+};
+
+/** Write MDIN for the given replica and generate its groupfile line. Does
+  * not print anything so that it may be called in parallel; any error is
+  * recorded in RepInput.
+  * \param rep Replica index (starting from 0).
+  * \param Indices Replica indices in each dimension.
+  * \param mdinText If not null, previously generated MDIN contents to write.
+  *        Otherwise MDIN is generated and saved in RepInput.
+  */
+void RemdDirs::CreateReplicaInput(unsigned int rep, const unsigned int* Indices, int width,
+                                  int start_run, int run_num, std::string const& run_dir,
+                                  std::string const* mdinText, RepInput& RI)
+const
+{
+  // Get topology/temperature for this replica if necessary.
+  RI.top_ = top_file_;
+  RI.temp0_ = temp0_;
+  if (top_dim_ != -1) RI.top_ = Dims_[top_dim_]->TopName( Indices[top_dim_]  );
+  if (temp0_dim_ != -1) RI.temp0_ = Dims_[temp0_dim_]->Temp0( Indices[temp0_dim_] );
+  // Ensure topology exists.
+  if (!fileExists( RI.top_ )) {
+    RI.error_ = "Topology '" + RI.top_ + "' not found. Must specify absolute path"
+                " or path relative to '" + run_dir + "'\n";
+    return;
   }
-  // Calculate ps per exchange
-  double ps_per_exchg = dt_ * (double)nstlim_;
-  // Do we need to setup groups for MREMD?
-  bool setupGroups = (groups_.Empty() && Dims_.size() > 1);
-  if (setupGroups)
-    groups_.SetupGroups( Dims_.size() );
-  // Create INPUT directory if not present.
-  std::string input_dir("INPUT");
-  if (Mkdir(input_dir)) return 1;
-  // Open GROUPFILE
-  TextFile GROUPFILE;
-  if (GROUPFILE.OpenWrite(groupfileName_)) return 1; 
-  // Figure out max width of replica extension
-  int width = std::max(DigitWidth( totalReplicas_ ), 3);
-  // Hold current indices in each dimension.
-  Iarray Indices( Dims_.size(), 0 );
-  std::string currentTop = top_file_;
-  double currentTemp0 = temp0_;
-  for (unsigned int rep = 0; rep != totalReplicas_; rep++)
-  {
-    // Get topology/temperature for this replica if necessary.
-    if (top_dim_ != -1) currentTop = Dims_[top_dim_]->TopName( Indices[top_dim_]  );
-    if (temp0_dim_ != -1) currentTemp0 = Dims_[temp0_dim_]->Temp0( Indices[temp0_dim_] );
-    // Ensure topology exists.
-    if (!fileExists( currentTop )) {
-      ErrorMsg("Topology '%s' not found. Must specify absolute path"
-               " or path relative to '%s'\n", currentTop.c_str(), run_dir.c_str());
-      return 1;
-    }
-    // Info for this replica.
-    if (debug_ > 1) {
-      Msg("\tReplica %u: top=%s  temp0=%f", rep+1, currentTop.c_str(), currentTemp0);
-      Msg("  {");
-      for (Iarray::const_iterator count = Indices.begin(); count != Indices.end(); ++count)
-        Msg(" %u", *count);
-      Msg(" }\n");
-    }
-    // Save group info
-    if (setupGroups)
-      groups_.AddReplica( Indices, rep+1 );
-    // Replica extension. 
-    std::string EXT = integerToString(rep+1, width);
+  // Replica extension. 
+  std::string EXT = integerToString(rep+1, width);
+  RI.mdin_ = "INPUT/in." + EXT;
+  if (mdinText == 0) {
     // Create input
     int irest = 1;
     int ntx = 5;
-    if (!override_irest_) {
-      if (run_num == 0) {
-        if (rep ==0)
-          Msg("    Run 0: irest=0, ntx=1\n");
-        irest = 0;
-        ntx = 1;
-      }
-    } else
-      Msg("    Using irest/ntx from MDIN.\n");
-    std::string mdin_name(input_dir + "/in." + EXT);
-    if (debug_ > 1)
-      Msg("\t\tMDIN: %s\n", mdin_name.c_str());
+    if (!override_irest_ && run_num == 0) {
+      irest = 0;
+      ntx = 1;
+    }
+    double ps_per_exchg = dt_ * (double)nstlim_;
     TextFile MDIN;
-    if (MDIN.OpenWrite(mdin_name)) return 1;
-    MDIN.Printf("%s", runDescription_.c_str());
+    MDIN.OpenMemory();
+    MDIN.Puts(runDescription_);
     // Write indices to mdin for MREMD
     if (Dims_.size() > 1) {
-      MDIN.Printf(" {");
-      for (Iarray::const_iterator count = Indices.begin(); count != Indices.end(); ++count)
-        MDIN.Printf(" %u", *count + 1);
-      MDIN.Printf(" }");
+      MDIN.Puts(" {");
+      for (unsigned int id = 0; id != Dims_.size(); id++) {
+        MDIN.PutChar(' ');
+        MDIN.PutInt( Indices[id] + 1 );
+      }
+      MDIN.Puts(" }");
     }
     // for Top %u at %g K 
     MDIN.Printf(" (rep %u), %g ps/exchg\n"
@@ -759,7 +903,7 @@ int RemdDirs::CreateRemd(int start_run, int run_num, std::string const& run_dir)
       MDIN.Printf("    ig = %i, numexchg = %i,\n", ig_, numexchg_);
     if (ph_dim_ != -1)
       MDIN.Printf("    solvph = %f,\n", Dims_[ph_dim_]->SolvPH( Indices[ph_dim_] ));
-    MDIN.Printf("    temp0 = %f, tempi = %f,\n%s", currentTemp0, currentTemp0,
+    MDIN.Printf("    temp0 = %f, tempi = %f,\n%s", RI.temp0_, RI.temp0_,
                 additionalInput_.c_str());
     for (unsigned int id = 0; id != Dims_.size(); id++)
       Dims_[id]->WriteMdin(Indices[id], MDIN);
@@ -768,64 +912,111 @@ int RemdDirs::CreateRemd(int start_run, int run_num, std::string const& run_dir)
     for (MdinFile::const_iterator nl = mdinFile_.nl_begin(); nl != mdinFile_.nl_end(); ++nl)
       if (nl->first != "&cntrl")
         WriteNamelist(MDIN, nl->first, nl->second);
+    RI.mdinText_ = MDIN.MemoryContents();
     MDIN.Close();
-    // Write to groupfile. Determine restart.
-    std::string INPUT_CRD;
-    if (crdDirSpecified_ || run_num == 0)
-      INPUT_CRD = crd_dir_ + "/" + EXT + ".rst7";
-    else
-      INPUT_CRD = "../run." + integerToString(run_num-1, width) +
-                  "/RST/" + EXT + ".rst7";
-    if (start_run == run_num && !fileExists( INPUT_CRD )) {
-      // Check if crd_dir_ exists by itself
-      if (fileExists(crd_dir_) && IsDirectory(crd_dir_)==0) {
-        Msg("\tUsing '%s' for all input coordinates.\n", crd_dir_.c_str());
-        INPUT_CRD = crd_dir_;
-      } else {
-        ErrorMsg("Coords %s not found.\n", INPUT_CRD.c_str());
-        return 1;
-      }
+    mdinText = &RI.mdinText_;
+  }
+  Profile::Timer timer("MDIN write");
+  TextFile MDIN;
+  if (MDIN.OpenWrite(RI.mdin_)) {
+    RI.error_ = "Could not write MDIN '" + RI.mdin_ + "'\n";
+    return;
+  }
+  MDIN.Puts( *mdinText );
+  MDIN.Close();
+  // Write to groupfile. Determine restart.
+  if (crdDirSpecified_ || run_num == 0)
+    RI.crd_ = crd_dir_ + "/" + EXT + ".rst7";
+  else
+    RI.crd_ = "../run." + integerToString(run_num-1, width) +
+              "/RST/" + EXT + ".rst7";
+  if (start_run == run_num && !fileExists( RI.crd_ )) {
+    // Check if crd_dir_ exists by itself
+    if (fileExists(crd_dir_) && IsDirectory(crd_dir_)==0) {
+      RI.singleCrd_ = true;
+      RI.crd_ = crd_dir_;
+    } else {
+      RI.error_ = "Coords " + RI.crd_ + " not found.\n";
+      return;
     }
-    if (debug_ > 1)
-      Msg("\t\tINPCRD: %s\n", INPUT_CRD.c_str());
-    std::string GROUPFILE_LINE = "-O -remlog rem.log -i " + mdin_name +
-      " -p " + currentTop + " -c " + INPUT_CRD + " -o OUTPUT/rem.out." + EXT +
-      " -inf INFO/reminfo." + EXT + " -r RST/" + EXT + 
-      ".rst7 -x TRAJ/rem.crd." + EXT;
-    std::string repRef = RefFileName(EXT);
-    if (!repRef.empty()) {
-      if (!fileExists( repRef )) {
-        ErrorMsg("Reference file '%s' not found. Must specify absolute path"
-                 " or path relative to '%s'\n", repRef.c_str(), run_dir.c_str());
-        return 1;
-      }
-      GROUPFILE_LINE.append(" -ref " + tildeExpansion(repRef));
+  }
+  RI.groupline_ = "-O -remlog rem.log -i " + RI.mdin_ +
+    " -p " + RI.top_ + " -c " + RI.crd_ + " -o OUTPUT/rem.out." + EXT +
+    " -inf INFO/reminfo." + EXT + " -r RST/" + EXT + 
+    ".rst7 -x TRAJ/rem.crd." + EXT;
+  std::string repRef = RefFileName(EXT);
+  if (!repRef.empty()) {
+    if (!fileExists( repRef )) {
+      RI.error_ = "Reference file '" + repRef + "' not found. Must specify absolute path"
+                  " or path relative to '" + run_dir + "'\n";
+      return;
     }
-    if (uselog_)
-      GROUPFILE_LINE.append(" -l LOG/logfile." + EXT);
-    if (ph_dim_ != -1) {
-      if (run_num == 0)
-        GROUPFILE_LINE.append(" -cpin " + cpin_file_);
-      else {
-        // Use CPrestart from previous run
-        std::string prevCP("../run." + integerToString(run_num-1, width) +
-                           "/CPH/cprestrt." + EXT);
-        if (start_run == run_num && !fileExists( prevCP )) {
-          ErrorMsg("Previous CP restart %s not found.\n", prevCP.c_str());
-          return 1;
-        }
-        GROUPFILE_LINE.append(" -cpin " + prevCP);
+    RI.groupline_.append(" -ref " + tildeExpansion(repRef));
+  }
+  if (uselog_)
+    RI.groupline_.append(" -l LOG/logfile." + EXT);
+  if (ph_dim_ != -1) {
+    if (run_num == 0)
+      RI.groupline_.append(" -cpin " + cpin_file_);
+    else {
+      // Use CPrestart from previous run
+      std::string prevCP("../run." + integerToString(run_num-1, width) +
+                         "/CPH/cprestrt." + EXT);
+      if (start_run == run_num && !fileExists( prevCP )) {
+        RI.error_ = "Previous CP restart " + prevCP + " not found.\n";
+        return;
       }
-      GROUPFILE_LINE.append(" -cpout CPH/cpout." + EXT +
-                            " -cprestrt CPH/cprestrt." + EXT);
+      RI.groupline_.append(" -cpin " + prevCP);
     }
-    for (unsigned int id = 0; id != Dims_.size(); id++)
-      GROUPFILE_LINE += Dims_[id]->Groupline(EXT);
-    GROUPFILE.Printf("%s\n", GROUPFILE_LINE.c_str());
+    RI.groupline_.append(" -cpout CPH/cpout." + EXT +
+                         " -cprestrt CPH/cprestrt." + EXT);
+  }
+  for (unsigned int id = 0; id != Dims_.size(); id++)
+    RI.groupline_ += Dims_[id]->Groupline(EXT);
+}
+
+// RemdDirs::CreateRemd()
+int RemdDirs::CreateRemd(int start_run, int run_num, std::string const& run_dir) {
+  typedef std::vector<unsigned int> Iarray;
+  // Create and change to run directory.
+  if (Mkdir(run_dir)) return 1;
+  if (ChangeDir(run_dir)) return 1;
+  // Ensure that coords directory exists.
+  if (crdDirSpecified_ && !fileExists(crd_dir_)) {
+    ErrorMsg("Coords directory '%s' not found. Must specify absolute path"
+             " or path relative to '%s'\n", crd_dir_.c_str(), run_dir.c_str());
+    return 1;
+  }
+  // If constant pH, ensure CPIN file exists
+  if (ph_dim_ != -1 && !fileExists(cpin_file_)) {
+    ErrorMsg("CPIN file '%s' not found. Must specify absolute path"
+             " or path relative to '%s'\n", cpin_file_.c_str(), run_dir.c_str());
+    return 1;
+  }
+  // Do we need to setup groups for MREMD?
+  if (groups_.Empty() && Dims_.size() > 1) {
+    Iarray dimSizes;
+    dimSizes.reserve( Dims_.size() );
+    for (DimArray::const_iterator dim = Dims_.begin(); dim != Dims_.end(); ++dim)
+      dimSizes.push_back( (*dim)->Size() );
+    if (groups_.SetupGroups( dimSizes )) return 1;
+  }
+  // Create INPUT directory if not present.
+  std::string input_dir("INPUT");
+  if (Mkdir(input_dir)) return 1;
+  // Figure out max width of replica extension
+  int width = std::max(DigitWidth( totalReplicas_ ), 3);
+  // Determine indices in each dimension for every replica.
+  unsigned int ndims = Dims_.size();
+  Iarray AllIndices( totalReplicas_ * ndims, 0 );
+  Iarray Indices( ndims, 0 );
+  for (unsigned int rep = 0; rep != totalReplicas_; rep++)
+  {
+    std::copy( Indices.begin(), Indices.end(), AllIndices.begin() + rep * ndims );
     // Increment first (fastest growing) index.
     Indices[0]++;
     // Increment remaining indices if necessary.
-    for (unsigned int id = 0; id != Dims_.size() - 1; id++)
+    for (unsigned int id = 0; id != ndims - 1; id++)
     {
       if (Indices[id] == Dims_[id]->Size()) {
         Indices[id] = 0; // Set this index to zero.
@@ -833,15 +1024,74 @@ int RemdDirs::CreateRemd(int start_run, int run_num, std::string const& run_dir)
       }
     }
   }
+  if (!override_irest_) {
+    if (run_num == 0)
+      Msg("    Run 0: irest=0, ntx=1\n");
+  } else
+    Msg("    Using irest/ntx from MDIN.\n");
+  // MDIN only differs between runs in irest/ntx, so generate it for the
+  // first run of each kind and reuse it for the rest.
+  bool isRun0 = (!override_irest_ && run_num == 0);
+  bool useTemplate = (mdinTemplate_.size() == totalReplicas_ && templateIsRun0_ == isRun0);
+  // Write input for each replica and generate groupfile lines. Replicas
+  // are independent, so this may be done in parallel.
+  std::vector<RepInput> Reps( totalReplicas_ );
+  int nreps = (int)totalReplicas_;
+  int irep;
+# ifdef _OPENMP
+# pragma omp parallel for num_threads(nthreads_) schedule(dynamic) if (nthreads_ > 1)
+# endif
+  for (irep = 0; irep < nreps; irep++)
+    CreateReplicaInput(irep, &AllIndices[0] + irep * ndims, width, start_run, run_num,
+                       run_dir, (useTemplate ? &mdinTemplate_[irep] : 0), Reps[irep]);
+  if (!useTemplate) {
+    mdinTemplate_.resize( totalReplicas_ );
+    for (unsigned int rep = 0; rep != totalReplicas_; rep++)
+      mdinTemplate_[rep].swap( Reps[rep].mdinText_ );
+    templateIsRun0_ = isRun0;
+  }
+  // Write groupfile in replica order.
+  TextFile GROUPFILE;
+  if (GROUPFILE.OpenWrite(groupfileName_)) return 1; 
+  for (unsigned int rep = 0; rep != totalReplicas_; rep++)
+  {
+    RepInput const& RI = Reps[rep];
+    if (debug_ > 1) {
+      Msg("\tReplica %u: top=%s  temp0=%f", rep+1, RI.top_.c_str(), RI.temp0_);
+      Msg("  {");
+      for (unsigned int id = 0; id != ndims; id++)
+        Msg(" %u", AllIndices[rep * ndims + id]);
+      Msg(" }\n");
+      Msg("\t\tMDIN: %s\n", RI.mdin_.c_str());
+    }
+    if (!RI.error_.empty()) {
+      ErrorMsg("%s", RI.error_.c_str());
+      return 1;
+    }
+    if (RI.singleCrd_)
+      Msg("\tUsing '%s' for all input coordinates.\n", crd_dir_.c_str());
+    if (debug_ > 1)
+      Msg("\t\tINPCRD: %s\n", RI.crd_.c_str());
+    GROUPFILE.Puts(RI.groupline_);
+    GROUPFILE.PutChar('\n');
+  }
   GROUPFILE.Close();
   if (debug_ > 1 && !groups_.Empty())
     groups_.PrintGroups();
   // Create remd.dim if necessary.
   if (Dims_.size() > 1) {
+    // Same for every run; only generate once.
+    if (remdDimTemplate_.empty()) {
+      TextFile REMDDIM;
+      REMDDIM.OpenMemory();
+      for (unsigned int id = 0; id != Dims_.size(); id++)
+        groups_.WriteRemdDim(REMDDIM, id, Dims_[id]->exch_type(), Dims_[id]->description());
+      remdDimTemplate_ = REMDDIM.MemoryContents();
+      REMDDIM.Close();
+    }
     TextFile REMDDIM;
     if (REMDDIM.OpenWrite(remddimName_)) return 1;
-    for (unsigned int id = 0; id != Dims_.size(); id++)
-      groups_.WriteRemdDim(REMDDIM, id, Dims_[id]->exch_type(), Dims_[id]->description());
+    REMDDIM.Puts( remdDimTemplate_ );
     REMDDIM.Close();
   }
   // Create Run script
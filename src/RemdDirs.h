@@ -18,6 +18,10 @@ class RemdDirs {
     int CreateAnalyzeArchive(std::string const&, FileRoutines::StrArray const&, int, int, bool, bool, bool, bool);
 
     void SetDebug(int d) { debug_ = d; }
+    /// Set number of threads to use when creating replica input.
+    void SetNthreads(int n) { nthreads_ = n; }
+    /// Set whether dimensions are rebalanced from exchange acceptance in the previous run.
+    void SetRebalance(bool r) { rebalance_ = r; }
   private:
     enum RUNTYPE { MD=0, TREMD, HREMD, PHREMD, MREMD };
     static const std::string groupfileName_;
@@ -26,8 +30,15 @@ class RemdDirs {
     std::string const& Topology() const;
 
     int LoadDimension(std::string const&);
+    /// Rebalance dimensions from exchange acceptance in given run dir under top dir.
+    int RebalanceDims(std::string const&, std::string const&);
+    /// Write rebalanced dimension files to current dir.
+    int WriteRebalancedDims() const;
     std::string RefFileName(std::string const&) const;
     void WriteNamelist(TextFile&, std::string const&, MdinFile::TokenArray const&) const;
+    class RepInput;
+    void CreateReplicaInput(unsigned int, const unsigned int*, int, int, int,
+                            std::string const&, std::string const*, RepInput&) const;
     int CreateRemd(int, int, std::string const&);
     int CreateMD(int, int, std::string const&);
     int WriteRunMD(std::string const&) const;
@@ -47,17 +58,24 @@ class RemdDirs {
     typedef std::vector<ReplicaDimension*> DimArray;
     MdinFile mdinFile_;           ///< Used to parse input from Amber MDIN file
     DimArray Dims_;               ///< Hold any replica dimensions
+    FileRoutines::StrArray dimFiles_; ///< Dimension file for each dimension.
+    std::vector<bool> rebalanced_; ///< True if dimension values were rebalanced.
     unsigned int totalReplicas_;  /// Total # of replicas based on dimensions
     int top_dim_;                 ///< Set to index of temp0 dim or -1 = global temp
     int temp0_dim_;               ///< Set to index to topo dim or -1 = global topo
     int ph_dim_;                  ///< Set to index of ph dim or -1 = no ph
     int debug_;
+    int nthreads_;                ///< Number of threads to use for creating replica input.
     int n_md_runs_;               ///< Number of MD runs.
     int umbrella_;                ///< When > 0 indicates umbrella sampling write frequency.
+    FileRoutines::StrArray mdinTemplate_; ///< Generated MDIN for each replica, reused for later runs.
+    bool templateIsRun0_;         ///< True if mdinTemplate_ has run 0 irest/ntx.
+    std::string remdDimTemplate_; ///< Generated remd.dim, reused for later runs.
     bool override_irest_;         ///< If true do not set irest, use from MDIN
     bool override_ntx_;           ///< If true do not set ntx, use from MDIN
     bool uselog_;                 ///< If true use -l in groupfile
     bool crdDirSpecified_;        ///< If true, restart coords dir specified on command line.
+    bool rebalance_;              ///< If true, rebalance dimensions from previous run acceptance.
     RUNTYPE runType_;             ///< Type of run from options file.
     std::string runDescription_;  ///< Run description
     std::string additionalInput_; ///< Hold any additional MDIN input.
@@ -1,3 +1,4 @@
+#include <cmath>  // erfc, exp, log, pow
 #include <cstdio> // sscanf
 #include <sstream>   // istringstream, ostringstream
 #include "ReplicaDimension.h"
@@ -12,25 +13,256 @@ const std::string ReplicaDimension::emptystring_ = "";
 // Should correspong to ExchType
 const char* ReplicaDimension::exchString_[] = { "NONE", "TEMPERATURE", "HAMILTONIAN", "PH" };
 
+/** \return Standard normal cumulative distribution function at x. */
+static double NormalCdf(double x) {
+  return 0.5 * erfc( -x / sqrt(2.0) );
+}
+
+/** \return Average exchange acceptance between temperatures T and r*T for
+  *         a system whose potential energy at temperature T is Gaussian
+  *         with mean C*k*T and variance C*(k*T)^2, i.e. with constant heat
+  *         capacity C (in units of k). The exchange exponent
+  *         (B1 - B2)(E1 - E2) is then Gaussian with mean m and variance s^2,
+  *         and <min(1, exp(x))> = Phi(m/s) + exp(m + s^2/2) Phi(-m/s - s).
+  *         This depends only on r, so equal acceptance means a geometric ladder.
+  */
+static double ExchangeAcceptance(double C, double r) {
+  double m = -C * (r - 1.0) * (r - 1.0) / r;
+  double s = sqrt( C * (1.0 + r*r) ) * (r - 1.0) / r;
+  return NormalCdf( m / s ) + exp( m + 0.5*s*s ) * NormalCdf( -m / s - s );
+}
+
+/** Generate a geometric temperature ladder from Tmin to Tmax with as few
+  * replicas as possible such that the predicted acceptance between
+  * neighbors is at least the target. The potential energy heat capacity
+  * is estimated as (# atoms) * (heat capacity per atom); about 2 k per
+  * atom is typical for explicit water with rigid waters.
+  */
+int TemperatureDim::Generate(double tmin, double tmax, double target, double natoms,
+                             double cvPerAtom)
+{
+  if (tmin <= 0.0 || tmax <= tmin) {
+    ErrorMsg("Temperature generate requires 0 < Tmin < Tmax.\n");
+    return 1;
+  }
+  if (target <= 0.0 || target >= 1.0) {
+    ErrorMsg("Temperature generate target acceptance must be between 0 and 1.\n");
+    return 1;
+  }
+  if (natoms < 1.0 || cvPerAtom <= 0.0) {
+    ErrorMsg("Temperature generate requires # atoms and heat capacity per atom > 0.\n");
+    return 1;
+  }
+  double C = natoms * cvPerAtom;
+  // Find largest temperature ratio with acceptance >= target.
+  double rmax = tmax / tmin;
+  double ratio = rmax;
+  if (ExchangeAcceptance(C, rmax) < target) {
+    double lo = 1.0;
+    double hi = 1.0 + 1.0 / sqrt(C);
+    while (hi < rmax && ExchangeAcceptance(C, hi) >= target)
+      hi = 1.0 + 2.0 * (hi - 1.0);
+    if (hi > rmax) hi = rmax;
+    for (int iter = 0; iter != 100; iter++) {
+      double mid = 0.5 * (lo + hi);
+      if (ExchangeAcceptance(C, mid) >= target)
+        lo = mid;
+      else
+        hi = mid;
+    }
+    ratio = lo;
+  }
+  int nreps = (int)ceil( log(rmax) / log(ratio) - 0.000001 ) + 1;
+  if (nreps < 2) nreps = 2;
+  double step = pow(rmax, 1.0 / (double)(nreps - 1));
+  temps_.clear();
+  for (int rep = 0; rep != nreps; rep++) {
+    // Round to 0.01 K.
+    double temp0 = floor( tmin * pow(step, (double)rep) * 100.0 + 0.5 ) / 100.0;
+    temps_.push_back( temp0 );
+  }
+  temps_.back() = tmax;
+  Msg("    Generated %i temperatures from %g K to %g K for %g atoms (heat capacity %g k/atom);\n"
+      "      ratio %.5f, predicted acceptance %.3f (target %g).\n", nreps, tmin, tmax,
+      natoms, cvPerAtom, step, ExchangeAcceptance(C, step), target);
+  return 0;
+}
+
+/** Temperatures are either listed one per line after the '#Temperature'
+  * line, or generated from a first line of the form:
+  *   #Temperature generate <Tmin> <Tmax> <target acceptance> <# atoms> [<heat capacity per atom>]
+  */
 int TemperatureDim::LoadDim(std::string const& fname) {
   TextFile infile;
   if (infile.OpenRead(fname)) return 1;
-  const char* buffer = infile.Gets(); // Scan past first line.
-  double temp0;
-  while ( (buffer = infile.Gets()) != 0 ) {
-    if (sscanf(buffer, "%lf", &temp0) != 1) {
-      ErrorMsg("Reading temperature from dim file.\n");
+  std::istringstream header( infile.GetString() );
+  std::string key, mode;
+  header >> key >> mode;
+  if (mode == "generate") {
+    infile.Close();
+    double tmin, tmax, target, natoms;
+    double cvPerAtom = 2.0;
+    if (!(header >> tmin >> tmax >> target >> natoms)) {
+      ErrorMsg("Expected '%s generate <Tmin> <Tmax> <target acceptance> <# atoms>"
+               " [<heat capacity per atom>]'\n", key.c_str());
+      return 1;
+    }
+    if (!(header >> cvPerAtom)) cvPerAtom = 2.0;
+    if (Generate(tmin, tmax, target, natoms, cvPerAtom)) return 1;
+  } else {
+    const char* buffer = 0;
+    double temp0;
+    while ( (buffer = infile.Gets()) != 0 ) {
+      if (sscanf(buffer, "%lf", &temp0) != 1) {
+        ErrorMsg("Reading temperature from dim file.\n");
+        return 1;
+      }
+      temps_.push_back( temp0 );
+    }
+    infile.Close();
+    if (temps_.empty()) {
+      ErrorMsg("No temperatures in dim file.\n");
       return 1;
     }
-    temps_.push_back( temp0 );
   }
-  infile.Close();
   std::ostringstream oss;
   oss << "Temperature exchange from " << temps_.front() << " K to " << temps_.back() << " K";
   SetDescription(oss.str());
   return 0;
 }
 
+/** \return Heat capacity C for which ExchangeAcceptance(C, r) equals given
+  *         acceptance, which is first limited to [0.001, 0.999].
+  */
+static double EffectiveHeatCapacity(double r, double acc) {
+  if (acc < 0.001) acc = 0.001;
+  if (acc > 0.999) acc = 0.999;
+  // Acceptance decreases with C; bisect on log C.
+  double lo = -20.0;
+  double hi = 40.0;
+  for (int iter = 0; iter != 100; iter++) {
+    double mid = 0.5 * (lo + hi);
+    if (ExchangeAcceptance(exp(mid), r) > acc)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return exp( 0.5 * (lo + hi) );
+}
+
+/** Keep the end temperatures and number of replicas, and space the
+  * ladder so all neighbors have the same predicted acceptance. For each
+  * neighbor pair i an effective heat capacity C_i is found that
+  * reproduces the observed acceptance. For close temperatures acceptance
+  * depends on sqrt(C) * ln(T2/T1), so new temperatures are placed at equal
+  * steps of L = sum of sqrt(C_i) * ln(T_i+1 / T_i), with L linear in ln(T)
+  * between old temperatures. Pairs that never exchanged only bound C from
+  * below, and clamping their acceptance would make them dominate, so their
+  * C is interpolated (in ln C) from the nearest pairs that did exchange.
+  * \param observed Temperatures the acceptance was observed at; if empty use current.
+  * \param acceptance Observed acceptance between each temperature and the next.
+  */
+int TemperatureDim::Rebalance(Darray const& observed, Darray const& acceptance) {
+  Darray oldTemps = observed.empty() ? temps_ : observed;
+  if (oldTemps.size() != temps_.size()) {
+    ErrorMsg("Dimension has %u temperatures but exchanges were at %u temperatures.\n",
+             (unsigned int)temps_.size(), (unsigned int)oldTemps.size());
+    return 1;
+  }
+  if (acceptance.size() + 1 != oldTemps.size()) {
+    ErrorMsg("Expected acceptance for %u temperature pairs, got %u.\n",
+             (unsigned int)oldTemps.size() - 1, (unsigned int)acceptance.size());
+    return 1;
+  }
+  unsigned int npairs = acceptance.size();
+  Darray lnC( npairs );
+  std::vector<unsigned int> measured; // Pairs with accepted exchanges.
+  double minAcc = 1.0;
+  double maxAcc = 0.0;
+  for (unsigned int i = 0; i != npairs; i++) {
+    if (oldTemps[i+1] <= oldTemps[i]) {
+      ErrorMsg("Temperatures must be increasing to rebalance.\n");
+      return 1;
+    }
+    if (acceptance[i] > 0.0) {
+      lnC[i] = log( EffectiveHeatCapacity(oldTemps[i+1] / oldTemps[i], acceptance[i]) );
+      measured.push_back( i );
+    }
+    if (acceptance[i] < minAcc) minAcc = acceptance[i];
+    if (acceptance[i] > maxAcc) maxAcc = acceptance[i];
+  }
+  if (measured.empty()) {
+    ErrorMsg("No exchanges accepted between any neighbors; cannot rebalance.\n");
+    return 1;
+  }
+  if (measured.size() < npairs)
+    Msg("    %u of %u pairs never exchanged; using heat capacity of neighboring pairs.\n",
+        npairs - (unsigned int)measured.size(), npairs);
+  // Interpolate ln C for pairs that never exchanged.
+  unsigned int im = 0;
+  for (unsigned int i = 0; i != npairs; i++) {
+    if (acceptance[i] > 0.0) continue;
+    while (im + 1 < measured.size() && measured[im] < i) im++;
+    // measured[im] is the first measured pair after i, if any.
+    if (measured[im] < i)
+      lnC[i] = lnC[measured[im]];
+    else if (im == 0)
+      lnC[i] = lnC[measured[0]];
+    else {
+      unsigned int i0 = measured[im-1];
+      unsigned int i1 = measured[im];
+      lnC[i] = lnC[i0] + (lnC[i1] - lnC[i0]) * (double)(i - i0) / (double)(i1 - i0);
+    }
+  }
+  Darray sqrtC( npairs );
+  Darray length( npairs + 1, 0.0 );
+  for (unsigned int i = 0; i != npairs; i++) {
+    sqrtC[i] = exp( 0.5 * lnC[i] );
+    length[i+1] = length[i] + sqrtC[i] * log( oldTemps[i+1] / oldTemps[i] );
+  }
+  double step = length.back() / (double)npairs;
+  Darray newTemps( 1, oldTemps.front() );
+  double minPred = 1.0;
+  double maxPred = 0.0;
+  double lnPrev = log( oldTemps.front() );
+  unsigned int i = 0;
+  for (unsigned int rep = 1; rep <= npairs; rep++) {
+    double lnT;
+    if (rep == npairs)
+      lnT = log( oldTemps.back() );
+    else {
+      double target = step * (double)rep;
+      while (i + 1 < npairs && length[i+1] < target) i++;
+      lnT = log( oldTemps[i] ) + (target - length[i]) / sqrtC[i];
+    }
+    // Predicted acceptance with the effective heat capacity over this step.
+    double sC = step / (lnT - lnPrev);
+    double pred = ExchangeAcceptance(sC * sC, exp(lnT - lnPrev));
+    if (pred < minPred) minPred = pred;
+    if (pred > maxPred) maxPred = pred;
+    lnPrev = lnT;
+    if (rep == npairs)
+      newTemps.push_back( oldTemps.back() );
+    else
+      newTemps.push_back( floor( exp(lnT) * 100.0 + 0.5 ) / 100.0 );
+  }
+  temps_ = newTemps;
+  Msg("    Rebalanced %u temperatures from %g K to %g K; observed acceptance %.3f-%.3f,\n"
+      "      predicted acceptance %.3f-%.3f.\n", (unsigned int)temps_.size(),
+      temps_.front(), temps_.back(), minAcc, maxAcc, minPred, maxPred);
+  return 0;
+}
+
+int TemperatureDim::WriteDim(std::string const& fname) const {
+  TextFile outfile;
+  if (outfile.OpenWrite(fname)) return 1;
+  outfile.Printf("#Temperature\n");
+  for (Darray::const_iterator temp0 = temps_.begin(); temp0 != temps_.end(); ++temp0)
+    outfile.Printf("%.2f\n", *temp0);
+  outfile.Close();
+  return 0;
+}
+
 // -----------------------------------------------------------------------------
 int PhDim::LoadDim(std::string const& fname) {
   TextFile infile;
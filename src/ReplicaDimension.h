@@ -36,6 +36,10 @@ class ReplicaDimension {
     virtual double Temp0(int)  const { return -1.0; }
     /// \return pH
     virtual double SolvPH(int) const { return -1.0; }
+    /// Set values for uniform acceptance from given ladder values and observed acceptance. \return -1 if not supported.
+    virtual int Rebalance(Darray const&, Darray const&) { return -1; }
+    /// Write dimension file
+    virtual int WriteDim(std::string const&) const { return 1; }
     // ---------------------------------
     /// \return Replica dimension type.
     DimType Type() const { return type_;     }
@@ -65,7 +69,12 @@ class TemperatureDim : public ReplicaDimension {
     double Temp0(int i)     const { return temps_[i]; }
     const char* name()      const { return "TREMD"; }
     int LoadDim(std::string const&);
+    int Rebalance(Darray const&, Darray const&);
+    int WriteDim(std::string const&) const;
   private:
+    /// Generate ladder from Tmin, Tmax, target acceptance, # atoms, heat capacity per atom.
+    int Generate(double, double, double, double, double);
+
     Darray temps_; ///< List of replica temperatures.
 };
 
@@ -0,0 +1,293 @@
+#include <cerrno>
+#include <cmath>      // NAN
+#include <cstdlib>    // strtol, strtod
+#include <cstring>    // memchr, memcpy, strcmp, strerror
+#include <fcntl.h>    // open
+#include <unistd.h>   // close
+#include <sys/mman.h> // mmap
+#include <sys/stat.h> // fstat
+#include "Rst7File.h"
+
+/** Powers of 10 for decoding fixed-point fields; all exactly representable. */
+static const double POW10[] = { 1.0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12 };
+
+/** Decode an F12.7 field, e.g. '  -1.2345678', without branching on each
+  * digit; on little-endian machines the 7 fractional digits are converted
+  * together as one 8-byte word. \return False if field does not have
+  * this exact layout.
+  */
+static inline bool DecodeF12_7(const char* fld, double& val) {
+  if (fld[4] != '.') return false;
+  // Fractional part: 7 digits.
+  long long frac;
+# if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  // Treat '.' + 7 digits as 8 digits ('0' + 7 digits) and convert all at once.
+  unsigned long long chunk;
+  memcpy(&chunk, fld + 4, 8);
+  chunk = (chunk & ~0xFFULL) | (unsigned long long)'0';
+  if (((chunk & 0xF0F0F0F0F0F0F0F0ULL) |
+       (((chunk + 0x0606060606060606ULL) & 0xF0F0F0F0F0F0F0F0ULL) >> 4)) != 0x3333333333333333ULL)
+    return false;
+  chunk -= 0x3030303030303030ULL;
+  chunk = (chunk * 10) + (chunk >> 8);
+  chunk = (((chunk & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+           (((chunk >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+  frac = (long long)chunk;
+# else
+  unsigned int d[7];
+  unsigned int bad = 0;
+  for (int i = 0; i < 7; i++) {
+    d[i] = (unsigned int)(fld[5+i] - '0');
+    bad |= (d[i] > 9);
+  }
+  if (bad) return false;
+  frac = (((((d[0] * 10LL + d[1]) * 10 + d[2]) * 10 + d[3]) * 10 + d[4]) * 10 + d[5]) * 10 + d[6];
+# endif
+  // Integer part: right-justified, at most 4 chars including sign.
+  long long ipart = 0;
+  bool negative = false;
+  bool started = false;
+  for (int i = 0; i < 4; i++) {
+    char c = fld[i];
+    unsigned int digit = (unsigned int)(c - '0');
+    if (digit < 10) {
+      ipart = (ipart * 10) + digit;
+      started = true;
+    } else if (c == '-' && !started) {
+      negative = true;
+      started = true;
+    } else if (c != ' ' || started)
+      return false;
+  }
+  val = (double)(ipart * 10000000LL + frac) / 1e7;
+  if (negative) val = -val;
+  return true;
+}
+
+/** Decode a single right-justified fixed-point field of given width, e.g.
+  * '  -1.2345678'. All digits are accumulated into an integer that is then
+  * divided by the appropriate power of 10, which gives the same correctly
+  * rounded result as strtod(). Anything else (overflow '*', NaN, exponents)
+  * decodes as NaN so that it is caught by coordinate checks.
+  */
+static inline double DecodeField(const char* fld, size_t width) {
+  size_t i = 0;
+  while (i < width && fld[i] == ' ') ++i;
+  bool negative = false;
+  if (i < width && (fld[i] == '-' || fld[i] == '+')) {
+    negative = (fld[i] == '-');
+    ++i;
+  }
+  long long mantissa = 0;
+  int ndigits = 0;
+  int ndecimal = -1;
+  for (; i < width; ++i) {
+    unsigned int digit = (unsigned int)(fld[i] - '0');
+    if (digit < 10) {
+      mantissa = (mantissa * 10) + digit;
+      ++ndigits;
+      if (ndecimal > -1) ++ndecimal;
+    } else if (fld[i] == '.' && ndecimal == -1)
+      ndecimal = 0;
+    else
+      return NAN;
+  }
+  if (ndigits == 0) return NAN;
+  double val = (double)mantissa;
+  if (ndecimal > 0) val /= POW10[ndecimal];
+  return (negative ? -val : val);
+}
+
+// =============================================================================
+/** CONSTRUCTOR */
+Rst7File::Rst7File() : map_(0), mapSize_(0), coords_(0), vels_(0), box_(0), nbox_(0),
+                       eolSize_(1), natom_(0), time_(0.0) {}
+
+/** DESTRUCTOR */
+Rst7File::~Rst7File() { Close(); }
+
+int Rst7File::SetError(std::string const& msg) {
+  err_ = "'" + fname_ + "': " + msg;
+  return -1;
+}
+
+void Rst7File::Close() {
+  if (map_ != 0) {
+    munmap((void*)map_, mapSize_);
+    map_ = 0;
+    mapSize_ = 0;
+  }
+  coords_ = 0;
+  vels_ = 0;
+  box_ = 0;
+  nbox_ = 0;
+  natom_ = 0;
+  time_ = 0.0;
+}
+
+/** Full lines are FIELDS_PER_LINE fields plus line ending; the last line
+  * holds any remaining fields.
+  */
+size_t Rst7File::SectionSize(size_t nfields) const {
+  size_t nlines = (nfields + FIELDS_PER_LINE - 1) / FIELDS_PER_LINE;
+  if (nlines == 0) return 0;
+  size_t nlast = nfields - ((nlines - 1) * FIELDS_PER_LINE);
+  return ((nlines - 1) * (FIELDS_PER_LINE * FIELD_WIDTH + eolSize_)) +
+         (nlast * FIELD_WIDTH) + eolSize_;
+}
+
+/** Map file, read number of atoms and time, and determine where the
+  * coordinates, velocities (if present) and box (if present) are. Which
+  * sections are present is determined from the number of characters
+  * following the coordinates.
+  */
+int Rst7File::Open(std::string const& fname) {
+  Close();
+  fname_ = fname;
+  err_.clear();
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd == -1) {
+    SetError( strerror(errno) );
+    return 1;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    SetError( strerror(errno) );
+    close(fd);
+    return 1;
+  }
+  if (file_stat.st_size < 1) {
+    close(fd);
+    SetError("Empty file.");
+    return -1;
+  }
+  mapSize_ = (size_t)file_stat.st_size;
+  void* ptr = mmap(0, mapSize_, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    mapSize_ = 0;
+    SetError( strerror(errno) );
+    return 1;
+  }
+  map_ = (const char*)ptr;
+  madvise(ptr, mapSize_, MADV_SEQUENTIAL);
+  const char* end = map_ + mapSize_;
+  // Skip title.
+  const char* line = (const char*)memchr(map_, '\n', mapSize_);
+  if (line == 0) { Close(); SetError("No title line."); return -1; }
+  ++line;
+  // Number of atoms and time.
+  const char* lineEnd = (const char*)memchr(line, '\n', end - line);
+  if (lineEnd == 0 || lineEnd - line > 80) { Close(); SetError("Bad atoms/time line."); return -1; }
+  eolSize_ = (lineEnd > line && lineEnd[-1] == '\r') ? 2 : 1;
+  char buf[81];
+  memcpy(buf, line, lineEnd - line);
+  buf[lineEnd - line] = '\0';
+  char* ptrEnd = 0;
+  natom_ = strtol(buf, &ptrEnd, 10);
+  if (ptrEnd == buf || natom_ < 1) { Close(); SetError("Bad number of atoms."); return -1; }
+  time_ = strtod(ptrEnd, 0);
+  coords_ = lineEnd + 1;
+  // Coordinates
+  size_t secSize = SectionSize( 3 * natom_ );
+  if ((size_t)(end - coords_) < secSize || coords_[secSize-1] != '\n') {
+    Close();
+    SetError("Size of coordinates does not match number of atoms.");
+    return -1;
+  }
+  // Velocities and box. Ignore trailing whitespace.
+  const char* after = coords_ + secSize;
+  const char* trimmed = end;
+  while (trimmed > after && (trimmed[-1] == '\n' || trimmed[-1] == '\r' || trimmed[-1] == ' '))
+    --trimmed;
+  size_t nremain = (size_t)(trimmed - after);
+  size_t velSize = secSize - eolSize_;
+  if (nremain == 0) {
+  } else if (nremain == velSize) {
+    vels_ = after;
+  } else if (nremain == 6 * FIELD_WIDTH || nremain == 3 * FIELD_WIDTH) {
+    box_ = after;
+    nbox_ = nremain / FIELD_WIDTH;
+  } else if ((nremain == secSize + 6 * FIELD_WIDTH || nremain == secSize + 3 * FIELD_WIDTH) &&
+             after[secSize-1] == '\n') {
+    vels_ = after;
+    box_ = after + secSize;
+    nbox_ = (nremain - secSize) / FIELD_WIDTH;
+  } else {
+    Close();
+    SetError("Unexpected number of characters after coordinates.");
+    return -1;
+  }
+  return 0;
+}
+
+long int Rst7File::DimLength(const char* name) const {
+  if (strcmp(name, "atom") == 0) return natom_;
+  return -1;
+}
+
+bool Rst7File::HasVar(const char* name) const {
+  if (map_ == 0) return false;
+  if (strcmp(name, "time") == 0 || strcmp(name, "coordinates") == 0) return true;
+  if (strcmp(name, "velocities") == 0) return (vels_ != 0);
+  if (strcmp(name, "cell_lengths") == 0) return (box_ != 0);
+  if (strcmp(name, "cell_angles") == 0) return (nbox_ == 6);
+  return false;
+}
+
+/** Decode fields directly from the mapped file. Each full line is checked
+  * for the expected line ending as it is passed.
+  * \param section Start of section.
+  * \param nfields Total number of fields in section.
+  * \param offset Field to start reading at.
+  * \param nvals Number of fields to read.
+  * \param out Output array, must hold at least nvals elements.
+  * \return 0 if OK, -1 on error.
+  */
+int Rst7File::ReadFields(const char* section, size_t nfields, size_t offset, size_t nvals,
+                         double* out)
+{
+  if (offset + nvals > nfields) return SetError("Read past end of section.");
+  const size_t lineSize = FIELDS_PER_LINE * FIELD_WIDTH + eolSize_;
+  const char* lineStart = section + (offset / FIELDS_PER_LINE) * lineSize;
+  size_t col = offset % FIELDS_PER_LINE;
+  for (size_t n = 0; n != nvals; n++) {
+    const char* fld = lineStart + col * FIELD_WIDTH;
+    if (!DecodeF12_7(fld, out[n]))
+      out[n] = DecodeField(fld, FIELD_WIDTH);
+    if (++col == FIELDS_PER_LINE) {
+      if (lineStart[lineSize - 1] != '\n')
+        return SetError("Unexpected line length.");
+      lineStart += lineSize;
+      col = 0;
+    }
+  }
+  return 0;
+}
+
+/** Read values from variable.
+  * \param name Variable name.
+  * \param rec Record; must be 0 (restarts have 1 frame).
+  * \param offset Element to start reading at.
+  * \param nvals Number of elements to read.
+  * \param out Output array, must hold at least nvals elements.
+  * \return 0 if OK, -1 on error.
+  */
+int Rst7File::GetVar(const char* name, size_t rec, size_t offset, size_t nvals, double* out)
+{
+  if (map_ == 0) return SetError("File not open.");
+  if (rec != 0) return SetError("Variable " + std::string(name) + " has no records.");
+  if (strcmp(name, "time") == 0) {
+    if (offset + nvals > 1) return SetError("Read past end of variable time");
+    if (nvals > 0) out[0] = time_;
+    return 0;
+  } else if (strcmp(name, "coordinates") == 0)
+    return ReadFields(coords_, 3 * natom_, offset, nvals, out);
+  else if (strcmp(name, "velocities") == 0 && vels_ != 0)
+    return ReadFields(vels_, 3 * natom_, offset, nvals, out);
+  else if (strcmp(name, "cell_lengths") == 0 && box_ != 0)
+    return ReadFields(box_, 3, offset, nvals, out);
+  else if (strcmp(name, "cell_angles") == 0 && nbox_ == 6)
+    return ReadFields(box_ + 3 * FIELD_WIDTH, 3, offset, nvals, out);
+  return SetError("Variable " + std::string(name) + " not found.");
+}
@@ -0,0 +1,52 @@
+#ifndef INC_RST7FILE_H
+#define INC_RST7FILE_H
+#include <string>
+/// Read-only access to an Amber ASCII restart (rst7) file.
+/** Coordinates, velocities and box are written as fixed-width 6F12.7
+  * fields, so the position of any value can be calculated directly from
+  * its index. The file is memory-mapped and fields are decoded in place.
+  * Values are accessed with the same names as an Amber NetCDF restart
+  * ('time', 'coordinates', 'velocities', 'cell_lengths', 'cell_angles')
+  * so that both can be checked the same way. Nothing is printed so that
+  * different files may be read in parallel; errors are available via Error().
+  */
+class Rst7File {
+  public:
+    Rst7File();
+    ~Rst7File();
+    /// Open file and read title/atoms/time. \return 0 if OK, 1 if file could not be opened, -1 if bad format.
+    int Open(std::string const&);
+    /// Close file.
+    void Close();
+    /// \return Number of atoms for dimension 'atom', -1 for any other dimension.
+    long int DimLength(const char*) const;
+    /// \return True if variable with given name is present.
+    bool HasVar(const char*) const;
+    /// Read # values from variable starting at given element offset (record must be 0).
+    int GetVar(const char*, size_t, size_t, size_t, double*);
+    /// \return Description of last error.
+    std::string const& Error() const { return err_; }
+  private:
+    static const size_t FIELD_WIDTH = 12;
+    static const size_t FIELDS_PER_LINE = 6;
+
+    /// Set error message. \return -1
+    int SetError(std::string const&);
+    /// \return Size in bytes of a section with given # fields, including final newline.
+    size_t SectionSize(size_t) const;
+    /// Decode # values starting at given field offset in section.
+    int ReadFields(const char*, size_t, size_t, size_t, double*);
+
+    const char* map_;      ///< Start of memory-mapped file contents.
+    size_t mapSize_;       ///< Size of memory-mapped file.
+    std::string err_;      ///< Last error message.
+    std::string fname_;    ///< File name.
+    const char* coords_;   ///< Start of coordinates.
+    const char* vels_;     ///< Start of velocities, 0 if not present.
+    const char* box_;      ///< Start of box line, 0 if not present.
+    size_t nbox_;          ///< Number of fields in box line (3 or 6).
+    size_t eolSize_;       ///< Size of line ending (1 for '\n', 2 for '\r\n').
+    long int natom_;       ///< Number of atoms.
+    double time_;          ///< Restart time.
+};
+#endif
@@ -0,0 +1,283 @@
+#include <cerrno>
+#include <cstdio>    // remove
+#include <cstring>   // strcmp, strerror
+#include <algorithm> // sort
+#include <dirent.h>  // opendir, readdir
+#include <fcntl.h>   // open
+#include <unistd.h>  // read, close, readlink
+#include "RunArchive.h"
+#include "TarArchive.h"
+#include "XxHash64.h"
+#include "TextFile.h"
+#include "FileRoutines.h"
+#include "StringRoutines.h"
+#include "Messages.h"
+#include "Profile.h"
+
+using namespace Messages;
+
+/** \return true if name begins with given prefix. */
+static inline bool StartsWith(std::string const& name, const char* prefix) {
+  return (name.compare(0, strlen(prefix), prefix) == 0);
+}
+
+/** Hash contents of given regular file, or target of given symbolic link.
+  * \return 0 if OK, 1 if file could not be read.
+  */
+static int HashFile(std::string const& name, struct stat const& st, std::string& hex) {
+  XxHash64 hash;
+  std::vector<char> buffer( 65536 );
+  if (S_ISLNK(st.st_mode)) {
+    ssize_t len = readlink( name.c_str(), &buffer[0], buffer.size() - 1 );
+    if (len < 0) return 1;
+    hash.Update( &buffer[0], len );
+  } else {
+    Profile::Count("open()");
+    int fd = open( name.c_str(), O_RDONLY );
+    if (fd < 0) return 1;
+    ssize_t nread;
+    while ( (nread = read( fd, &buffer[0], buffer.size() )) != 0 ) {
+      if (nread < 0) {
+        if (errno == EINTR) continue;
+        close( fd );
+        return 1;
+      }
+      hash.Update( &buffer[0], nread );
+    }
+    close( fd );
+  }
+  hex = hash.HexDigest();
+  return 0;
+}
+
+/** Recursively sort files in given directory into run files, sorted/stripped
+  * trajectories, and other (source) trajectories. Entries are visited in name
+  * order so archives are reproducible. Each file is examined with a single
+  * lstat().
+  * \param dir Directory to walk.
+  * \param inTraj True if dir is a TRAJ directory or beneath one.
+  * \param runFiles Non-trajectory files.
+  * \param trajFiles Sorted/stripped trajectory files.
+  * \param srcFiles Trajectory files that are not archived.
+  */
+int RunArchive::Walk(std::string const& dir, bool inTraj, FileArray& runFiles,
+                     FileArray& trajFiles, FileArray& srcFiles) const
+{
+  Profile::Count("opendir()");
+  DIR* dp = opendir( dir.c_str() );
+  if (dp == 0) {
+    ErrorMsg("Could not open directory '%s': %s\n", dir.c_str(), strerror( errno ));
+    return 1;
+  }
+  std::vector<std::string> names;
+  struct dirent* entry;
+  while ( (entry = readdir( dp )) != 0 ) {
+    if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+      names.push_back( std::string(entry->d_name) );
+  }
+  closedir( dp );
+  std::sort( names.begin(), names.end() );
+  for (std::vector<std::string>::const_iterator name = names.begin(); name != names.end(); ++name)
+  {
+    FileEntry file;
+    file.first = dir + "/" + *name;
+    Profile::Count("lstat()");
+    if (lstat( file.first.c_str(), &file.second ) != 0) {
+      ErrorMsg("Could not stat '%s': %s\n", file.first.c_str(), strerror( errno ));
+      return 1;
+    }
+    if (S_ISDIR(file.second.st_mode)) {
+      if (Walk( file.first, inTraj || *name == "TRAJ", runFiles, trajFiles, srcFiles )) return 1;
+    } else if (!S_ISREG(file.second.st_mode) && !S_ISLNK(file.second.st_mode))
+      continue;
+    else if (inTraj || name->find("md.nc") != std::string::npos) {
+      if (inTraj && (StartsWith(*name, "wat.nc.") || StartsWith(*name, "nowat.nc.")))
+        trajFiles.push_back( file );
+      else
+        srcFiles.push_back( file );
+    } else
+      runFiles.push_back( file );
+  }
+  return 0;
+}
+
+/** \return true if given archive (recorded in the manifest) is present. */
+bool RunArchive::ArchiveExists(std::string const& archive) {
+  std::map<std::string, bool>::const_iterator it = archiveExists_.find( archive );
+  if (it != archiveExists_.end()) return it->second;
+  bool exists = FileRoutines::fileExists( archive );
+  archiveExists_[ archive ] = exists;
+  return exists;
+}
+
+/** \return true if file is in the manifest as archived to an archive that is
+  *         still present, and its contents have not changed since. Size and
+  *         modification time are compared first; contents are only hashed if
+  *         the size is the same but the modification time is not, in which case
+  *         the new modification time is recorded if contents are unchanged.
+  */
+bool RunArchive::Unchanged(FileEntry const& file) {
+  ArchiveManifest::Entry const* entry = manifest_.Find( file.first );
+  if (entry == 0 || entry->archive_ == "-") return false;
+  if (entry->size_ != (long long int)file.second.st_size) return false;
+  if (!ArchiveExists( entry->archive_ )) return false;
+  if (entry->mtime_ == (long int)file.second.st_mtime) return true;
+  std::string hex;
+  if (HashFile( file.first, file.second, hex )) return false;
+  if (hex != entry->hash_) return false;
+  ArchiveManifest::Entry updated = *entry;
+  updated.mtime_ = (long int)file.second.st_mtime;
+  manifest_.Add( file.first, updated );
+  return true;
+}
+
+/** \return Files that are new or changed since they were last archived. */
+RunArchive::FileArray RunArchive::Changed(FileArray const& files) {
+  FileArray changed;
+  for (FileArray::const_iterator file = files.begin(); file != files.end(); ++file)
+    if (!Unchanged( *file ))
+      changed.push_back( *file );
+  return changed;
+}
+
+/** Write given files to archive and record them in the manifest. An
+  * incomplete archive is removed.
+  */
+int RunArchive::WriteArchive(std::string const& tarName, FileArray const& files) {
+  TarArchive tar;
+  if (tar.OpenWrite( tarName )) return 1;
+  std::vector<ArchiveManifest::Entry> entries;
+  entries.reserve( files.size() );
+  XxHash64 hash;
+  int err = 0;
+  for (FileArray::const_iterator file = files.begin(); file != files.end(); ++file) {
+    if (debug_ > 0) Msg("\t%s\n", file->first.c_str());
+    if (tar.AddFile( file->first, file->second, &hash )) {
+      err = 1;
+      break;
+    }
+    ArchiveManifest::Entry entry;
+    entry.size_    = (long long int)file->second.st_size;
+    entry.mtime_   = (long int)file->second.st_mtime;
+    entry.hash_    = hash.HexDigest();
+    entry.archive_ = tarName;
+    entries.push_back( entry );
+  }
+  if (tar.Close()) err = 1;
+  if (err) {
+    remove( tarName.c_str() );
+    return 1;
+  }
+  for (unsigned int i = 0; i != files.size(); i++)
+    manifest_.Add( files[i].first, entries[i] );
+  Msg("  %u files (%lli bytes) in %s\n", tar.Nfiles(), tar.Nbytes(), tarName.c_str());
+  return 0;
+}
+
+/** \return '<prefix>.tgz', or '<prefix>.<#>.tgz' with the lowest # (starting
+  *         at 1) that does not exist yet.
+  */
+static std::string NextArchiveName(std::string const& prefix) {
+  std::string name( prefix + ".tgz" );
+  for (int n = 1; FileRoutines::fileExists( name ); n++)
+    name = prefix + "." + StringRoutines::integerToString(n) + ".tgz";
+  return name;
+}
+
+/** Archive run directory. Files that have not changed since they were last
+  * archived (according to the run's manifest) are skipped.
+  * \param runDir Run directory relative to the current directory.
+  * \param archiveDir Directory to write the trajectory archive to.
+  */
+int RunArchive::Archive(std::string const& runDir, std::string const& archiveDir) {
+  Msg("Archiving %s\n", runDir.c_str());
+  std::string manifestName = ArchiveManifest::FileName( runDir );
+  if (manifest_.Read( manifestName )) return 1;
+  FileArray runFiles, trajFiles, srcFiles;
+  Profile::Timer walkTimer("walk run");
+  if (Walk( runDir, false, runFiles, trajFiles, srcFiles )) return 1;
+  walkTimer.Stop();
+  if (trajFiles.empty()) {
+    ErrorMsg("No sorted/stripped trajectories (%s/TRAJ/wat.nc.*, %s/TRAJ/nowat.nc.*) found.\n",
+             runDir.c_str(), runDir.c_str());
+    return 1;
+  }
+  Profile::Timer changedTimer("find changed files");
+  FileArray newRunFiles = Changed( runFiles );
+  FileArray newTrajFiles = Changed( trajFiles );
+  changedTimer.Stop();
+  // Everything but trajectories
+  if (!newRunFiles.empty()) {
+    Profile::Timer runTimer("archive run");
+    if (WriteArchive( NextArchiveName(runDir), newRunFiles )) return 1;
+  }
+  Msg("  %u of %u run files unchanged since last archived.\n",
+      (unsigned int)(runFiles.size() - newRunFiles.size()), (unsigned int)runFiles.size());
+  // Sorted and stripped trajectories
+  TextFile trajList;
+  if (trajList.OpenWrite( archiveDir + "/archive." + runDir + ".trajs" )) return 1;
+  if (!newTrajFiles.empty()) {
+    Profile::Timer trajTimer("archive trajectories");
+    std::string trajTarName = NextArchiveName( archiveDir + "/traj." + runDir );
+    if (WriteArchive( trajTarName, newTrajFiles )) return 1;
+    trajList.Printf("%s\n", trajTarName.c_str());
+  }
+  trajList.Close();
+  Msg("  %u of %u sorted/stripped trajectories unchanged since last archived.\n",
+      (unsigned int)(trajFiles.size() - newTrajFiles.size()), (unsigned int)trajFiles.size());
+  // Record the trajectories the sorted/stripped ones were made from.
+  for (FileArray::const_iterator file = srcFiles.begin(); file != srcFiles.end(); ++file) {
+    ArchiveManifest::Entry const* old = manifest_.Find( file->first );
+    if (old != 0 && old->size_ == (long long int)file->second.st_size &&
+        old->mtime_ == (long int)file->second.st_mtime) continue;
+    ArchiveManifest::Entry entry;
+    entry.size_    = (long long int)file->second.st_size;
+    entry.mtime_   = (long int)file->second.st_mtime;
+    entry.hash_    = "-";
+    entry.archive_ = "-";
+    manifest_.Add( file->first, entry );
+  }
+  return manifest_.Write( manifestName );
+}
+
+/** Sorted/stripped trajectories are current if they are all in the manifest
+  * as archived and unchanged, and none of the trajectories they were made
+  * from have changed since. Trajectories that have been removed since are
+  * ignored, so a run can still be archived again after its raw trajectories
+  * have been deleted.
+  */
+int RunArchive::IsCurrent(std::string const& runDir) {
+  std::string manifestName = ArchiveManifest::FileName( runDir );
+  if (!FileRoutines::fileExists( manifestName )) {
+    Msg("%s has not been archived with a manifest.\n", runDir.c_str());
+    return 1;
+  }
+  if (manifest_.Read( manifestName )) return 1;
+  FileArray runFiles, trajFiles, srcFiles;
+  if (Walk( runDir, false, runFiles, trajFiles, srcFiles )) return 1;
+  if (trajFiles.empty()) {
+    Msg("%s has no sorted/stripped trajectories.\n", runDir.c_str());
+    return 1;
+  }
+  for (FileArray::const_iterator file = srcFiles.begin(); file != srcFiles.end(); ++file) {
+    ArchiveManifest::Entry const* entry = manifest_.Find( file->first );
+    if (entry == 0 || entry->size_ != (long long int)file->second.st_size ||
+        entry->mtime_ != (long int)file->second.st_mtime)
+    {
+      Msg("%s is new or has changed since %s was archived.\n", file->first.c_str(), runDir.c_str());
+      return 1;
+    }
+  }
+  for (FileArray::const_iterator file = trajFiles.begin(); file != trajFiles.end(); ++file) {
+    ArchiveManifest::Entry const* entry = manifest_.Find( file->first );
+    if (entry == 0 || entry->archive_ == "-" ||
+        entry->size_ != (long long int)file->second.st_size ||
+        entry->mtime_ != (long int)file->second.st_mtime)
+    {
+      Msg("%s is new or has changed since it was archived.\n", file->first.c_str());
+      return 1;
+    }
+  }
+  Msg("Sorted/stripped trajectories for %s are current.\n", runDir.c_str());
+  return 0;
+}
@@ -0,0 +1,44 @@
+#ifndef INC_RUNARCHIVE_H
+#define INC_RUNARCHIVE_H
+#include <string>
+#include <vector>
+#include <map>
+#include <sys/stat.h> // struct stat
+#include "ArchiveManifest.h"
+/// Archive a run directory in a single pass, without find/tar.
+/** Everything except trajectories goes into <run dir>.tgz in the current
+  * directory. Trajectories are files under a TRAJ directory or with md.nc in
+  * their name; of those only the sorted (wat.nc.*) and stripped (nowat.nc.*)
+  * trajectories written by the archive cpptraj runs to <run dir>/TRAJ are
+  * kept, in <archive dir>/traj.<run dir>.tgz. Names of trajectory archives
+  * written are listed in <archive dir>/archive.<run dir>.trajs.
+  *
+  * What was archived is recorded in the run's ArchiveManifest. Later passes
+  * only archive files that are new or have changed, into the next free
+  * archive name (e.g. <run dir>.1.tgz), so all archives of a run together
+  * hold its latest files.
+  */
+class RunArchive {
+  public:
+    RunArchive() : debug_(0) {}
+    void SetDebug(int d) { debug_ = d; }
+    /// Archive new/changed files of given run directory, trajectories to given archive directory.
+    int Archive(std::string const&, std::string const&);
+    /// \return 0 if sorted/stripped trajectories of given run directory are current, 1 otherwise.
+    int IsCurrent(std::string const&);
+  private:
+    /// A file to be archived and its lstat() info.
+    typedef std::pair<std::string, struct stat> FileEntry;
+    typedef std::vector<FileEntry> FileArray;
+
+    int Walk(std::string const&, bool, FileArray&, FileArray&, FileArray&) const;
+    bool ArchiveExists(std::string const&);
+    bool Unchanged(FileEntry const&);
+    FileArray Changed(FileArray const&);
+    int WriteArchive(std::string const&, FileArray const&);
+
+    ArchiveManifest manifest_;                ///< Record of archived files for the run.
+    std::map<std::string, bool> archiveExists_; ///< True if recorded archive is present.
+    int debug_;
+};
+#endif
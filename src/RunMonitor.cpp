@@ -0,0 +1,283 @@
+#include <cstdio>     // fflush, snprintf
+#include <ctime>      // time, strftime
+#include <unistd.h>   // sleep
+#include <sys/time.h> // gettimeofday
+#include "RunMonitor.h"
+#include "CheckRuns.h"
+#include "Messages.h"
+#include "NetcdfFile.h"
+#include "TextFile.h"
+
+using namespace Messages;
+using namespace FileRoutines;
+
+/** \return Current wall time in seconds. */
+static double WallTime() {
+  struct timeval tv;
+  gettimeofday(&tv, 0);
+  return (double)tv.tv_sec + ((double)tv.tv_usec / 1000000.0);
+}
+
+/** Format given number of seconds as [<days>d]HH:MM:SS. */
+static std::string FormatDuration(double seconds) {
+  long int total = (long int)(seconds + 0.5);
+  long int days = total / 86400;
+  total -= days * 86400;
+  char buffer[64];
+  if (days > 0)
+    snprintf(buffer, 64, "%lid%02li:%02li:%02li", days, total / 3600, (total / 60) % 60, total % 60);
+  else
+    snprintf(buffer, 64, "%02li:%02li:%02li", total / 3600, (total / 60) % 60, total % 60);
+  return std::string(buffer);
+}
+
+/** \return Extension of given file name, i.e. everything after the last '.' */
+static std::string FileExt(std::string const& fname) {
+  size_t found = fname.find_last_of(".");
+  if (found == std::string::npos) return std::string();
+  return fname.substr(found+1);
+}
+
+// =============================================================================
+double RunMonitor::RepWatch::Target() const {
+  int numexchg = ctl_.numexchg_;
+  if (numexchg < 1) numexchg = 1;
+  return t0_ + ((double)ctl_.nstlim_ * ctl_.dt_ * (double)numexchg);
+}
+
+// =============================================================================
+/** CONSTRUCTOR */
+RunMonitor::RunMonitor() : debug_(0), interval_(60), maxUpdates_(0) {}
+
+/** Determine run type from output files as in CheckRuns, then set up
+  * output, info, and trajectory file names for each replica.
+  * \param rdir Run directory prefix (with trailing slash).
+  * \return 0 if output files were found, 1 otherwise.
+  */
+int RunMonitor::FindFiles(std::string const& rdir, RunWatch& run) {
+  StrArray output_files = ExpandToFilenames(rdir + "OUTPUT/rem.out.*", false);
+  std::string infoPrefix, trajPrefix;
+  if (!output_files.empty()) {
+    infoPrefix = rdir + "INFO/reminfo.";
+    trajPrefix = rdir + "TRAJ/rem.crd.";
+  } else {
+    output_files = ExpandToFilenames(rdir + "md.out.*", false);
+    if (!output_files.empty()) {
+      infoPrefix = rdir + "md.info.";
+      trajPrefix = rdir + "md.nc.";
+    } else if (fileExists(rdir + "md.out"))
+      output_files.push_back(rdir + "md.out");
+    else
+      return 1;
+  }
+  run.reps_.resize( output_files.size() );
+  for (unsigned int rep = 0; rep != output_files.size(); rep++) {
+    RepWatch& rw = run.reps_[rep];
+    rw.outName_ = output_files[rep];
+    if (infoPrefix.empty()) {
+      rw.infoName_ = rdir + "md.info";
+      rw.trajName_ = rdir + "mdcrd.nc";
+    } else {
+      std::string ext = FileExt( output_files[rep] );
+      rw.infoName_ = infoPrefix + ext;
+      rw.trajName_ = trajPrefix + ext;
+    }
+  }
+  run.found_ = true;
+  return 0;
+}
+
+/** Read MD control info once it is completely written, then read any
+  * complete lines after the last position read, looking for the start
+  * time, the current time (NSTEP lines), and '5. TIMINGS'. A partial last
+  * line is left to be read on the next update.
+  * \return 0 if OK, 1 if MDOUT could not be read.
+  */
+int RunMonitor::ReadOutput(RepWatch& rep) {
+  TextFile mdout;
+  if (mdout.OpenRead( rep.outName_ )) return 1;
+  if (rep.haveControl_ && mdout.Size() < rep.outPos_) {
+    // MDOUT was overwritten, e.g. run was restarted. Start over.
+    RepWatch fresh;
+    fresh.outName_ = rep.outName_;
+    fresh.infoName_ = rep.infoName_;
+    fresh.trajName_ = rep.trajName_;
+    rep = fresh;
+  }
+  if (!rep.haveControl_) {
+    if (CheckRuns::ReadMdoutControl( mdout, rep.ctl_ ) != 0 || !mdout.LineComplete()) {
+      // Control section not yet completely written.
+      mdout.Close();
+      return 0;
+    }
+    rep.haveControl_ = true;
+    rep.outPos_ = mdout.Tell();
+  } else if (mdout.Seek( rep.outPos_ )) {
+    mdout.Close();
+    return 1;
+  }
+  const char* SEP = " =\r\n";
+  int ncols = mdout.GetSpans(SEP);
+  while (ncols > -1 && mdout.LineComplete()) {
+    rep.outPos_ = mdout.Tell();
+    if (ncols > 3 && mdout.SpanToken(0) == "NSTEP")
+      rep.time_ = mdout.SpanToken(3).Double();
+    else if (ncols > 6 && mdout.SpanToken(0) == "begin" && mdout.SpanToken(1) == "time") {
+      rep.t0_ = mdout.SpanToken(6).Double();
+      if (rep.time_ < 0.0) rep.time_ = rep.t0_;
+    } else if (ncols > 1 && mdout.SpanToken(0) == "5." && mdout.SpanToken(1) == "TIMINGS")
+      rep.completed_ = true;
+    ncols = mdout.GetSpans(SEP);
+  }
+  mdout.Close();
+  return 0;
+}
+
+/** Info files are rewritten by Amber every ntpr steps; re-read only if
+  * the file changed. Use the ns/day averaged over all steps if present,
+  * otherwise the most recent average.
+  */
+void RunMonitor::ReadInfo(RepWatch& rep) {
+  std::string key = CheckCache::FileKey( rep.infoName_ );
+  if (key.empty() || key == rep.infoKey_) return;
+  rep.infoKey_ = key;
+  TextFile info;
+  if (info.OpenRead( rep.infoName_ )) return;
+  const char* SEP = " |=\r\n";
+  bool allSteps = false;
+  double nsLast = -1.0;
+  double nsAll = -1.0;
+  int ncols = info.GetSpans(SEP);
+  while (ncols > -1) {
+    if (ncols > 3 && info.SpanToken(0) == "Average" && info.SpanToken(1) == "timings")
+      allSteps = (info.SpanToken(3) == "all");
+    else if (ncols > 1 && info.SpanToken(0) == "ns/day") {
+      if (allSteps)
+        nsAll = info.SpanToken(1).Double();
+      else
+        nsLast = info.SpanToken(1).Double();
+    }
+    ncols = info.GetSpans(SEP);
+  }
+  info.Close();
+  rep.nsPerDay_ = (nsAll > 0.0) ? nsAll : nsLast;
+}
+
+/** Update progress for replica from its output, info, and trajectory. If
+  * the info file has no timings, ns/day is measured from the change in
+  * simulation time between updates.
+  */
+void RunMonitor::UpdateRep(RepWatch& rep, double wallTime) {
+  if (rep.completed_) return;
+  ReadOutput( rep );
+  ReadInfo( rep );
+  NetcdfFile ncfile;
+  if (ncfile.Open( rep.trajName_ ) == 0)
+    rep.frames_ = ncfile.DimLength("frame");
+  if (rep.time_ > rep.lastTime_) {
+    if (rep.lastWall_ > 0.0 && rep.lastTime_ >= 0.0 && wallTime > rep.lastWall_)
+      rep.rate_ = ((rep.time_ - rep.lastTime_) / 1000.0) / ((wallTime - rep.lastWall_) / 86400.0);
+    rep.lastTime_ = rep.time_;
+    rep.lastWall_ = wallTime;
+  }
+}
+
+/** \return true if all replicas in run are complete. */
+bool RunMonitor::Report(RunWatch const& run) {
+  Msg("  %s:\n", run.dir_.c_str());
+  Msg("%-4s %12s %12s %7s %15s %9s %14s\n", "#Rep", "Time(ps)", "Target(ps)", "Done(%)",
+      "Frames", "ns/day", "ETA");
+  unsigned int ncomplete = 0;
+  double maxEta = 0.0;
+  bool etaKnown = true;
+  for (unsigned int rep = 0; rep != run.reps_.size(); rep++) {
+    RepWatch const& rw = run.reps_[rep];
+    if (!rw.haveControl_) {
+      Msg("%04u  Not started.\n", rep+1);
+      etaKnown = false;
+      continue;
+    }
+    double target = rw.Target();
+    double current = (rw.time_ < 0.0) ? rw.t0_ : rw.time_;
+    double done = 0.0;
+    if (target > rw.t0_) done = 100.0 * (current - rw.t0_) / (target - rw.t0_);
+    int numexchg = (rw.ctl_.numexchg_ < 1) ? 1 : rw.ctl_.numexchg_;
+    int expectedFrames = (rw.ctl_.ntwx_ > 0) ? (rw.ctl_.nstlim_ * numexchg) / rw.ctl_.ntwx_ : 0;
+    char frames[32];
+    if (rw.frames_ < 0)
+      snprintf(frames, 32, "-/%i", expectedFrames);
+    else
+      snprintf(frames, 32, "%li/%i", rw.frames_, expectedFrames);
+    double nsPerDay = (rw.nsPerDay_ > 0.0) ? rw.nsPerDay_ : rw.rate_;
+    char rate[32];
+    if (nsPerDay > 0.0)
+      snprintf(rate, 32, "%.2f", nsPerDay);
+    else
+      snprintf(rate, 32, "-");
+    std::string eta;
+    if (rw.completed_) {
+      eta = "Complete";
+      ++ncomplete;
+    } else if (nsPerDay > 0.0) {
+      double seconds = ((target - current) / 1000.0) / (nsPerDay / 86400.0);
+      if (seconds > maxEta) maxEta = seconds;
+      eta = FormatDuration( seconds );
+    } else {
+      eta = "-";
+      etaKnown = false;
+    }
+    Msg("%04u %12.3f %12.3f %7.1f %15s %9s %14s\n", rep+1, current, target, done,
+        frames, rate, eta.c_str());
+  }
+  if (ncomplete == run.reps_.size())
+    return true;
+  if (etaKnown)
+    Msg("  %u of %zu replicas complete; estimated time remaining %s.\n", ncomplete,
+        run.reps_.size(), FormatDuration(maxEta).c_str());
+  else
+    Msg("  %u of %zu replicas complete.\n", ncomplete, run.reps_.size());
+  return false;
+}
+
+/** Report progress of each run, then wait and update until all runs are
+  * complete or the max number of updates is reached. Runs are polled
+  * rather than watched for changes, which works on network file systems.
+  */
+int RunMonitor::Watch(std::string const& TopDir, StrArray const& RunDirs) {
+  Msg("Watching %zu runs every %i seconds.\n", RunDirs.size(), interval_);
+  std::vector<RunWatch> Runs( RunDirs.size() );
+  for (unsigned int ridx = 0; ridx != RunDirs.size(); ridx++)
+    Runs[ridx].dir_ = RunDirs[ridx];
+  int nupdates = 0;
+  while (true) {
+    // Files are changing; do not use cached file status.
+    ClearStatCache();
+    double wallTime = WallTime();
+    time_t now = time(0);
+    char timeStr[64];
+    strftime(timeStr, 64, "%Y-%m-%d %H:%M:%S", localtime(&now));
+    Msg("Progress at %s\n", timeStr);
+    bool allComplete = true;
+    for (std::vector<RunWatch>::iterator run = Runs.begin(); run != Runs.end(); ++run)
+    {
+      if (!run->found_ && FindFiles(TopDir + "/" + run->dir_ + "/", *run)) {
+        Msg("  %s: No output yet.\n", run->dir_.c_str());
+        allComplete = false;
+        continue;
+      }
+      for (std::vector<RepWatch>::iterator rep = run->reps_.begin(); rep != run->reps_.end(); ++rep)
+        UpdateRep( *rep, wallTime );
+      if (!Report( *run ))
+        allComplete = false;
+    }
+    fflush(stdout);
+    ++nupdates;
+    if (allComplete) {
+      Msg("All runs complete.\n");
+      break;
+    }
+    if (maxUpdates_ > 0 && nupdates >= maxUpdates_) break;
+    sleep( interval_ );
+  }
+  return 0;
+}
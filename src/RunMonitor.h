@@ -0,0 +1,79 @@
+#ifndef INC_RUNMONITOR_H
+#define INC_RUNMONITOR_H
+#include <string>
+#include <vector>
+#include <sys/types.h> // off_t
+#include "FileRoutines.h" // StrArray
+#include "CheckCache.h"
+/// Follow the progress of runs that are in progress.
+/** Output files are read incrementally: the position after the last
+  * complete line is remembered so each update only reads what has been
+  * written since. Info files are only re-read when they change, and only
+  * the header of each trajectory is read to get the current frame count.
+  */
+class RunMonitor {
+  public:
+    RunMonitor();
+    void SetDebug(int d)       { debug_ = d;    }
+    /// Set seconds to wait between updates.
+    void SetInterval(int i)    { interval_ = i; }
+    /// Set max number of updates; 0 means update until all runs are complete.
+    void SetMaxUpdates(int n)  { maxUpdates_ = n; }
+    /// Watch runs in given top directory with given subdirectories.
+    int Watch(std::string const&, FileRoutines::StrArray const&);
+  private:
+    class RepWatch;
+    class RunWatch;
+
+    /// Find output/info/trajectory files for run.
+    static int FindFiles(std::string const&, RunWatch&);
+    /// Read any new complete lines from replica MDOUT.
+    static int ReadOutput(RepWatch&);
+    /// Read ns/day from replica info file if it changed.
+    static void ReadInfo(RepWatch&);
+    /// Update replica progress.
+    static void UpdateRep(RepWatch&, double);
+    /// Print progress for run. \return true if all replicas are complete.
+    static bool Report(RunWatch const&);
+
+    int debug_;
+    int interval_;   ///< Seconds between updates.
+    int maxUpdates_; ///< Max number of updates; 0 is no limit.
+};
+
+/** State for a single replica. */
+class RunMonitor::RepWatch {
+  public:
+    RepWatch() : outPos_(0), haveControl_(false), completed_(false), t0_(0.0),
+                 time_(-1.0), frames_(-1), nsPerDay_(-1.0), rate_(-1.0),
+                 lastTime_(-1.0), lastWall_(-1.0) {}
+    /// \return Simulation time (ps) run will end at.
+    double Target() const;
+
+    std::string outName_;   ///< MDOUT file.
+    std::string infoName_;  ///< MDINFO file.
+    std::string trajName_;  ///< Trajectory file.
+    CheckCache::Entry ctl_; ///< nstlim, dt, numexchg, ntwx from MDOUT.
+    std::string infoKey_;   ///< Info file inode/size/mtime when last read.
+    off_t outPos_;          ///< Position in MDOUT after last complete line read.
+    bool haveControl_;      ///< True once MDOUT control section has been read.
+    bool completed_;        ///< True if MDOUT has timings.
+    double t0_;             ///< Simulation time (ps) at start of run.
+    double time_;           ///< Latest simulation time (ps) from MDOUT, -1 if none yet.
+    long int frames_;       ///< Current number of trajectory frames, -1 if unknown.
+    double nsPerDay_;       ///< Average ns/day from info file, -1 if not available.
+    double rate_;           ///< ns/day measured between updates, -1 if not available.
+    double lastTime_;       ///< Simulation time at last measured update.
+    double lastWall_;       ///< Wall time (s) at last measured update.
+};
+
+/** State for a single run. */
+class RunMonitor::RunWatch {
+  public:
+    RunWatch() : found_(false) {}
+
+    std::string dir_;            ///< Run directory name.
+    std::vector<RepWatch> reps_; ///< Replicas.
+    bool found_;                 ///< True once output files have been found.
+};
+#endif
@@ -2,11 +2,20 @@
 #include "Submit.h"
 #include "Messages.h"
 #include "StringRoutines.h"
+#include "Profile.h"
 
 using namespace Messages;
 using namespace StringRoutines;
 using namespace FileRoutines;
 
+const std::string Submit::jobManifestName_ = "submitted.jobids";
+
+/** Run the given job submission command. \return Exit status of command. */
+static int RunSubmitCommand(std::string const& submitCommand) {
+  Profile::Timer timer("scheduler");
+  return system( submitCommand.c_str() );
+}
+
 Submit::~Submit() {
   if (Run_ != 0) delete Run_;
   if (Analyze_ != 0) delete Analyze_;
@@ -20,13 +29,16 @@ void Submit::OptHelp() {
       "  NODES <#>          : Number of nodes needed.\n"
       "  PPN <#>            : Processors per node needed.\n"
       "  THREADS <#>        : Number of threads needed. Calcd from NODES * PPN if not specified\n"
+      "  PARALLEL <#>       : Number of runs to archive at once (archive only); the threads\n"
+      "                       are divided between them. Default 1.\n"
       "  AMBERHOME <dir>    : Directory containing AMBER installation.\n"
       "  PROGRAM <name>     : Name of binary to run (required).\n"
       "  QSUB <arg>         : Queue type {PBS | SBATCH (slurm)}\n"
       "  WALLTIME <arg>     : Wall time needed.\n"
       "  NODEARGS <arg>     : Any additonal -l node arguments (PBS only)\n"
       "  MPIRUN <command>   : Command used to execute parallel run. Can use\n"
-      "                       $NODES, $THREADS, $PPN (will be set by script).\n"
+      "                       $NODES, $THREADS, $PPN (will be set by script), and\n"
+      "                       $TASK_THREADS (threads for each task if PARALLEL > 1).\n"
       "  MODULEFILE <file>  : File containing extra commands to run (only last one loaded used)\n"
       "  COMMANDFILE <file> : File containing any additional commands to be run.\n"
       "  COMMAND <command>  : Additional command to run (can specify multiple).\n"
@@ -44,12 +56,17 @@ int Submit::SubmitRuns(std::string const& TopDir, StrArray const& RunDirs, int s
 const
 {
   Run_->Info();
-  std::string user = NoTrailingWhitespace( UserName() );
-  Msg("User: %s\n", user.c_str());
   std::string jobIdFilename(TopDir + "/temp.jobid");
   std::string submitScript( std::string(Run_->SubmitCmd()) + ".sh" );
-  std::string submitCommand( std::string(Run_->SubmitCmd()) + " " +
-                             submitScript + " > " + jobIdFilename);
+  // Both qsub and 'sbatch --parsable' print only the job ID, so it can be
+  // read directly from the submission output.
+  std::string submitCommand( Run_->SubmitCmd() );
+  if (Run_->QueueType() == SLURM)
+    submitCommand.append(" --parsable");
+  submitCommand.append(" " + submitScript + " > " + jobIdFilename);
+  // Record submitted job IDs in manifest in top dir.
+  std::string manifestName(TopDir + "/" + jobManifestName_);
+  TextFile manifest;
   std::string runScriptName("RunMD.sh");
   // Create run script for each run directory
   if (!prev_jobidIn.empty())
@@ -99,36 +116,49 @@ const
       Msg("Job will be submitted when previous job completes.\n");
     else {
       Msg("%s\n", submitCommand.c_str()); 
-      if ( system( submitCommand.c_str() ) ) {
+      if ( RunSubmitCommand( submitCommand ) ) {
         ErrorMsg("Job submission failed.\n");
         return 1;
       }
       // Get job ID of submitted job
+      std::string dependsOn = previous_jobid;
+      if (Run_->DependType() != BATCH || dependsOn.empty()) dependsOn.assign("-");
       TextFile jobid;
-      if (Run_->QueueType() == PBS) {
-        if (jobid.OpenRead( jobIdFilename )) return 1;
-        const char* ptr = jobid.Gets();
-        if (ptr == 0) return 1;
-        previous_jobid.assign(ptr);
-      } else if (Run_->QueueType() == SLURM) {
-        // -i inidcates reverse sort
-        if (jobid.OpenPipe("squeue -u " + user + " --sort=-i")) return 1;
-        const char* ptr = jobid.Gets();     // Header with JOBID
-        if (ptr == 0) return 1;
-        int cols = jobid.GetColumns(" \t"); // Should be last submitted job
-        if (cols < 1) return 1;
-        previous_jobid.assign( jobid.Token(0) );
-      } else return 1; // sanity check
+      if (jobid.OpenRead( jobIdFilename )) return 1;
+      const char* ptr = jobid.Gets();
+      if (ptr == 0) {
+        ErrorMsg("Could not read job ID from '%s'\n", jobIdFilename.c_str());
+        return 1;
+      }
+      previous_jobid = NoTrailingWhitespace( std::string(ptr) );
       jobid.Close();
+      // sbatch --parsable prints <jobid>[;<cluster>]
+      if (Run_->QueueType() == SLURM) {
+        std::string::size_type semi = previous_jobid.find(';');
+        if (semi != std::string::npos)
+          previous_jobid.resize( semi );
+      }
       Msg("  Submitted: %s\n", previous_jobid.c_str());
-      if (previous_jobid.empty() || previous_jobid == "JOBID") {
+      if (previous_jobid.empty()) {
         ErrorMsg("Job not submitted.\n");
         return 1;
       }
+      if (!manifest.IsOpen()) {
+        bool isNew = !fileExists( manifestName );
+        if (manifest.OpenAppend( manifestName )) return 1;
+        if (isNew) manifest.Printf("#RunDir JobID DependsOn\n");
+      }
+      manifest.Printf("%s %s %s\n", rdir->c_str(), previous_jobid.c_str(), dependsOn.c_str());
+      // Keep manifest current in case a later submission fails.
+      manifest.Flush();
       if (Run_->DependType() != BATCH) previous_jobid.clear();
     }
     ++run_num;
   }
+  if (manifest.IsOpen()) {
+    manifest.Close();
+    Msg("Job IDs written to '%s'\n", manifestName.c_str());
+  }
 
   return 0; 
 }
@@ -169,7 +199,7 @@ int Submit::SubmitAnalysis(std::string const& TopDir, int start, int stop, bool
   else {
     ChangeDir( CPPDIR );
     std::string submitCommand( std::string(Analyze_->SubmitCmd()) + " " + qName );
-    if ( system( submitCommand.c_str() ) ) {
+    if ( RunSubmitCommand( submitCommand ) ) {
       ErrorMsg("Analysis job submission failed.\n");
       return 1;
     }
@@ -213,6 +243,9 @@ int Submit::SubmitArchive(std::string const& TopDir, int start, int stop, bool o
   TextFile qout;
   if (qout.OpenWrite( qName )) return 1;
   if (Archive_->QsubHeader(qout, -1, std::string(), "ar." + suffix + ".")) return 1;
+  qout.Printf("\n# Runs to archive at once and threads for each\n"
+              "export ARCHIVE_JOBS=%i\nexport ARCHIVE_THREADS=%i\n",
+              Archive_->Ntasks(), Archive_->TaskThreads());
   qout.Printf("\n# Run script\n./%s\nexit $?\n", scriptName.c_str());
   qout.Close();
   ChangePermissions( qName );
@@ -221,7 +254,7 @@ int Submit::SubmitArchive(std::string const& TopDir, int start, int stop, bool o
     Msg("Just testing; not submitting archive job.\n");
   else {
     std::string submitCommand( std::string(Archive_->SubmitCmd()) + " " + qName );
-    if ( system( submitCommand.c_str() ) ) {
+    if ( RunSubmitCommand( submitCommand ) ) {
       ErrorMsg("Archive job submission failed.\n");
       return 1;
     }
@@ -311,6 +344,7 @@ Submit::QueueOpts::QueueOpts() :
   nodes_(0),
   ppn_(0),
   threads_(0),
+  parallel_(0),
   queueType_(PBS),
   isSerial_(false),
   dependType_(BATCH)
@@ -342,6 +376,7 @@ int Submit::QueueOpts::ProcessOption(std::string const& OPT, std::string const&
   else if (OPT == "NODES"  ) nodes_ = atoi( VAR.c_str() );
   else if (OPT == "PPN"    ) ppn_ = atoi( VAR.c_str() );
   else if (OPT == "THREADS") threads_ = atoi( VAR.c_str() );
+  else if (OPT == "PARALLEL") parallel_ = atoi( VAR.c_str() );
   else if (OPT == "RUNTYPE") {
     ErrorMsg("RUNTYPE is obsolete. Please remove.\n");
     return 1;
@@ -438,6 +473,7 @@ void Submit::QueueOpts::Info() const {
   if (nodes_ > 0  ) Msg("  NODES     : %i\n", nodes_);
   if (ppn_ > 0    ) Msg("  PPN       : %i\n", ppn_);
   if (threads_ > 0) Msg("  THREADS   : %i\n", threads_);
+  if (parallel_ > 1) Msg("  PARALLEL  : %i\n", parallel_);
   if (!amberhome_.empty()) Msg("  AMBERHOME : %s\n", amberhome_.c_str());
   Msg("  PROGRAM   : %s\n", program_.c_str());
   Msg("  QSUB      : %s\n", QueueTypeStr[queueType_]);
@@ -464,6 +500,13 @@ void Submit::QueueOpts::CalcThreads() {
     Msg("Warning: Less than 1 thread specified.\n");
 }
 
+/** Threads are divided evenly between tasks run at once. */
+int Submit::QueueOpts::TaskThreads() const {
+  int nthreads = threads_ / Ntasks();
+  if (nthreads < 1) nthreads = 1;
+  return nthreads;
+}
+
 void Submit::QueueOpts::AdditionalFlags(TextFile& qout) const {
   for (Sarray::const_iterator flag = Flags_.begin(); flag != Flags_.end(); ++flag)
     qout.Printf("#%s %s\n", QueueTypeStr[queueType_], flag->c_str());
@@ -515,6 +558,7 @@ int Submit::QueueOpts::QsubHeader(TextFile& qout, int run_num, std::string const
   if (ppn_ > 0) qout.Printf("PPN=%i\n", ppn_);
   if (nodes_ > 0) qout.Printf("NODES=%i\n", nodes_);
   if (threads_ > 0) qout.Printf("THREADS=%i\n", threads_);
+  if (parallel_ > 1) qout.Printf("TASK_THREADS=%i\n", TaskThreads());
   // If AMBERHOME is set, set the EXE path
   if (!amberhome_.empty()) {
     qout.Printf("export AMBERHOME=%s\n", amberhome_.c_str());
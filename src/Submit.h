@@ -23,6 +23,7 @@ class Submit {
     enum QUEUETYPE { PBS = 0, SLURM, NO_QUEUE };
     enum DEPENDTYPE { BATCH = 0, SUBMIT, NONE, NO_DEP };
     typedef std::vector<std::string> Sarray;
+    static const std::string jobManifestName_; ///< File in top dir recording submitted job IDs.
 
     QueueOpts *Run_;     ///< Run queue options
     QueueOpts *Analyze_; ///< Analysis queue options
@@ -45,6 +46,10 @@ class Submit::QueueOpts {
     DEPENDTYPE DependType() const { return dependType_; }
     QUEUETYPE QueueType()   const { return queueType_; }
     const char* SubmitCmd() const { return SubmitCmdStr[queueType_]; }
+    /// \return Number of tasks to run at once (at least 1).
+    int Ntasks() const { return (parallel_ > 1) ? parallel_ : 1; }
+    /// \return Number of threads for each task (at least 1).
+    int TaskThreads() const;
   private:
     void AdditionalFlags(TextFile&) const;
 
@@ -56,6 +61,7 @@ class Submit::QueueOpts {
     int nodes_;                      ///< Number of nodes
     int ppn_;                        ///< Processors per node
     int threads_;                    ///< Total number of threads required.
+    int parallel_;                   ///< Number of tasks to run at once (archive only).
     std::string walltime_;           ///< Wallclock time for queuing system
     std::string email_;              ///< User email address
     std::string account_;            ///< Account for running jobs
@@ -0,0 +1,263 @@
+#include <cerrno>
+#include <cstring>   // memset, memcpy, strerror
+#include <fcntl.h>   // open
+#include <unistd.h>  // read, close, readlink
+#ifdef HAS_ZLIB
+# include "zlib.h"
+#endif
+#include "TarArchive.h"
+#include "XxHash64.h"
+#include "Messages.h"
+#include "Profile.h"
+
+using namespace Messages;
+
+/** Size of a tar header/data record. */
+static const size_t RECORDSIZE = 512;
+
+TarArchive::TarArchive() :
+  gz_(0),
+  pipe_(0),
+  buffer_(0),
+  err_(false),
+  nfiles_(0),
+  nbytes_(0)
+{}
+
+TarArchive::~TarArchive() {
+  if (gz_ != 0 || pipe_ != 0) Close();
+  delete[] buffer_;
+}
+
+/** Open compressed archive for writing. Any existing file is overwritten. */
+int TarArchive::OpenWrite(std::string const& fname) {
+  if (gz_ != 0 || pipe_ != 0) Close();
+  fname_ = fname;
+  err_ = false;
+  nfiles_ = 0;
+  nbytes_ = 0;
+  if (buffer_ == 0) buffer_ = new char[ BLOCKSIZE ];
+  Profile::Count("open()");
+# ifdef HAS_ZLIB
+  gzFile gz = gzopen( fname_.c_str(), "wb6" );
+  if (gz == 0) {
+    ErrorMsg("Could not open archive '%s': %s\n", fname_.c_str(), strerror( errno ));
+    return 1;
+  }
+  gzbuffer( gz, BLOCKSIZE );
+  gz_ = (void*)gz;
+# else
+  // Single-quote the name for the shell; each ' becomes '\''
+  std::string quoted("'");
+  for (std::string::const_iterator c = fname_.begin(); c != fname_.end(); ++c) {
+    if (*c == '\'')
+      quoted.append("'\\''");
+    else
+      quoted += *c;
+  }
+  quoted += '\'';
+  std::string cmd("gzip -c > " + quoted);
+  pipe_ = popen( cmd.c_str(), "w" );
+  if (pipe_ == 0) {
+    ErrorMsg("Could not open pipe to gzip for archive '%s'\n", fname_.c_str());
+    return 1;
+  }
+# endif
+  return 0;
+}
+
+/** Write given bytes to the compressed stream. */
+int TarArchive::Write(const void* data, size_t nbytes) {
+  if (err_) return 1;
+# ifdef HAS_ZLIB
+  if (nbytes > 0 && gzwrite( (gzFile)gz_, data, (unsigned int)nbytes ) == 0) {
+    int errnum = 0;
+    ErrorMsg("Writing archive '%s': %s\n", fname_.c_str(), gzerror( (gzFile)gz_, &errnum ));
+    err_ = true;
+  }
+# else
+  if (fwrite( data, 1, nbytes, pipe_ ) != nbytes) {
+    ErrorMsg("Writing archive '%s' to gzip failed.\n", fname_.c_str());
+    err_ = true;
+  }
+# endif
+  return (int)err_;
+}
+
+/** Write zeros to pad an entry of given size out to a whole record. */
+int TarArchive::Pad(long long int size) {
+  size_t remainder = (size_t)(size % RECORDSIZE);
+  if (remainder == 0) return 0;
+  char zeros[RECORDSIZE];
+  memset(zeros, 0, RECORDSIZE);
+  return Write( zeros, RECORDSIZE - remainder );
+}
+
+/** Write value into a header field as zero-padded octal. Values too large for
+  * the field use the GNU base-256 form (high bit of first byte set).
+  */
+static void NumericField(char* field, size_t width, long long int value) {
+  unsigned long long int uval = (unsigned long long int)value;
+  if (uval < (1ULL << (3 * (width - 1)))) {
+    for (size_t i = width - 1; i > 0; i--) {
+      field[i-1] = (char)('0' + (uval & 7));
+      uval >>= 3;
+    }
+    field[width-1] = '\0';
+  } else {
+    for (size_t i = width; i > 1; i--) {
+      field[i-1] = (char)(uval & 0xFF);
+      uval >>= 8;
+    }
+    field[0] = (char)0x80;
+  }
+}
+
+/** Write GNU long name ('L') or long link target ('K') entry for given name. */
+int TarArchive::WriteLongName(char type, std::string const& name) {
+  char header[RECORDSIZE];
+  memset(header, 0, RECORDSIZE);
+  strcpy(header, "././@LongLink");
+  NumericField(header + 100, 8, 0644);
+  NumericField(header + 108, 8, 0);
+  NumericField(header + 116, 8, 0);
+  NumericField(header + 124, 12, (long long int)name.size() + 1);
+  NumericField(header + 136, 12, 0);
+  header[156] = type;
+  memcpy(header + 257, "ustar", 6);
+  memcpy(header + 263, "00", 2);
+  memset(header + 148, ' ', 8);
+  unsigned int chksum = 0;
+  for (size_t i = 0; i != RECORDSIZE; i++)
+    chksum += (unsigned char)header[i];
+  NumericField(header + 148, 7, chksum);
+  if (Write( header, RECORDSIZE )) return 1;
+  if (Write( name.c_str(), name.size() + 1 )) return 1;
+  return Pad( (long long int)name.size() + 1 );
+}
+
+/** Write ustar header for an entry. Names that do not fit are split into
+  * prefix and name fields when possible, otherwise a long name entry is
+  * written first.
+  */
+int TarArchive::WriteHeader(std::string const& name, char type, long long int size,
+                            struct stat const& st, std::string const& linkName)
+{
+  char header[RECORDSIZE];
+  memset(header, 0, RECORDSIZE);
+  if (name.size() <= 100)
+    memcpy(header, name.c_str(), name.size());
+  else {
+    // Split at the first '/' that leaves name <= 100 chars if prefix <= 155 chars.
+    std::string::size_type split = name.find('/', name.size() - 101);
+    if (split != std::string::npos && split != 0 && split <= 155 && split < name.size() - 1) {
+      memcpy(header + 345, name.c_str(), split);
+      memcpy(header, name.c_str() + split + 1, name.size() - split - 1);
+    } else {
+      if (WriteLongName('L', name)) return 1;
+      memcpy(header, name.c_str(), 100);
+    }
+  }
+  if (linkName.size() > 100) {
+    if (WriteLongName('K', linkName)) return 1;
+    memcpy(header + 157, linkName.c_str(), 100);
+  } else
+    memcpy(header + 157, linkName.c_str(), linkName.size());
+  NumericField(header + 100, 8, st.st_mode & 07777);
+  NumericField(header + 108, 8, st.st_uid);
+  NumericField(header + 116, 8, st.st_gid);
+  NumericField(header + 124, 12, size);
+  NumericField(header + 136, 12, st.st_mtime);
+  header[156] = type;
+  memcpy(header + 257, "ustar", 6);
+  memcpy(header + 263, "00", 2);
+  // Checksum is computed with the checksum field set to spaces.
+  memset(header + 148, ' ', 8);
+  unsigned int chksum = 0;
+  for (size_t i = 0; i != RECORDSIZE; i++)
+    chksum += (unsigned char)header[i];
+  NumericField(header + 148, 7, chksum);
+  return Write( header, RECORDSIZE );
+}
+
+/** Add regular file or symbolic link. File contents are copied in blocks of
+  * BLOCKSIZE bytes. Other file types are ignored.
+  * \param name Path of file; also the name stored in the archive.
+  * \param st lstat() info for the file.
+  * \param hash If not null, reset and set to hash of file contents (or link target).
+  */
+int TarArchive::AddFile(std::string const& name, struct stat const& st, XxHash64* hash) {
+  if (err_) return 1;
+  if (S_ISLNK(st.st_mode)) {
+    ssize_t len = readlink( name.c_str(), buffer_, BLOCKSIZE - 1 );
+    if (len < 0) {
+      ErrorMsg("Reading link '%s': %s\n", name.c_str(), strerror( errno ));
+      return 1;
+    }
+    if (hash != 0) {
+      hash->Reset();
+      hash->Update( buffer_, len );
+    }
+    if (WriteHeader( name, '2', 0, st, std::string(buffer_, len) )) return 1;
+    nfiles_++;
+    return 0;
+  }
+  if (!S_ISREG(st.st_mode)) return 0;
+  Profile::Count("open()");
+  int fd = open( name.c_str(), O_RDONLY );
+  if (fd < 0) {
+    ErrorMsg("Opening '%s' for archiving: %s\n", name.c_str(), strerror( errno ));
+    return 1;
+  }
+  long long int size = (long long int)st.st_size;
+  if (WriteHeader( name, '0', size, st, std::string() )) {
+    close( fd );
+    return 1;
+  }
+  if (hash != 0) hash->Reset();
+  // Copy exactly the size in the header; a file changing now is an error.
+  long long int remaining = size;
+  while (remaining > 0) {
+    size_t nwant = (remaining < (long long int)BLOCKSIZE) ? (size_t)remaining : BLOCKSIZE;
+    ssize_t nread = read( fd, buffer_, nwant );
+    if (nread < 0 && errno == EINTR) continue;
+    if (nread <= 0) {
+      ErrorMsg("File '%s' could not be read or shrank while archiving.\n", name.c_str());
+      close( fd );
+      err_ = true;
+      return 1;
+    }
+    if (hash != 0) hash->Update( buffer_, nread );
+    if (Write( buffer_, nread )) {
+      close( fd );
+      return 1;
+    }
+    remaining -= nread;
+  }
+  close( fd );
+  nfiles_++;
+  nbytes_ += size;
+  return Pad( size );
+}
+
+/** Write the two zero end-of-archive records and close the archive. */
+int TarArchive::Close() {
+  if (gz_ == 0 && pipe_ == 0) return 1;
+  char zeros[2 * RECORDSIZE];
+  memset(zeros, 0, 2 * RECORDSIZE);
+  Write( zeros, 2 * RECORDSIZE );
+# ifdef HAS_ZLIB
+  if (gzclose( (gzFile)gz_ ) != Z_OK) {
+    ErrorMsg("Closing archive '%s' failed.\n", fname_.c_str());
+    err_ = true;
+  }
+  gz_ = 0;
+# else
+  if (pclose( pipe_ ) != 0) {
+    ErrorMsg("gzip failed for archive '%s'\n", fname_.c_str());
+    err_ = true;
+  }
+  pipe_ = 0;
+# endif
+  return (int)err_;
+}
@@ -0,0 +1,44 @@
+#ifndef INC_TARARCHIVE_H
+#define INC_TARARCHIVE_H
+#include <string>
+#include <cstdio>     // FILE
+#include <sys/stat.h> // struct stat
+class XxHash64;
+/// Write a gzip-compressed tar (ustar) archive.
+/** File contents are streamed into the archive in fixed-size blocks, so memory
+  * use does not depend on file size. Compression is done in-process with zlib
+  * when available (HAS_ZLIB), otherwise the tar stream is piped to gzip.
+  * Names longer than ustar allows use GNU long name entries.
+  */
+class TarArchive {
+  public:
+    TarArchive();
+    ~TarArchive();
+    /// Open compressed archive with given name for writing.
+    int OpenWrite(std::string const&);
+    /// Add regular file or symbolic link with given name and lstat() info; optionally hash contents.
+    int AddFile(std::string const&, struct stat const&, XxHash64* = 0);
+    /// Finish and close archive. \return 0 if the archive was completely written.
+    int Close();
+    /// \return Number of files added.
+    unsigned int Nfiles() const { return nfiles_; }
+    /// \return Total size of file data added in bytes (uncompressed).
+    long long int Nbytes() const { return nbytes_; }
+  private:
+    /// Size of blocks used for reading files and padding entries.
+    static const size_t BLOCKSIZE = 65536;
+
+    int Write(const void*, size_t);
+    int Pad(long long int);
+    int WriteLongName(char, std::string const&);
+    int WriteHeader(std::string const&, char, long long int, struct stat const&, std::string const&);
+
+    std::string fname_;  ///< Archive file name.
+    void* gz_;           ///< zlib output stream if HAS_ZLIB.
+    FILE* pipe_;         ///< Pipe to gzip if no zlib.
+    char* buffer_;       ///< Block buffer for file contents.
+    bool err_;           ///< True if any write has failed.
+    unsigned int nfiles_;
+    long long int nbytes_;
+};
+#endif
@@ -1,14 +1,23 @@
 #include <cstdio>
+#include <algorithm> // std::min, std::max
 #include <cstdarg>
+#include <cstdlib> // atoi, atof
 #include <cstring>
+#include <sys/stat.h> // fstat
+#include <sys/mman.h> // mmap
+#include <fcntl.h>    // open
+#include <unistd.h>   // close
 #include "TextFile.h"
 #include "Messages.h"
+#include "FileRoutines.h" // InvalidateStat
+#include "Profile.h"
 
 using namespace Messages;
 
 TextFile::~TextFile() { Close(); }
 
 int TextFile::OpenRead(std::string const& fname) {
+  Profile::Count("open()");
   FILE* infile = fopen(fname.c_str(), "rb");
   if (infile == 0) {
     ErrorMsg("Opening file '%s'\n", fname.c_str());
@@ -18,6 +27,40 @@ int TextFile::OpenRead(std::string const& fname) {
   return 0;
 }
 
+/** Map entire file into memory for reading. Lines and tokens can then
+  * be accessed via GetLine()/GetSpans() without any copying.
+  */
+int TextFile::OpenMapped(std::string const& fname) {
+  Profile::Count("open()");
+  int fd = open(fname.c_str(), O_RDONLY);
+  if (fd < 0) {
+    ErrorMsg("Opening file '%s'\n", fname.c_str());
+    return 1;
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    ErrorMsg("Getting size of file '%s'\n", fname.c_str());
+    close(fd);
+    return 1;
+  }
+  mapSize_ = (size_t)file_stat.st_size;
+  pos_ = 0;
+  if (mapSize_ > 0) {
+    void* ptr = mmap(0, mapSize_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) {
+      close(fd);
+      mapSize_ = 0;
+      // Fall back to regular read.
+      return OpenRead(fname);
+    }
+    map_ = (const char*)ptr;
+    madvise(ptr, mapSize_, MADV_SEQUENTIAL);
+  } else
+    map_ = buffer_; // Empty file; no lines.
+  close(fd);
+  return 0;
+}
+
 int TextFile::OpenPipe(std::string const& cmd) {
   FILE* pipe = popen(cmd.c_str(), "r");
   if (pipe == 0) {
@@ -30,69 +73,287 @@ int TextFile::OpenPipe(std::string const& cmd) {
 }
 
 int TextFile::OpenWrite(std::string const& fname) {
-  FILE* outfile = fopen(fname.c_str(), "wb");
+  return OpenOutput(fname, "wb");
+}
+
+int TextFile::OpenAppend(std::string const& fname) {
+  return OpenOutput(fname, "ab");
+}
+
+/** Open file for output with given fopen() mode. */
+int TextFile::OpenOutput(std::string const& fname, const char* mode) {
+  Profile::Count("open()");
+  FILE* outfile = fopen(fname.c_str(), mode);
+  FileRoutines::InvalidateStat( fname );
   if (outfile == 0) {
     ErrorMsg("Opening file '%s'\n", fname.c_str());
     return 1;
   }
   file_ = (void*)outfile;
+  // Output is buffered in wbuf_, so no need for stdio buffering as well.
+  setvbuf(outfile, 0, _IONBF, 0);
+  wbuf_.resize( WBUF_SIZE );
+  wpos_ = 0;
+  writeErr_ = false;
   return 0;
 }
 
-void TextFile::Close() {
+/** Open for writing to memory; output accumulates in the write buffer
+  * until Close() and can be retrieved with MemoryContents().
+  */
+int TextFile::OpenMemory() {
+  memOut_ = true;
+  wbuf_.resize( WBUF_SIZE );
+  wpos_ = 0;
+  return 0;
+}
+
+int TextFile::Close() {
+  int err = 0;
+  if (memOut_) {
+    memOut_ = false;
+    wpos_ = 0;
+  }
+  if (map_ != 0) {
+    if (mapSize_ > 0)
+      munmap((void*)map_, mapSize_);
+    map_ = 0;
+    mapSize_ = 0;
+    pos_ = 0;
+  }
   if (file_ != 0) {
+    Flush();
     if (isPipe_) {
       pclose((FILE*)file_);
       isPipe_ = false;
-    } else
-      fclose((FILE*)file_);
+    } else if (fclose((FILE*)file_) != 0)
+      writeErr_ = true;
+    if (writeErr_) err = 1;
   }
   file_ = 0;
+  writeErr_ = false;
+  return err;
+}
+
+/** Read the next full line, however long. If the line fits in buffer_
+  * (or is in a memory map) it is not copied.
+  */
+bool TextFile::ReadLine() {
+  if (map_ != 0) {
+    if (pos_ >= mapSize_) return false;
+    line_ = map_ + pos_;
+    const char* end = (const char*)memchr(line_, '\n', mapSize_ - pos_);
+    if (end == 0) {
+      lineSize_ = mapSize_ - pos_;
+      lineHasNewline_ = false;
+      pos_ = mapSize_;
+    } else {
+      lineSize_ = (size_t)(end - line_);
+      lineHasNewline_ = true;
+      pos_ += lineSize_ + 1;
+    }
+    return true;
+  }
+  if (file_ == 0) return false;
+  if (fgets(buffer_, BUF_SIZE, (FILE*)file_) == 0) return false;
+  size_t len = strlen(buffer_);
+  if (len > 0 && buffer_[len-1] == '\n') {
+    line_ = buffer_;
+    lineSize_ = len - 1;
+    lineHasNewline_ = true;
+    return true;
+  }
+  // Line is longer than buffer_ or at end of file.
+  lineBuf_.assign(buffer_, len);
+  lineHasNewline_ = false;
+  while (fgets(buffer_, BUF_SIZE, (FILE*)file_) != 0) {
+    len = strlen(buffer_);
+    if (len > 0 && buffer_[len-1] == '\n') {
+      lineBuf_.append(buffer_, len - 1);
+      lineHasNewline_ = true;
+      break;
+    }
+    lineBuf_.append(buffer_, len);
+  }
+  line_ = lineBuf_.data();
+  lineSize_ = lineBuf_.size();
+  return true;
 }
 
 const char* TextFile::Gets() {
-  if (file_ == 0) return 0;
-  return (const char*)fgets(buffer_, BUF_SIZE-1, (FILE*)file_);
+  if (!ReadLine()) return 0;
+  // Line already terminated in buffer_
+  if (line_ == buffer_ && map_ == 0) return buffer_;
+  if (line_ != lineBuf_.data())
+    lineBuf_.assign(line_, lineSize_);
+  if (lineHasNewline_)
+    lineBuf_.append(1, '\n');
+  return lineBuf_.c_str();
 }
 
 std::string TextFile::GetString() {
-  if (file_ == 0) return std::string("");
-  char* ptr = fgets(buffer_, BUF_SIZE-1, (FILE*)file_);
-  if (ptr == 0) return std::string("");
-  // Remove any newline.
-  for (unsigned int i = 0; i != BUF_SIZE; i++) {
-    if (buffer_[i] == '\0') break;
-    if (buffer_[i] == '\n') {
-      buffer_[i] = '\0';
-      break;
-    }
+  if (!ReadLine()) return std::string("");
+  return std::string(line_, lineSize_);
+}
+
+bool TextFile::GetLine(Span& line) {
+  if (!ReadLine()) return false;
+  line = Span(line_, lineSize_);
+  return true;
+}
+
+int TextFile::GetSpans( const char* SEP ) {
+  if (!ReadLine()) return -1;
+  spans_.clear();
+  bool isSep[256];
+  memset(isSep, 0, 256 * sizeof(bool));
+  for (const char* sep = SEP; *sep != '\0'; ++sep)
+    isSep[(unsigned char)*sep] = true;
+  const char* end = line_ + lineSize_;
+  const char* ptr = line_;
+  while (ptr != end) {
+    // Skip separators
+    while (ptr != end && isSep[(unsigned char)*ptr]) ++ptr;
+    if (ptr == end) break;
+    const char* beg = ptr;
+    while (ptr != end && !isSep[(unsigned char)*ptr]) ++ptr;
+    spans_.push_back( Span(beg, (size_t)(ptr - beg)) );
   }
-  return std::string(buffer_);
+  return (int)spans_.size();
 }
 
 int TextFile::GetColumns( const char* SEP ) {
-  if (file_ == 0) return -1;
-  char* ptr = fgets(buffer_, BUF_SIZE-1, (FILE*)file_);
-  if (ptr == 0) return -1;
-  tokens_.clear();
-  ptr = strtok(buffer_, SEP);
-  while (ptr != 0) {
-    tokens_.push_back( std::string(ptr) );
-    ptr = strtok(0, SEP);
+  int ncols = GetSpans( SEP );
+  if (ncols < 0) return ncols;
+  tokens_.resize( ncols );
+  for (int i = 0; i != ncols; i++)
+    tokens_[i].assign( spans_[i].ptr(), spans_[i].size() );
+  return ncols;
+}
+
+off_t TextFile::Tell() const {
+  if (map_ != 0) return (off_t)pos_;
+  if (file_ == 0 || isPipe_) return -1;
+  return ftello((FILE*)file_);
+}
+
+int TextFile::Seek(off_t pos) {
+  if (map_ != 0) {
+    if (pos < 0 || (size_t)pos > mapSize_) return 1;
+    pos_ = (size_t)pos;
+    return 0;
+  }
+  if (file_ == 0 || isPipe_) return 1;
+  if (fseeko((FILE*)file_, pos, SEEK_SET) != 0) return 1;
+  return 0;
+}
+
+off_t TextFile::Size() const {
+  if (map_ != 0) return (off_t)mapSize_;
+  if (file_ == 0 || isPipe_) return -1;
+  struct stat file_stat;
+  if (fstat(fileno((FILE*)file_), &file_stat) != 0) return -1;
+  return file_stat.st_size;
+}
+
+/** Write any buffered output to file. */
+int TextFile::Flush() {
+  if (wpos_ == 0 || memOut_) return 0;
+  size_t nwritten = fwrite(&wbuf_[0], 1, wpos_, (FILE*)file_);
+  int err = (nwritten != wpos_);
+  wpos_ = 0;
+  if (err) {
+    ErrorMsg("Writing to file.\n");
+    writeErr_ = true;
+  }
+  return err;
+}
+
+/** Ensure there is room for given number of characters (plus a null
+  * terminator) in the write buffer, flushing and/or growing it as needed.
+  * \return pointer to the current write position.
+  */
+char* TextFile::Reserve(size_t len) {
+  if (wpos_ + len >= wbuf_.size()) {
+    if (memOut_)
+      wbuf_.resize( std::max(2 * wbuf_.size(), wpos_ + len + 1) );
+    else {
+      Flush();
+      if (len >= wbuf_.size())
+        wbuf_.resize( len + 1 );
+    }
   }
-  return (int)tokens_.size();
+  return &wbuf_[0] + wpos_;
 }
 
+/** Format directly into the write buffer. Output is only written to the
+  * file when the buffer is full or the file is closed.
+  */
 int TextFile::Printf(const char *format, ...) {
-  if (file_==0) return 1;
+  if ((file_==0 && !memOut_) || wbuf_.empty()) return 1;
   va_list args;
   va_start(args, format);
-  vsprintf(buffer_,format,args);
-  fwrite(buffer_, 1, strlen(buffer_), (FILE*)file_);
+  int len = vsnprintf(&wbuf_[0] + wpos_, wbuf_.size() - wpos_, format, args);
   va_end(args);
+  if (len < 0) return 1;
+  if (wpos_ + (size_t)len >= wbuf_.size()) {
+    // Did not fit; make room and format again.
+    char* ptr = Reserve( len );
+    va_start(args, format);
+    vsnprintf(ptr, wbuf_.size() - wpos_, format, args);
+    va_end(args);
+  }
+  wpos_ += (size_t)len;
   return 0;
 }
 
+int TextFile::Puts(const char* str, size_t len) {
+  if ((file_==0 && !memOut_) || wbuf_.empty()) return 1;
+  if (!memOut_ && len >= wbuf_.size()) {
+    // Too large to buffer; write directly.
+    if (Flush()) return 1;
+    if (fwrite(str, 1, len, (FILE*)file_) != len) {
+      ErrorMsg("Writing to file.\n");
+      return 1;
+    }
+    return 0;
+  }
+  char* ptr = Reserve( len );
+  memcpy(ptr, str, len);
+  wpos_ += len;
+  return 0;
+}
+
+int TextFile::Puts(const char* str) {
+  return Puts(str, strlen(str));
+}
+
+int TextFile::Puts(std::string const& str) {
+  return Puts(str.data(), str.size());
+}
+
+int TextFile::PutChar(char c) {
+  return Puts(&c, 1);
+}
+
+/** Convert integer to text without format parsing. */
+int TextFile::PutInt(long int ival) {
+  char buf[32];
+  char* end = buf + 32;
+  char* ptr = end;
+  unsigned long int uval;
+  if (ival < 0)
+    uval = 0UL - (unsigned long int)ival;
+  else
+    uval = (unsigned long int)ival;
+  do {
+    *(--ptr) = (char)('0' + (uval % 10));
+    uval /= 10;
+  } while (uval != 0);
+  if (ival < 0) *(--ptr) = '-';
+  return Puts(ptr, (size_t)(end - ptr));
+}
+
 TextFile::OptArray TextFile::GetOptionsArray(std::string const& fname, int debug) {
   OptArray options;
   if (OpenRead( fname )) return options;
@@ -101,7 +362,7 @@ TextFile::OptArray TextFile::GetOptionsArray(std::string const& fname, int debug
   while (ncols > -1) {
     if (ncols > 0 && tokens_[0][0] != '#') {
       if (ncols < 2) {
-        ErrorMsg("Malformed input: %s\n", buffer_);
+        ErrorMsg("Malformed input: %s\n", std::string(line_, lineSize_).c_str());
         options.clear();
         break;
       }
@@ -118,3 +379,41 @@ TextFile::OptArray TextFile::GetOptionsArray(std::string const& fname, int debug
   Close();
   return options;
 }
+
+// =============================================================================
+bool TextFile::Span::operator==(const char* rhs) const {
+  size_t len = strlen(rhs);
+  return (len == size_ && strncmp(ptr_, rhs, len) == 0);
+}
+
+bool TextFile::Span::StartsWith(const char* rhs) const {
+  size_t len = strlen(rhs);
+  return (len <= size_ && strncmp(ptr_, rhs, len) == 0);
+}
+
+bool TextFile::Span::Contains(const char* rhs) const {
+  size_t len = strlen(rhs);
+  if (len > size_) return false;
+  const char* last = ptr_ + (size_ - len);
+  for (const char* ptr = ptr_; ptr <= last; ++ptr)
+    if (*ptr == *rhs && strncmp(ptr, rhs, len) == 0)
+      return true;
+  return false;
+}
+
+/** Span text is not terminated, so copy to a temporary buffer first. */
+int TextFile::Span::Int() const {
+  char buf[64];
+  size_t len = std::min(size_, (size_t)63);
+  memcpy(buf, ptr_, len);
+  buf[len] = '\0';
+  return atoi(buf);
+}
+
+double TextFile::Span::Double() const {
+  char buf[64];
+  size_t len = std::min(size_, (size_t)63);
+  memcpy(buf, ptr_, len);
+  buf[len] = '\0';
+  return atof(buf);
+}
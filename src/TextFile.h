@@ -2,18 +2,55 @@
 #define INC_TEXTFILE_H
 #include <string>
 #include <vector>
+#include <sys/types.h> // off_t
 /// Simple wrapper for text file.
 class TextFile {
   public:
     typedef std::pair<std::string, std::string> Spair;
     typedef std::vector<Spair> OptArray;
-    TextFile() : file_(0), isPipe_(false) {}
+    /// Reference to a range of characters inside a TextFile; only valid until the next read.
+    class Span {
+      public:
+        Span() : ptr_(0), size_(0) {}
+        Span(const char* p, size_t s) : ptr_(p), size_(s) {}
+        /// \return true if span text matches given string exactly.
+        bool operator==(const char*) const;
+        bool operator!=(const char* rhs) const { return !(*this == rhs); }
+        /// \return true if span text begins with given string.
+        bool StartsWith(const char*) const;
+        /// \return true if span contains given string.
+        bool Contains(const char*) const;
+        /// \return span text as integer.
+        int Int() const;
+        /// \return span text as double.
+        double Double() const;
+        /// \return copy of span text.
+        std::string str() const { return std::string(ptr_, size_); }
+
+        const char* ptr() const { return ptr_;  }
+        size_t size()     const { return size_; }
+        bool empty()      const { return size_ == 0; }
+      private:
+        const char* ptr_; ///< Start of text.
+        size_t size_;     ///< Number of characters.
+    };
+    TextFile() : file_(0), map_(0), mapSize_(0), pos_(0), line_(0), lineSize_(0),
+                 lineHasNewline_(false), wpos_(0), memOut_(false), writeErr_(false), isPipe_(false) {}
     ~TextFile();
     int OpenRead(std::string const&);
+    /// Open file for reading via a read-only memory map.
+    int OpenMapped(std::string const&);
     int OpenPipe(std::string const&);
     int OpenWrite(std::string const&);
-    void Close();
-    /// \return next line in internal char buffer 
+    /// Open file for writing at the end of any existing contents.
+    int OpenAppend(std::string const&);
+    /// Open for writing into memory instead of a file.
+    int OpenMemory();
+    /// Close file. \return 1 if any output could not be written, 0 otherwise.
+    int Close();
+    /// \return true if file is open.
+    bool IsOpen() const { return (file_ != 0 || memOut_); }
+    /// \return next line in internal char buffer
     const char* Gets();
     /// \return next line as string, no newline.
     std::string GetString();
@@ -21,18 +58,71 @@ class TextFile {
     int GetColumns(const char*);
     /// \return text in specified column
     std::string const& Token(int i) const { return tokens_[i]; }
-    /// Print formatted text to file.
+    /// Get next line (no newline) without copying when possible. \return false if no more lines.
+    bool GetLine(Span&);
+    /// \return true if the last line read was terminated by a newline.
+    bool LineComplete() const { return lineHasNewline_; }
+    /// \return Number of columns in next line; stored as spans (no copying when possible).
+    int GetSpans(const char*);
+    /// \return span of text in specified column (valid until next read).
+    Span const& SpanToken(int i) const { return spans_[i]; }
+    /// \return Current position in file, -1 on error.
+    off_t Tell() const;
+    /// Seek to given absolute position in file. \return 0 on success.
+    int Seek(off_t);
+    /// \return Total size of file in bytes, -1 on error.
+    off_t Size() const;
+    /// Print formatted text to file (buffered).
     int Printf(const char*, ...);
+    /// Write string to file (buffered, no format parsing).
+    int Puts(const char*);
+    /// Write given number of characters to file (buffered).
+    int Puts(const char*, size_t);
+    /// Write string to file (buffered, no format parsing).
+    int Puts(std::string const&);
+    /// Write single character to file (buffered).
+    int PutChar(char);
+    /// Write integer to file (buffered, no format parsing).
+    int PutInt(long int);
+    /// Write any buffered output to file.
+    int Flush();
+    /// \return Text written so far when opened with OpenMemory().
+    std::string MemoryContents() const {
+      return wbuf_.empty() ? std::string() : std::string(&wbuf_[0], wpos_);
+    }
     /// \return pointer to internal buffer.
     const char* Buffer() const { return buffer_; }
     /// \return Options array from <OPT> <VAR> style file.
     OptArray GetOptionsArray(std::string const&, int);
   private:
     static const unsigned int BUF_SIZE = 8192;
+    static const unsigned int WBUF_SIZE = 65536;
+    typedef std::vector<std::string> Sarray;
+    typedef std::vector<Span> SpanArray;
+
+    /// Read next full line into line_; \return false if no more lines.
+    bool ReadLine();
+    /// Open file for output with given mode.
+    int OpenOutput(std::string const&, const char*);
+    /// Make room for given # chars in write buffer; \return write position.
+    char* Reserve(size_t);
+
     char buffer_[BUF_SIZE];
     void* file_;
-    typedef std::vector<std::string> Sarray;
+    const char* map_;     ///< Start of memory-mapped file contents.
+    size_t mapSize_;      ///< Size of memory-mapped file.
+    size_t pos_;          ///< Current read position in memory-mapped file.
+    const char* line_;    ///< Start of current line.
+    size_t lineSize_;     ///< Size of current line (not including newline).
+    bool lineHasNewline_; ///< True if current line was terminated by a newline.
+    std::string lineBuf_; ///< Hold lines that do not fit in buffer_/need termination.
     Sarray tokens_;
+    SpanArray spans_;     ///< Spans of current line columns.
+    std::vector<char> wbuf_; ///< Output buffer (write mode).
+    size_t wpos_;            ///< Current position in output buffer.
+    bool memOut_;            ///< True if writing to memory (OpenMemory).
+    bool writeErr_;          ///< True if any output could not be written since open.
     bool isPipe_;
 };
+
 #endif
@@ -0,0 +1,118 @@
+#include <cstdio>  // snprintf
+#include <cstring> // memcpy
+#include "XxHash64.h"
+
+typedef XxHash64::Uint64 Uint64;
+
+/** XXH64 primes. */
+static const Uint64 PRIME1 = 11400714785074694791ULL;
+static const Uint64 PRIME2 = 14029467366897019727ULL;
+static const Uint64 PRIME3 =  1609587929392839161ULL;
+static const Uint64 PRIME4 =  9650029242287828579ULL;
+static const Uint64 PRIME5 =  2870177450012600261ULL;
+
+static inline Uint64 Rotl(Uint64 x, int r) { return (x << r) | (x >> (64 - r)); }
+
+/** \return Little-endian 64 bit value at given address. */
+static inline Uint64 Read64(const unsigned char* p) {
+  return  (Uint64)p[0]        | ((Uint64)p[1] << 8)  | ((Uint64)p[2] << 16) |
+         ((Uint64)p[3] << 24) | ((Uint64)p[4] << 32) | ((Uint64)p[5] << 40) |
+         ((Uint64)p[6] << 48) | ((Uint64)p[7] << 56);
+}
+
+/** \return Little-endian 32 bit value at given address. */
+static inline Uint64 Read32(const unsigned char* p) {
+  return (Uint64)p[0] | ((Uint64)p[1] << 8) | ((Uint64)p[2] << 16) | ((Uint64)p[3] << 24);
+}
+
+static inline Uint64 Round(Uint64 acc, Uint64 input) {
+  acc += input * PRIME2;
+  acc = Rotl(acc, 31);
+  return acc * PRIME1;
+}
+
+static inline Uint64 MergeRound(Uint64 acc, Uint64 val) {
+  acc ^= Round(0, val);
+  return acc * PRIME1 + PRIME4;
+}
+
+void XxHash64::Reset() {
+  acc_[0] = PRIME1 + PRIME2;
+  acc_[1] = PRIME2;
+  acc_[2] = 0;
+  acc_[3] = -PRIME1;
+  nbuf_ = 0;
+  total_ = 0;
+}
+
+void XxHash64::Update(const void* data, size_t nbytes) {
+  const unsigned char* p = (const unsigned char*)data;
+  const unsigned char* end = p + nbytes;
+  total_ += nbytes;
+  // Complete any partial stripe from the last update.
+  if (nbuf_ > 0) {
+    size_t nfill = 32 - nbuf_;
+    if (nbytes < nfill) {
+      memcpy(buf_ + nbuf_, p, nbytes);
+      nbuf_ += nbytes;
+      return;
+    }
+    memcpy(buf_ + nbuf_, p, nfill);
+    for (int i = 0; i != 4; i++)
+      acc_[i] = Round(acc_[i], Read64(buf_ + 8*i));
+    p += nfill;
+    nbuf_ = 0;
+  }
+  // Whole stripes
+  while (end - p >= 32) {
+    acc_[0] = Round(acc_[0], Read64(p));
+    acc_[1] = Round(acc_[1], Read64(p + 8));
+    acc_[2] = Round(acc_[2], Read64(p + 16));
+    acc_[3] = Round(acc_[3], Read64(p + 24));
+    p += 32;
+  }
+  nbuf_ = end - p;
+  if (nbuf_ > 0) memcpy(buf_, p, nbuf_);
+}
+
+XxHash64::Uint64 XxHash64::Digest() const {
+  Uint64 h;
+  if (total_ >= 32) {
+    h = Rotl(acc_[0], 1) + Rotl(acc_[1], 7) + Rotl(acc_[2], 12) + Rotl(acc_[3], 18);
+    for (int i = 0; i != 4; i++)
+      h = MergeRound(h, acc_[i]);
+  } else
+    h = PRIME5;
+  h += total_;
+  // Remaining bytes
+  const unsigned char* p = buf_;
+  const unsigned char* end = buf_ + nbuf_;
+  while (end - p >= 8) {
+    h ^= Round(0, Read64(p));
+    h = Rotl(h, 27) * PRIME1 + PRIME4;
+    p += 8;
+  }
+  if (end - p >= 4) {
+    h ^= Read32(p) * PRIME1;
+    h = Rotl(h, 23) * PRIME2 + PRIME3;
+    p += 4;
+  }
+  while (p != end) {
+    h ^= (*p) * PRIME5;
+    h = Rotl(h, 11) * PRIME1;
+    ++p;
+  }
+  // Avalanche
+  h ^= h >> 33;
+  h *= PRIME2;
+  h ^= h >> 29;
+  h *= PRIME3;
+  h ^= h >> 32;
+  return h;
+}
+
+std::string XxHash64::HexDigest() const {
+  char buffer[17];
+  snprintf(buffer, 17, "%016llx", Digest());
+  return std::string(buffer);
+}
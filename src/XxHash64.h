@@ -0,0 +1,28 @@
+#ifndef INC_XXHASH64_H
+#define INC_XXHASH64_H
+#include <string>
+#include <cstddef> // size_t
+/// Incremental 64-bit xxHash (XXH64) of a stream of bytes.
+/** Fast non-cryptographic hash used to tell whether file contents have
+  * changed. Data may be added in pieces of any size; the digest is the same
+  * as hashing all of it at once.
+  */
+class XxHash64 {
+  public:
+    typedef unsigned long long int Uint64;
+    XxHash64() { Reset(); }
+    /// Start a new hash with seed 0.
+    void Reset();
+    /// Add given bytes to the hash.
+    void Update(const void*, size_t);
+    /// \return Hash of all bytes added so far.
+    Uint64 Digest() const;
+    /// \return Hash of all bytes added so far as 16 hexadecimal digits.
+    std::string HexDigest() const;
+  private:
+    Uint64 acc_[4];           ///< Accumulators, one for each 8 bytes of a 32 byte stripe.
+    unsigned char buf_[32];   ///< Bytes not yet consumed as a complete stripe.
+    size_t nbuf_;             ///< Number of bytes in buf_.
+    Uint64 total_;            ///< Total number of bytes added.
+};
+#endif
@@ -1,10 +1,14 @@
 #include <cstdlib> //atoi
 #include "RemdDirs.h"
+#include "RunArchive.h"
 #include "CheckRuns.h"
+#include "RunMonitor.h"
+#include "ExchangeStats.h"
 #include "Submit.h"
 #include "Messages.h"
 #include "FileRoutines.h"
 #include "StringRoutines.h"
+#include "Profile.h"
 
 using namespace Messages;
 using namespace FileRoutines;
@@ -27,13 +31,42 @@ static void CmdLineHelp() {
       "  --create-help : Print run creation help.\n"
       "  --submit-help : Print run submission help.\n"
       "  --nomdin      : No extra MD input needed. Ignored if MDIN_FILE specified in input options file.\n"
+      "  --create-threads <#> : Number of threads to use when creating replica input (requires OpenMP).\n"
+      "  --rebalance   : Rebalance temperatures for uniform exchange acceptance using rem.log\n"
+      "                  of the run before the start run (run creation only).\n"
       "  --analyze     : Enable analysis input creation/submit.\n"
       "  --archive     : Enable archiving input creation/submit.\n"
+      "  --archive-exec <run dir> <archive dir> : Archive a run directory in one pass\n"
+      "                  with built-in compression: everything but trajectories to\n"
+      "                  <run dir>.tgz, sorted/stripped trajectories (TRAJ/wat.nc.*,\n"
+      "                  TRAJ/nowat.nc.*) to <archive dir>/traj.<run dir>.tgz. Used by\n"
+      "                  the archive script created with --archive. Only files that are new\n"
+      "                  or changed since the last pass (see .remdarchive/) are archived.\n"
+      "  --archive-current <run dir> : Exit 0 if sorted/stripped trajectories of the run\n"
+      "                  are unchanged since archived and are current with its trajectories.\n"
       "  --runs        : Enable run input creation/submit (default if nothing else specified).\n"
       "  --submit      : Submit jobs to queue only.\n"
-      "  --check       : Check specified jobs only (requires NetCDF compilation).\n"
+      "  --check       : Check specified jobs only.\n"
       "  --nocheck     : Do not check jobs before creating analyze/archive input.\n"
-      "  --checkall    : When multiple replicas present, check all (default only first).\n\n");
+      "  --checkall    : When multiple replicas present, check all (default only first).\n"
+      "  --check-threads <#> : Number of threads to use when checking runs (requires OpenMP).\n"
+      "  --nocheckcache: Do not use/update the check cache (.remdcheck.cache).\n"
+      "  --deepcheck   : Check all REMD restarts, scanning every coordinate/velocity.\n"
+      "  --timings     : Report per-replica performance and load imbalance from output\n"
+      "                  timings when checking (implies --checkall).\n"
+      "  --check-format {text|json|csv} : Format of check results. For json (one object per\n"
+      "                  line) and csv, a record for each replica and run is written to\n"
+      "                  stdout and all other output goes to stderr.\n"
+      "  --exchange-stats : When checking, report exchange acceptance, round trips, and\n"
+      "                  replicas that never exchange from rem.log of REMD runs.\n"
+      "  --watch       : Follow progress of specified jobs until complete.\n"
+      "  --watch-interval <s> : Seconds between progress updates (default 60).\n"
+      "  --watch-count <#>    : Stop after # progress updates.\n"
+      "  --profile     : At exit, print wall time and calls of each program phase and\n"
+      "                  of file system/NetCDF/scheduler operations within them.\n"
+      "  --profile-format {text|json} : Format of the profile (implies --profile). For json\n"
+      "                  the profile is one object on the last line of stdout and all\n"
+      "                  other output goes to stderr.\n\n");
 }
 
 static void Help(bool extended) {
@@ -48,6 +81,12 @@ static void Defines() {
   Msg("Defines:");
 # ifdef HAS_NETCDF
   Msg(" -DHAS_NETCDF");
+# endif
+# ifdef HAS_ZLIB
+  Msg(" -DHAS_ZLIB");
+# endif
+# ifdef _OPENMP
+  Msg(" -D_OPENMP");
 # endif
   Msg("\n");
 }
@@ -59,15 +98,32 @@ static void Defines() {
   * 3) Check: MD runs that have already run are checked. A check is also 
   *    performed when input is created for analysis or archiving unless
   *     disabled.
+  * 4) Watch: Progress of MD runs that are running is followed.
   * For now make all modes mutually exclusive.
   */
 int main(int argc, char** argv) {
+  // Machine-readable check results and profile are written to stdout; send
+  // all other output to stderr. Start profiling before anything else.
+  for (int iarg = 1; iarg < argc; iarg++) {
+    std::string Arg( argv[iarg] );
+    if (Arg == "--profile")
+      Profile::Enable("text");
+    else if (Arg == "--profile-format" && iarg+1 != argc) {
+      if (Profile::Enable( argv[iarg+1] )) {
+        ErrorMsg("Unrecognized profile format '%s'\n", argv[iarg+1]);
+        return 1;
+      }
+      if (std::string(argv[iarg+1]) == "json")
+        SetMsgToStderr(true);
+    } else if (Arg == "--check-format" && iarg+1 != argc && std::string(argv[iarg+1]) != "text")
+      SetMsgToStderr(true);
+  }
   Msg("\nCreateRemdDir: Amber run input creation/job submission/job check.\n");
   Msg("Version: %s\n", VERSION);
   Msg("Daniel R. Roe, 2022\n");
-  enum ModeType { CREATE = 0, SUBMIT, CHECK };
+  enum ModeType { CREATE = 0, SUBMIT, CHECK, WATCH };
   enum InputType { RUNS = 0, ANALYZE, ARCHIVE };
-  std::vector<bool> ModeEnabled( 3, false );
+  std::vector<bool> ModeEnabled( 4, false );
   std::vector<bool> InputEnabled( 3, false );
   // Command line option defaults.
   std::string input_file = "remd.opts";
@@ -79,10 +135,24 @@ int main(int argc, char** argv) {
   bool needsMdin = true;
   bool overwrite = false;
   bool checkFirst = true;
+  bool deepCheck = false;
+  bool checkTimings = false;
+  bool exchangeStats = false;
+  bool rebalance = false;
+  std::string checkFormat = "text";
   bool runCheck = true;
   bool testOnly = false;
+  int checkThreads = 1;
+  int createThreads = 1;
+  bool useCheckCache = true;
+  int watchInterval = 60;
+  int watchCount = 0;
+  std::string archiveRunDir;
+  std::string archiveDir;
+  std::string currentRunDir;
   std::string qfile = "qsub.opts";
   // Get command line options
+  Profile::Timer optTimer("options");
   for (int iarg = 1; iarg < argc; iarg++) {
     std::string Arg( argv[iarg] );
     if (Arg == "-i" && iarg+1 != argc)            // Input file for CREATE 
@@ -123,21 +193,60 @@ int main(int argc, char** argv) {
       InputEnabled[ANALYZE] = true;
     else if (Arg == "--archive")                  // Enable ARCHIVE input
       InputEnabled[ARCHIVE] = true; 
+    else if (Arg == "--archive-exec" && iarg+2 < argc) { // Archive run dir now
+      archiveRunDir.assign( argv[++iarg] );
+      archiveDir.assign( argv[++iarg] );
+    } else if (Arg == "--archive-current" && iarg+1 != argc) // Check run archive is current
+      currentRunDir.assign( argv[++iarg] );
     else if (Arg == "--check") {                  // Enable CHECK mode only
       ModeEnabled[CHECK] = true;
       ModeEnabled[CREATE] = false;
       ModeEnabled[SUBMIT] = false;
-    } else if (Arg == "--checkall")               // Check all replicas, not just first.
+      ModeEnabled[WATCH] = false;
+    } else if (Arg == "--watch") {                // Enable WATCH mode only
+      ModeEnabled[WATCH] = true;
+      ModeEnabled[CHECK] = false;
+      ModeEnabled[CREATE] = false;
+      ModeEnabled[SUBMIT] = false;
+    } else if (Arg == "--watch-interval" && iarg+1 != argc) // Seconds between updates
+      watchInterval = atoi(argv[++iarg]);
+    else if (Arg == "--watch-count" && iarg+1 != argc) // Max number of updates
+      watchCount = atoi(argv[++iarg]);
+    else if (Arg == "--checkall")               // Check all replicas, not just first.
+      checkFirst = false;
+    else if (Arg == "--check-threads" && iarg+1 != argc) // Number of threads for check
+      checkThreads = atoi(argv[++iarg]);
+    else if (Arg == "--create-threads" && iarg+1 != argc) // Number of threads for create
+      createThreads = atoi(argv[++iarg]);
+    else if (Arg == "--nocheckcache")             // Do not use check cache
+      useCheckCache = false;
+    else if (Arg == "--deepcheck")                // Scan all restart coords/velocities
+      deepCheck = true;
+    else if (Arg == "--exchange-stats")           // Exchange statistics from rem.log
+      exchangeStats = true;
+    else if (Arg == "--check-format" && iarg+1 != argc) // Check results format
+      checkFormat.assign( argv[++iarg] );
+    else if (Arg == "--rebalance")                // Rebalance dimensions from previous run
+      rebalance = true;
+    else if (Arg == "--profile")                  // Handled above
+      continue;
+    else if (Arg == "--profile-format" && iarg+1 != argc) // Handled above
+      ++iarg;
+    else if (Arg == "--timings") {                // Report performance from output timings
+      checkTimings = true;
       checkFirst = false;
+    }
     else if (Arg == "-q" && iarg+1 != argc)       // SUBMIT input file
       qfile.assign( argv[++iarg] );
     else if (Arg == "--submit") {                 // Enable SUBMIT mode only
       ModeEnabled[SUBMIT] = true;
       ModeEnabled[CHECK] = false;
       ModeEnabled[CREATE] = false;
+      ModeEnabled[WATCH] = false;
     } else if (Arg == "-s") {                     // Enable SUBMIT mode in addition to creation.
       ModeEnabled[CREATE] = true;
       ModeEnabled[SUBMIT] = true;
+      ModeEnabled[WATCH] = false;
     } else if (Arg == "--defines") {
       Defines();
       return 0;
@@ -149,10 +258,25 @@ int main(int argc, char** argv) {
       return 1;
     }
   }
+  // ----- Archive a single run directory --------
+  if (!archiveRunDir.empty()) {
+    optTimer.Stop();
+    RunArchive archiver;
+    archiver.SetDebug(debug);
+    Profile::Timer archiveTimer("ArchiveExec");
+    if (archiver.Archive( archiveRunDir, archiveDir )) return 1;
+    Msg("\n");
+    return 0;
+  }
+  if (!currentRunDir.empty()) {
+    RunArchive archiver;
+    archiver.SetDebug(debug);
+    return archiver.IsCurrent( currentRunDir );
+  }
   if (stop_run == -1)
     stop_run = start_run;
   // By default enable CREATE Mode and RUNS Input
-  if (!ModeEnabled[CREATE] && !ModeEnabled[SUBMIT] && !ModeEnabled[CHECK])
+  if (!ModeEnabled[CREATE] && !ModeEnabled[SUBMIT] && !ModeEnabled[CHECK] && !ModeEnabled[WATCH])
     ModeEnabled[CREATE] = true;
   if (!InputEnabled[RUNS] && !InputEnabled[ANALYZE] && !InputEnabled[ARCHIVE])
     InputEnabled[RUNS] = true;
@@ -169,6 +293,7 @@ int main(int argc, char** argv) {
     ErrorMsg("STOP_RUN < START_RUN\n");
     return 1;
   }
+  optTimer.Stop();
   std::string TopDir = GetWorkingDir();
   if (TopDir.empty()) return 1;
   Msg("Working Dir: %s\n", TopDir.c_str());
@@ -183,22 +308,40 @@ int main(int argc, char** argv) {
     // Read RUN options from input file
     RemdDirs create;
     create.SetDebug(debug);
+    create.SetNthreads(createThreads);
+    create.SetRebalance(rebalance);
+    Profile::Timer readTimer("ReadOptions");
     if (create.ReadOptions( input_file, start_run )) return 1;
+    readTimer.Stop();
     // Setup run
+    Profile::Timer setupTimer("Setup");
     if (create.Setup( crd_dir, needsMdin )) return 1;
+    setupTimer.Stop();
     create.Info();
     // Input for Runs
     if (InputEnabled[RUNS]) {
       Msg("Creating %i runs from %i to %i\n", stop_run - start_run + 1, start_run, stop_run);
+      Profile::Timer createTimer("CreateRuns");
       if (create.CreateRuns(TopDir, RunDirs, start_run, overwrite)) return 1;
     }
     // If analysis or archive input requested, run check unless explicitly told not to.
     if (InputEnabled[ANALYZE] || InputEnabled[ARCHIVE]) {
       if (runCheck) {
         CheckRuns runChecker;
+        runChecker.SetDebug(debug);
+        runChecker.SetNthreads(checkThreads);
+        runChecker.SetUseCache(useCheckCache);
+        runChecker.SetDeepScan(deepCheck);
+        runChecker.SetReportTimings(checkTimings);
+        if (runChecker.SetFormat(checkFormat)) {
+          ErrorMsg("Unrecognized check format '%s'\n", checkFormat.c_str());
+          return 1;
+        }
+        Profile::Timer checkTimer("DoCheck");
         if (runChecker.DoCheck( TopDir, RunDirs, checkFirst )) return 1;
       } else
         Msg("Warning: Not running check on run directories.\n");
+      Profile::Timer analyzeTimer("CreateAnalyzeArchive");
       create.CreateAnalyzeArchive(TopDir, RunDirs, start_run, stop_run, overwrite, runCheck,
                                   InputEnabled[ANALYZE], InputEnabled[ARCHIVE]);
     }
@@ -206,7 +349,40 @@ int main(int argc, char** argv) {
   // ----- Run Check -----------------------------
   if (ModeEnabled[CHECK]) {
     CheckRuns runChecker;
-    if (runChecker.DoCheck( TopDir, RunDirs, checkFirst )) return 1;
+    runChecker.SetDebug(debug);
+    runChecker.SetNthreads(checkThreads);
+    runChecker.SetUseCache(useCheckCache);
+    runChecker.SetDeepScan(deepCheck);
+    runChecker.SetReportTimings(checkTimings);
+    if (runChecker.SetFormat(checkFormat)) {
+      ErrorMsg("Unrecognized check format '%s'\n", checkFormat.c_str());
+      return 1;
+    }
+    Profile::Timer checkTimer("DoCheck");
+    int checkErr = runChecker.DoCheck( TopDir, RunDirs, checkFirst );
+    checkTimer.Stop();
+    // Exchange statistics are still useful if runs are incomplete.
+    if (exchangeStats) {
+      ExchangeStats exchStats;
+      exchStats.SetDebug(debug);
+      exchStats.SetNthreads(checkThreads);
+      Profile::Timer statsTimer("ExchangeStats");
+      if (exchStats.Process( TopDir, RunDirs )) return 1;
+    }
+    if (checkErr) return 1;
+  }
+  // ----- Watch running jobs --------------------
+  if (ModeEnabled[WATCH]) {
+    if (watchInterval < 1) {
+      ErrorMsg("Watch interval must be at least 1 second.\n");
+      return 1;
+    }
+    RunMonitor monitor;
+    monitor.SetDebug(debug);
+    monitor.SetInterval(watchInterval);
+    monitor.SetMaxUpdates(watchCount);
+    Profile::Timer watchTimer("Watch");
+    if (monitor.Watch( TopDir, RunDirs )) return 1;
   }
   // ----- Job submission ------------------------
   if (ModeEnabled[SUBMIT]) {
@@ -221,16 +397,21 @@ int main(int argc, char** argv) {
     if (submit.ReadOptions( qfile )) return 1;
     if (submit.CheckOptions()) return 1;
     if (InputEnabled[RUNS]) {
+      Profile::Timer submitTimer("SubmitRuns");
       if (submit.SubmitRuns(TopDir, RunDirs, start_run, overwrite, previous_jobid)) return 1;
     }
     if (InputEnabled[ANALYZE]) {
+      Profile::Timer submitTimer("SubmitAnalysis");
       if (submit.SubmitAnalysis(TopDir, start_run, stop_run, overwrite)) return 1;
     }
     if (InputEnabled[ARCHIVE]) {
+      Profile::Timer submitTimer("SubmitArchive");
       if (submit.SubmitArchive(TopDir, start_run, stop_run, overwrite)) return 1;
     }
   }
 
+  if (debug > 0)
+    PrintStatCacheStats();
   Msg("\n");
   return 0;
 }
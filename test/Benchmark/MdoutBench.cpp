@@ -0,0 +1,145 @@
+// Microbenchmark for parsing Amber MD output with TextFile. Every line of the
+// given file is split into columns the way CheckRuns reads mdout files: with
+// fgets() and strtok() into a string per column (how TextFile::GetColumns()
+// used to work), GetColumns(), buffered GetSpans(), and memory-mapped
+// GetSpans(). Each way is timed over several passes; the best time is kept,
+// and speedups are relative to fgets()/strtok().
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+#include "../../src/TextFile.h"
+
+/** Totals from one pass, to check that every way parses the same thing. */
+struct Result {
+  Result() : nlines(0), ncols(0), nstep(0) {}
+  long int nlines; ///< Number of lines read.
+  long int ncols;  ///< Number of columns in all lines.
+  long int nstep;  ///< Sum of all NSTEP values.
+};
+
+static const char* SEP = " |=\r\n";
+
+/** \return Current wall time in seconds. */
+static double WallTime() {
+  struct timeval tv;
+  gettimeofday( &tv, 0 );
+  return (double)tv.tv_sec + (double)tv.tv_usec / 1000000.0;
+}
+
+/** Split lines with fgets() and strtok(), copying each column to a string. */
+static int ParseStrtok(const char* fname, Result& res) {
+  FILE* infile = fopen( fname, "rb" );
+  if (infile == 0) {
+    fprintf(stderr, "Error: Could not open '%s'\n", fname);
+    return 1;
+  }
+  char buffer[8192];
+  std::vector<std::string> tokens;
+  while (fgets( buffer, sizeof(buffer) - 1, infile ) != 0) {
+    tokens.clear();
+    char* ptr = strtok( buffer, SEP );
+    while (ptr != 0) {
+      tokens.push_back( std::string(ptr) );
+      ptr = strtok( 0, SEP );
+    }
+    res.nlines++;
+    res.ncols += (long int)tokens.size();
+    if (tokens.size() > 1 && tokens[0] == "NSTEP")
+      res.nstep += atol( tokens[1].c_str() );
+  }
+  fclose( infile );
+  return 0;
+}
+
+/** Split lines with GetColumns(). */
+static int ParseColumns(const char* fname, Result& res) {
+  TextFile mdout;
+  if (mdout.OpenRead( fname )) return 1;
+  int ncols;
+  while ( (ncols = mdout.GetColumns(SEP)) != -1 ) {
+    res.nlines++;
+    res.ncols += ncols;
+    if (ncols > 1 && mdout.Token(0) == "NSTEP")
+      res.nstep += atol( mdout.Token(1).c_str() );
+  }
+  mdout.Close();
+  return 0;
+}
+
+/** Split lines with GetSpans(), reading via buffer or memory map. */
+static int ParseSpans(const char* fname, bool mapped, Result& res) {
+  TextFile mdout;
+  if (mapped) {
+    if (mdout.OpenMapped( fname )) return 1;
+  } else {
+    if (mdout.OpenRead( fname )) return 1;
+  }
+  int ncols;
+  while ( (ncols = mdout.GetSpans(SEP)) != -1 ) {
+    res.nlines++;
+    res.ncols += ncols;
+    if (ncols > 1 && mdout.SpanToken(0) == "NSTEP")
+      res.nstep += mdout.SpanToken(1).Int();
+  }
+  mdout.Close();
+  return 0;
+}
+
+/** Usage: MdoutBench <mdout> [<passes>] */
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <mdout> [<passes>]\n", argv[0]);
+    return 1;
+  }
+  const char* fname = argv[1];
+  int npasses = 3;
+  if (argc > 2) npasses = atoi( argv[2] );
+  if (npasses < 1) npasses = 1;
+  TextFile sizeFile;
+  if (sizeFile.OpenRead( fname )) return 1;
+  double mbytes = (double)sizeFile.Size() / (1024.0 * 1024.0);
+  sizeFile.Close();
+
+  static const int NMODES = 4;
+  const char* names[NMODES] = { "fgets/strtok", "GetColumns", "GetSpans", "GetSpans (mapped)" };
+  double best[NMODES];
+  Result results[NMODES];
+  // Passes alternate between modes so the page cache state is the same for each.
+  for (int pass = 0; pass != npasses; pass++) {
+    for (int mode = 0; mode != NMODES; mode++) {
+      Result res;
+      double t0 = WallTime();
+      int err;
+      if (mode == 0)
+        err = ParseStrtok( fname, res );
+      else if (mode == 1)
+        err = ParseColumns( fname, res );
+      else
+        err = ParseSpans( fname, (mode == 3), res );
+      double elapsed = WallTime() - t0;
+      if (err) return 1;
+      if (pass == 0 || elapsed < best[mode]) best[mode] = elapsed;
+      results[mode] = res;
+    }
+  }
+
+  printf("%s: %.1f MB, %li lines, best of %i passes.\n", fname, mbytes, results[0].nlines, npasses);
+  printf("%-20s %10s %10s %10s\n", "Reader", "Time(s)", "MB/s", "Speedup");
+  int err = 0;
+  for (int mode = 0; mode != NMODES; mode++) {
+    printf("%-20s %10.3f %10.1f %9.2fx\n", names[mode], best[mode],
+           mbytes / best[mode], best[0] / best[mode]);
+    if (results[mode].nlines != results[0].nlines || results[mode].ncols != results[0].ncols ||
+        results[mode].nstep != results[0].nstep)
+    {
+      fprintf(stderr, "Error: %s read %li lines, %li columns, NSTEP sum %li; expected %li, %li, %li.\n",
+              names[mode], results[mode].nlines, results[mode].ncols, results[mode].nstep,
+              results[0].nlines, results[0].ncols, results[0].nstep);
+      err = 1;
+    }
+  }
+  return err;
+}
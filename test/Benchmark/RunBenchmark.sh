@@ -0,0 +1,410 @@
+#!/bin/bash
+
+# Generate a synthetic M-REMD project and time CreateRemdDirs on it.
+# Creation of all runs, checking all replicas (first without, then with the
+# check cache), and test-mode job submission are each timed; wall time, peak
+# resident set size (from GNU time), and the number of read/write calls (or of
+# all system calls, with strace) are reported.
+
+BIN=../../bin/CreateRemdDirs
+NRUNS=4       # Number of runs
+NREPS=8       # Replicas in each dimension
+NDIMS=2       # Number of dimensions; total replicas is NREPS^NDIMS
+NATOMS=2000   # Atoms in trajectories and restarts
+NFRAMES=100   # Trajectory frames (exchanges) per run
+NTHREADS=1    # Threads for checking
+USE_STRACE=0
+KEEP=0
+WORKDIR=bench.proj
+
+Help() {
+  echo "Usage: RunBenchmark.sh [-n <runs>] [-r <reps/dim>] [-d <dims>] [-a <atoms>]"
+  echo "                       [-f <frames>] [-t <check threads>] [-w <dir>] [-S] [-k]"
+  echo "  -n <runs>     : Number of runs (default $NRUNS)."
+  echo "  -r <reps/dim> : Replicas in each dimension (default $NREPS)."
+  echo "  -d <dims>     : Number of dimensions (default $NDIMS). The first is temperature,"
+  echo "                  the second Hamiltonian, and the rest aMD dihedral boost."
+  echo "  -a <atoms>    : Atoms in each trajectory frame and restart (default $NATOMS)."
+  echo "  -f <frames>   : Trajectory frames (exchanges) per run (default $NFRAMES)."
+  echo "  -t <threads>  : Number of check threads (default $NTHREADS)."
+  echo "  -w <dir>      : Directory to generate the project in (default $WORKDIR)."
+  echo "  -S            : Count all system calls with strace (slows timings)."
+  echo "  -k            : Keep the generated project."
+}
+
+while [ ! -z "$1" ] ; do
+  case "$1" in
+    "-n" ) shift ; NRUNS=$1 ;;
+    "-r" ) shift ; NREPS=$1 ;;
+    "-d" ) shift ; NDIMS=$1 ;;
+    "-a" ) shift ; NATOMS=$1 ;;
+    "-f" ) shift ; NFRAMES=$1 ;;
+    "-t" ) shift ; NTHREADS=$1 ;;
+    "-w" ) shift ; WORKDIR=$1 ;;
+    "-S" ) USE_STRACE=1 ;;
+    "-k" ) KEEP=1 ;;
+    "-h" | "--help" ) Help ; exit 0 ;;
+    * ) echo "Error: Unrecognized option '$1'" >&2 ; Help ; exit 1 ;;
+  esac
+  shift
+done
+
+if [ ! -f "$BIN" ] ; then
+  echo "Error: $BIN not found; run 'make install' first." >&2
+  exit 1
+fi
+BIN=`cd \`dirname $BIN\` && pwd`/`basename $BIN`
+# GNU time reports peak RSS; the shell builtin does not.
+TIMEBIN=""
+if [ -x /usr/bin/time ] && /usr/bin/time -f %M -o /dev/null true > /dev/null 2>&1 ; then
+  TIMEBIN=/usr/bin/time
+else
+  echo "Warning: GNU time (/usr/bin/time) not found; peak RSS will not be reported." >&2
+fi
+if [ $USE_STRACE -eq 1 ] && ! type strace > /dev/null 2>&1 ; then
+  echo "Error: strace not found." >&2
+  exit 1
+fi
+if [ $NRUNS -lt 1 -o $NREPS -lt 2 -o $NDIMS -lt 1 -o $NATOMS -lt 1 -o $NFRAMES -lt 1 ] ; then
+  echo "Error: Bad benchmark size." >&2
+  exit 1
+fi
+NTOTAL=1
+for ((d = 0; d < NDIMS; d++)) ; do
+  NTOTAL=$((NTOTAL * NREPS))
+done
+# Replica and run numbering follow CreateRemdDirs: at least 3 digits.
+REPWIDTH=${#NTOTAL}
+if [ $REPWIDTH -lt 3 ] ; then REPWIDTH=3 ; fi
+RUNWIDTH=$(( ${#NRUNS} > 3 ? ${#NRUNS} : 3 ))
+
+# MD settings. One frame is written per exchange, 1 ps apart.
+NSTLIM=500
+DT=0.002
+NTWX=500
+
+# ------------------------------------------------------------------------------
+# Binary output helpers.
+
+# Be32 <value>: Print 4-byte big endian integer as printf escapes.
+Be32() {
+  printf '\\x%02x\\x%02x\\x%02x\\x%02x' $((($1 >> 24) & 255)) $((($1 >> 16) & 255)) \
+                                        $((($1 >> 8) & 255)) $(($1 & 255))
+}
+
+# NcName <name>: Print NetCDF name (length + padded characters).
+NcName() {
+  local len=${#1}
+  Be32 $len
+  printf '%s' "$1"
+  while [ $((len % 4)) -ne 0 ] ; do
+    printf '\\x00'
+    len=$((len + 1))
+  done
+}
+
+# NcText <name> <text>: Print NetCDF character attribute.
+NcText() {
+  NcName "$1"
+  Be32 2
+  NcName "$2"
+}
+
+# FloatBits <n>: Print bits of the IEEE single precision float for integer 0 < n < 2^24.
+FloatBits() {
+  local e=0
+  while [ $((1 << (e + 1))) -le $1 ] ; do
+    e=$((e + 1))
+  done
+  echo $(( ((127 + e) << 23) | (($1 - (1 << e)) << (23 - e)) ))
+}
+
+# NcHeader <frames> <time begin> <coords begin>: Print Amber NetCDF trajectory
+# header (CDF-1) as printf escapes.
+NcHeader() {
+  printf 'CDF\\x01'
+  Be32 $1
+  # Dimensions
+  Be32 10
+  Be32 3
+  NcName frame ; Be32 0
+  NcName spatial ; Be32 3
+  NcName atom ; Be32 $NATOMS
+  # Global attributes
+  Be32 12
+  Be32 2
+  NcText Conventions AMBER
+  NcText ConventionVersion 1.0
+  # Variables: time(frame), coordinates(frame, atom, spatial)
+  Be32 11
+  Be32 2
+  NcName time ; Be32 1 ; Be32 0
+  Be32 12 ; Be32 1 ; NcText units picosecond
+  Be32 5 ; Be32 4 ; Be32 $2
+  NcName coordinates ; Be32 3 ; Be32 0 ; Be32 2 ; Be32 1
+  Be32 12 ; Be32 1 ; NcText units angstrom
+  Be32 5 ; Be32 $((NATOMS * 12)) ; Be32 $3
+}
+
+# WriteTraj <file> <first time>: Write trajectory with NFRAMES frames. Only
+# frame times are written; coordinates are left as sparse zeros.
+WriteTraj() {
+  local hsize recsize f
+  printf "`NcHeader $NFRAMES 0 0`" > $1
+  hsize=`stat -c %s $1`
+  printf "`NcHeader $NFRAMES $hsize $((hsize + 4))`" > $1
+  recsize=$((4 + NATOMS * 12))
+  truncate -s $((hsize + NFRAMES * recsize)) $1
+  for ((f = 0; f < NFRAMES; f++)) ; do
+    printf "`Be32 \`FloatBits $(($2 + f))\``" | \
+      dd of=$1 bs=1 seek=$((hsize + f * recsize)) conv=notrunc status=none
+  done
+}
+
+# WriteRestart <file> <time>: Write ASCII restart with coordinates and velocities.
+WriteRestart() {
+  awk -v natom=$NATOMS -v time=$2 'BEGIN{
+    printf("Benchmark restart\n%6i%15.7e\n", natom, time);
+    n = 0;
+    for (v = 0; v < 2; v++) {
+      for (i = 0; i < natom; i++) {
+        if (v == 0) {
+          x = (i % 20) * 3.0; y = (int(i / 20) % 20) * 3.0; z = int(i / 400) * 3.0;
+        } else {
+          x = 0.1; y = -0.1; z = 0.05;
+        }
+        printf("%12.7f%12.7f%12.7f", x, y, z);
+        if (++n % 2 == 0) printf("\n");
+      }
+    }
+    if (n % 2 != 0) printf("\n");
+  }' > $1
+}
+
+# WriteMdout <file> <first time>: Write completed MD output.
+WriteMdout() {
+  {
+    cat <<EOF
+
+          -------------------------------------------------------
+          Amber 20 PMEMD                              2020
+          -------------------------------------------------------
+
+--------------------------------------------------------------------------------
+   2.  CONTROL  DATA  FOR  THE  RUN
+--------------------------------------------------------------------------------
+
+Nature and format of output:
+     ntxo    =       1, ntpr    =     $NTWX, ntrx    =       1, ntwr    =   $NSTLIM
+     iwrap   =       0, ntwx    =     $NTWX, ntwv    =       0, ntwe    =       0
+     ioutfm  =       1, ntwprt  =       0, idecomp =       0, rbornstat=      0
+
+Molecular dynamics:
+     nstlim  =       $NSTLIM, nscm    =      1000, nrespa  =         1
+     t       =   0.00000, dt      =   $DT, vlimit  =  -1.00000
+
+Replica exchange
+     numexchg=       $NFRAMES, rem=       3
+
+--------------------------------------------------------------------------------
+   3.  ATOMIC COORDINATES AND VELOCITIES
+--------------------------------------------------------------------------------
+
+--------------------------------------------------------------------------------
+   4.  RESULTS
+--------------------------------------------------------------------------------
+
+EOF
+    awk -v nframes=$NFRAMES -v t0=$2 -v nstlim=$NSTLIM 'BEGIN{
+      for (f = 1; f <= nframes; f++) {
+        printf(" NSTEP = %8i   TIME(PS) = %11.3f  TEMP(K) =   300.00  PRESS =     0.0\n", f * nstlim, t0 + f - 1);
+        printf(" Etot   =     -9999.9999  EKtot   =      2500.0000  EPtot      =    -12499.9999\n");
+        printf(" ------------------------------------------------------------------------------\n\n");
+      }
+    }'
+    cat <<EOF
+--------------------------------------------------------------------------------
+   5.  TIMINGS
+--------------------------------------------------------------------------------
+
+|  NonSetup CPU Time in Major Routines:
+|
+|     Routine           Sec        %
+|     ------------------------------
+|     Nonbond          40.00   80.00
+|     Other            10.00   20.00
+|     ------------------------------
+|     Total            50.00
+|
+|  Final Performance Info:
+|     -----------------------------------------------------
+|     Average timings for all steps:
+|         Elapsed(s) =      50.00 Per Step(ms) =       1.00
+|             ns/day =     172.80   seconds/ns =     500.00
+|     -----------------------------------------------------
+|
+|  Setup CPU time:            0.10 seconds
+|  NonSetup CPU time:        50.00 seconds
+|  Total CPU time:           50.10 seconds     0.01 hours
+|
+|  Setup wall time:           0    seconds
+|  NonSetup wall time:       50    seconds
+|  Total wall time:          50    seconds     0.01 hours
+EOF
+  } > $1
+}
+
+# ------------------------------------------------------------------------------
+# Measure <label> <command...>: Run command in project directory, recording
+# wall time, peak RSS, and system calls. Peak RSS is the maximum resident set
+# size reported by GNU time (%M). Without strace only read and write calls are
+# counted (syscr + syscw from /proc/<pid>/io of a subshell, which includes its
+# reaped children).
+Measure() {
+  local label="$1"
+  shift
+  local log="$LOGDIR/$label.log"
+  local statfile="$LOGDIR/$label.stat"
+  local rssfile="$LOGDIR/$label.rss"
+  local t0 t1 stat nsys rss
+  local timecmd=""
+  if [ ! -z "$TIMEBIN" ] ; then timecmd="$TIMEBIN -f %M -o $rssfile" ; fi
+  rm -f $statfile $rssfile
+  t0=`date +%s%N`
+  (
+    # Sets NIO to read + write calls of this shell and its reaped children.
+    ReadIO() {
+      local key val
+      NIO=0
+      while read key val ; do
+        if [ "$key" = "syscr:" -o "$key" = "syscw:" ] ; then NIO=$((NIO + val)) ; fi
+      done < /proc/$BASHPID/io
+    }
+    ReadIO
+    io0=$NIO
+    if [ $USE_STRACE -eq 1 ] ; then
+      strace -f -c -o $LOGDIR/$label.strace $timecmd "$@" > $log 2>&1
+    else
+      $timecmd "$@" > $log 2>&1
+    fi
+    stat=$?
+    ReadIO
+    echo "$stat $((NIO - io0))" > $statfile
+  )
+  t1=`date +%s%N`
+  read stat nsys < $statfile
+  if [ $USE_STRACE -eq 1 ] ; then
+    nsys=`awk '/^-----/{sep++; next} sep == 1 && NF >= 5 {n += $4} END{print n}' $LOGDIR/$label.strace`
+  fi
+  rss="n/a"
+  if [ -s $rssfile ] ; then rss=`tail -n 1 $rssfile` ; fi
+  printf "%-22s %10.3f %12s %12s" "$label" `echo $t0 $t1 | awk '{printf("%.3f", ($2 - $1) / 1e9)}'` $rss $nsys
+  if [ $stat -ne 0 ] ; then
+    printf "  (exit %i, see %s)" $stat $log
+    ERRORS=$((ERRORS + 1))
+  fi
+  printf "\n"
+}
+
+# ------------------------------------------------------------------------------
+if [ -e "$WORKDIR" ] ; then
+  echo "Error: '$WORKDIR' exists; remove it first." >&2
+  exit 1
+fi
+mkdir -p $WORKDIR
+TOP=`cd $WORKDIR && pwd`
+LOGDIR=$TOP/logs
+mkdir $LOGDIR
+cp ../full.parm7 $TOP/
+
+echo "Generating $NRUNS runs x $NTOTAL replicas ($NDIMS dims x $NREPS), $NATOMS atoms, $NFRAMES frames/run in '$WORKDIR'"
+{
+  echo "#Temperature"
+  awk -v n=$NREPS 'BEGIN{for (i = 0; i < n; i++) printf("%.2f\n", 300.0 * exp(log(400.0 / 300.0) * i / (n - 1)));}'
+} > $TOP/Temperatures.dat
+{
+  echo "NSTLIM      $NSTLIM"
+  echo "DT          $DT"
+  echo "NUMEXCHG    $NFRAMES"
+  echo "CRD_FILE    ../start.rst7"
+  echo "DIMENSION   Temperatures.dat"
+  if [ $NDIMS -eq 1 ] ; then
+    echo "TOPOLOGY    ../full.parm7"
+  fi
+} > $TOP/bench.opts
+if [ $NDIMS -gt 1 ] ; then
+  {
+    echo "#Hamiltonian"
+    for ((i = 0; i < NREPS; i++)) ; do
+      echo "../full.parm7"
+    done
+  } > $TOP/Hamiltonians.dat
+  echo "DIMENSION   Hamiltonians.dat" >> $TOP/bench.opts
+fi
+for ((d = 2; d < NDIMS; d++)) ; do
+  {
+    echo "#amd_dihedral"
+    for ((i = 0; i < NREPS; i++)) ; do
+      echo "$((i * 10)).0 $((100 + d)).0"
+    done
+  } > $TOP/AmdDihedral.$d.dat
+  echo "DIMENSION   AmdDihedral.$d.dat" >> $TOP/bench.opts
+done
+WriteRestart $TOP/start.rst7 0.0
+cat > $TOP/qsub.opts <<EOF
+JOBNAME bench
+NODES 1
+PPN $NTOTAL
+WALLTIME 24:00:00
+PROGRAM pmemd.MPI
+QSUB SBATCH
+MPIRUN mpiexec -n \$THREADS
+EOF
+
+ERRORS=0
+cd $TOP
+printf "%-22s %10s %12s %12s\n" "Phase" "Wall(s)" "PeakRSS(kB)" \
+       `if [ $USE_STRACE -eq 1 ] ; then echo "Syscalls" ; else echo "RWCalls" ; fi`
+Measure create $BIN -i bench.opts -b 0 -e $((NRUNS - 1)) -O --nomdin
+
+# Output of each run is the same for every replica.
+for ((run = 0; run < NRUNS; run++)) ; do
+  RDIR=`printf "run.%0${RUNWIDTH}i" $run`
+  if [ ! -d $RDIR ] ; then
+    echo "Error: $RDIR was not created; see $LOGDIR/create.log" >&2
+    exit 1
+  fi
+  T0=$((run * NFRAMES + 1))
+  mkdir -p $RDIR/OUTPUT $RDIR/TRAJ $RDIR/RST
+  WriteMdout $LOGDIR/rem.out $T0
+  WriteTraj $LOGDIR/rem.crd $T0
+  WriteRestart $LOGDIR/rem.rst7 $((T0 + NFRAMES - 1)).0
+  for ((rep = 1; rep <= NTOTAL; rep++)) ; do
+    EXT=`printf "%0${REPWIDTH}i" $rep`
+    cp $LOGDIR/rem.out $RDIR/OUTPUT/rem.out.$EXT
+    cp --sparse=always $LOGDIR/rem.crd $RDIR/TRAJ/rem.crd.$EXT
+    cp $LOGDIR/rem.rst7 $RDIR/RST/$EXT.rst7
+  done
+done
+rm -f $LOGDIR/rem.out $LOGDIR/rem.crd $LOGDIR/rem.rst7
+echo "Project size: `du -sh --apparent-size . | awk '{print $1}'`" \
+     "(`du -sh . | awk '{print $1}'` on disk)"
+
+Measure check.cold $BIN -b 0 -e $((NRUNS - 1)) --check --checkall --check-threads $NTHREADS
+Measure check.cached $BIN -b 0 -e $((NRUNS - 1)) --check --checkall --check-threads $NTHREADS
+Measure submit.test $BIN -b 0 -e $((NRUNS - 1)) --submit -t
+
+if [ $USE_STRACE -eq 0 ] ; then
+  echo "RWCalls counts only read and write calls (syscr + syscw); use -S to count all system calls."
+fi
+cd - > /dev/null
+if [ $KEEP -eq 0 ] ; then
+  rm -rf $WORKDIR
+else
+  echo "Project kept in '$WORKDIR'; logs are in '$WORKDIR/logs'."
+fi
+if [ $ERRORS -gt 0 ] ; then
+  echo "$ERRORS benchmark phases failed."
+  exit 1
+fi
+exit 0
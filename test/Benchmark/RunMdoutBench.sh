@@ -0,0 +1,82 @@
+#!/bin/bash
+
+# Generate a large synthetic Amber MD output file and time splitting every
+# line of it into columns with the TextFile readers (see MdoutBench.cpp).
+
+SIZE=500         # Size of generated MD output (MB)
+NPASSES=3        # Timed passes over the file for each reader
+MDOUT=bench.mdout
+KEEP=0
+
+Help() {
+  echo "Usage: RunMdoutBench.sh [-s <MB>] [-p <passes>] [-o <file>] [-k]"
+  echo "  -s <MB>     : Size of generated MD output in MB (default $SIZE)."
+  echo "  -p <passes> : Timed passes for each reader; best is kept (default $NPASSES)."
+  echo "  -o <file>   : MD output file to generate (default $MDOUT)."
+  echo "  -k          : Keep the generated MD output."
+}
+
+while [ ! -z "$1" ] ; do
+  case "$1" in
+    "-s" ) shift ; SIZE=$1 ;;
+    "-p" ) shift ; NPASSES=$1 ;;
+    "-o" ) shift ; MDOUT=$1 ;;
+    "-k" ) KEEP=1 ;;
+    "-h" | "--help" ) Help ; exit 0 ;;
+    * ) echo "Error: Unrecognized option '$1'" >&2 ; Help ; exit 1 ;;
+  esac
+  shift
+done
+
+if [ $SIZE -lt 1 -o $NPASSES -lt 1 ] ; then
+  echo "Error: Bad benchmark size." >&2
+  exit 1
+fi
+if [ -e "$MDOUT" ] ; then
+  echo "Error: '$MDOUT' exists; remove it first." >&2
+  exit 1
+fi
+make -s MdoutBench || exit 1
+
+# Energy records in the format written by pmemd every ntpr steps, followed by
+# averages and timings as in a completed run.
+echo "Generating $SIZE MB MD output in '$MDOUT'"
+awk -v nbytes=$((SIZE * 1024 * 1024)) 'BEGIN{
+  printf("\n          -------------------------------------------------------\n");
+  printf("          Amber 20 PMEMD                              2020\n");
+  printf("          -------------------------------------------------------\n\n");
+  printf("--------------------------------------------------------------------------------\n");
+  printf("   4.  RESULTS\n");
+  printf("--------------------------------------------------------------------------------\n\n");
+  total = 0;
+  for (n = 1; total < nbytes; n++) {
+    t = 300.0 + (n % 17) * 0.31;
+    rec = sprintf(" NSTEP = %8i   TIME(PS) = %11.3f  TEMP(K) = %8.2f  PRESS = %8.1f\n" \
+                  " Etot   = %14.4f  EKtot   = %14.4f  EPtot      = %14.4f\n" \
+                  " BOND   = %14.4f  ANGLE   = %14.4f  DIHED      = %14.4f\n" \
+                  " 1-4 NB = %14.4f  1-4 EEL = %14.4f  VDWAALS    = %14.4f\n" \
+                  " EELEC  = %14.4f  EHBOND  = %14.4f  RESTRAINT  = %14.4f\n" \
+                  " EKCMT  = %14.4f  VIRIAL  = %14.4f  VOLUME     = %14.4f\n" \
+                  "                                                    Density    = %14.4f\n" \
+                  " ------------------------------------------------------------------------------\n\n",
+                  n * 500, n * 1.0, t, -12.5 + (n % 7),
+                  -56000.0 + n % 101, 10400.0 + t, -66400.0 - n % 101,
+                  310.2, 830.5, 1020.7, 360.1, 4420.3, 7900.8,
+                  -80933.9, 0.0, 0.0, 4550.2, 4560.1, 195000.5, 1.0123);
+    printf("%s", rec);
+    total += length(rec);
+  }
+  printf("--------------------------------------------------------------------------------\n");
+  printf("   5.  TIMINGS\n");
+  printf("--------------------------------------------------------------------------------\n\n");
+  printf("|  Total wall time:        1000    seconds     0.28 hours\n");
+}' > $MDOUT
+
+./MdoutBench $MDOUT $NPASSES
+STATUS=$?
+if [ $KEEP -eq 0 ] ; then
+  rm -f $MDOUT
+else
+  echo "MD output kept in '$MDOUT'."
+fi
+exit $STATUS
@@ -30,6 +30,21 @@ RunTest() {
   fi
 }
 
+# Like RunTest, but the program is expected to exit with an error.
+RunFailTest() {
+  if [[ -z $OPTLINE ]] ; then
+    echo "Error: OPTLINE not set" > /dev/stderr
+    exit 1
+  fi
+  echo "  Test: $1"
+  echo "  Test: $1" >> $TEST_RESULTS
+  $VALGRIND $BIN $OPTLINE >> $OUTPUT 2>> $ERROR
+  if [[ $? -eq 0 ]] ; then
+    echo "Program did not exit with an error." > $TEST_ERROR
+    exit 1
+  fi
+}
+
 DoTest() {
   ((NUMTEST++))
   if [[ ! -f "$1" ]] ; then
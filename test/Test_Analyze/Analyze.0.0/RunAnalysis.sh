@@ -0,0 +1,13 @@
+#!/bin/bash
+
+# Run executable
+TIME0=`date +%s`
+$MPIRUN $EXEPATH -i batch.cpptraj.in
+if [[ $? -ne 0 ]] ; then
+  echo "CPPTRAJ error."
+  exit 1
+fi
+TIME1=`date +%s`
+((TOTAL = $TIME1 - $TIME0))
+echo "$TOTAL seconds."
+exit 0
@@ -0,0 +1,163 @@
+#!/bin/bash
+
+TOTALTIME0=`date +%s`
+# Number of runs to archive at once, and threads for each.
+if [[ -z $ARCHIVE_JOBS ]] ; then
+  ARCHIVE_JOBS=1
+fi
+if [[ -z $ARCHIVE_THREADS ]] ; then
+  ARCHIVE_THREADS=1
+fi
+# Compress with pigz (parallel gzip) if available. Set ARCHIVE_COMPRESS=zstd
+# to use multithreaded zstd instead.
+EXT=tgz
+if [[ $ARCHIVE_COMPRESS = 'zstd' ]] ; then
+  EXT=tar.zst
+  COMPRESS="zstd -q -T$ARCHIVE_THREADS"
+elif [[ ! -z `which pigz 2> /dev/null` ]] ; then
+  COMPRESS="pigz -p $ARCHIVE_THREADS"
+else
+  COMPRESS=gzip
+fi
+# For gzip archives, have CreateRemdDirs (from PATH unless CREATEREMDDIRS is
+# set) walk each run once and compress in-process (--archive-exec). Set
+# CREATEREMDDIRS=none to use tar instead.
+if [[ -z $CREATEREMDDIRS ]] ; then
+  CREATEREMDDIRS=`command -v CreateRemdDirs`
+fi
+if [[ $EXT != 'tgz' || ! -x $CREATEREMDDIRS ]] ; then
+  CREATEREMDDIRS=
+fi
+
+# Archive <archive> <files>: Create compressed tar archive.
+Archive() {
+  TARFILE=$1
+  shift
+  echo "tar -cvf - | $COMPRESS > $TARFILE"
+  tar -cvf - $* | $COMPRESS > $TARFILE
+  if [[ ${PIPESTATUS[0]} -ne 0 || ${PIPESTATUS[1]} -ne 0 ]] ; then
+    echo "Error: Could not create $TARFILE" >> /dev/stderr
+    return 1
+  fi
+  return 0
+}
+
+# NextArchive <prefix>: Print <prefix>.$EXT, or <prefix>.<#>.$EXT with the
+# lowest # that does not exist yet, so earlier archives are never replaced.
+NextArchive() {
+  NAME=$1.$EXT
+  N=1
+  while [[ -e $NAME ]] ; do
+    NAME=$1.$N.$EXT
+    ((N++))
+  done
+  echo $NAME
+}
+
+# ArchiveRun <dir> <run #>: Archive the given run.
+ArchiveRun() {
+  DIR=$1
+  RUN=$2
+  TIME0=`date +%s`
+  if [[ -z $CREATEREMDDIRS ]] ; then
+    # Put everything but trajectories into a separate archive.
+    FILELIST=
+    for FILE in `find $DIR -name "*"` ; do
+      if [[ ! -d $FILE ]] ; then
+        if [[ `echo "$FILE" | awk '{print index($0,"TRAJ");}'` -eq 0 ]] ; then
+          # Not a TRAJ directory file
+          FILELIST=$FILELIST" $FILE"
+        fi
+      fi
+    done
+    Archive `NextArchive $DIR` $FILELIST || return 1
+  fi
+  TRAJCURRENT=0
+  if [[ ! -z $CREATEREMDDIRS ]] ; then
+    $CREATEREMDDIRS --archive-current $DIR && TRAJCURRENT=1
+  fi
+  if [[ $TRAJCURRENT -eq 0 ]] ; then
+    # Sort and save the unbiased fully-solvated trajs
+    cd Archive.0.0
+    $MPIRUN $EXEPATH -i ar1.$RUN.cpptraj.in
+    if [[ $? -ne 0 ]] ; then
+      echo "CPPTRAJ error."
+      return 1
+    fi
+    cd ..
+    FILELIST=`ls $DIR/TRAJ/wat.nc.*`
+    if [[ -z $FILELIST ]] ; then
+      echo "Error: Sorted solvated trajectories not found." >> /dev/stderr
+      return 1
+    fi
+    # Save all of the stripped trajs.
+    cd Archive.0.0
+    $MPIRUN $EXEPATH -i ar2.$RUN.cpptraj.in
+    if [[ $? -ne 0 ]] ; then
+      echo "CPPTRAJ error."
+      return 1
+    fi
+    cd ..
+  fi
+  if [[ -z $CREATEREMDDIRS ]] ; then
+    for OUTTRAJ in `ls $DIR/TRAJ/nowat.nc.*` ; do
+      FILELIST=$FILELIST" $OUTTRAJ"
+    done
+    TRAJTAR=`NextArchive Archive.0.0/traj.$DIR`
+    Archive $TRAJTAR $FILELIST || return 1
+    echo "$TRAJTAR" > Archive.0.0/archive.$DIR.trajs
+  else
+    # New/changed files only: everything but trajectories, then
+    # sorted/stripped trajectories.
+    $CREATEREMDDIRS --archive-exec $DIR Archive.0.0 || return 1
+  fi
+  TIME1=`date +%s`
+  ((TOTAL = $TIME1 - $TIME0))
+  echo "$DIR took $TOTAL seconds to archive."
+  return 0
+}
+
+# Each run is archived in the background with output to a log. Jobs are
+# finished in run order so output and TrajArchives.txt are in run order.
+PIDS=()
+DIRS=()
+ERR=0
+# FinishJob: Wait for the oldest job, print its output, and record the
+# trajectory archives it wrote.
+FinishJob() {
+  wait ${PIDS[0]}
+  JOBERR=$?
+  cat Archive.0.0/archive.${DIRS[0]}.log
+  rm Archive.0.0/archive.${DIRS[0]}.log
+  if [[ $JOBERR -eq 0 ]] ; then
+    cat Archive.0.0/archive.${DIRS[0]}.trajs >> TrajArchives.txt
+  else
+    echo "Error: Archiving ${DIRS[0]} failed." >> /dev/stderr
+    ERR=1
+  fi
+  rm -f Archive.0.0/archive.${DIRS[0]}.trajs
+  echo "--------------------------------------------------------------"
+  PIDS=(${PIDS[@]:1})
+  DIRS=(${DIRS[@]:1})
+}
+RUN=0
+for DIR in run.000 ; do
+  # Do not start any more runs after an error.
+  if [[ $ERR -ne 0 ]] ; then
+    break
+  fi
+  ArchiveRun $DIR $RUN > Archive.0.0/archive.$DIR.log 2>&1 &
+  PIDS+=($!)
+  DIRS+=($DIR)
+  if [[ ${#PIDS[@]} -ge $ARCHIVE_JOBS ]] ; then
+    FinishJob
+  fi
+  ((RUN++))
+done
+while [[ ${#PIDS[@]} -gt 0 ]] ; do
+  FinishJob
+done
+TOTALTIME1=`date +%s`
+((TOTAL = $TOTALTIME1 - $TOTALTIME0))
+echo "$TOTAL seconds total."
+exit $ERR
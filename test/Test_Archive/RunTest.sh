@@ -2,7 +2,9 @@
 
 . ../MasterTest.sh
 
-CleanFiles run.000 Archive.0.0 RunArchive.0.0.sh
+CleanFiles run.000 Archive.0.0 RunArchive.0.0.sh \
+           run.000.tgz run.000.1.tgz .remdarchive archive.list incremental.list \
+           manifest.out
 
 mkdir -p run.000/TRAJ
 touch run.000/TRAJ/rem.crd.001
@@ -13,4 +15,32 @@ DoTest ar1.0.cpptraj.in.save Archive.0.0/ar1.0.cpptraj.in
 DoTest ar2.0.cpptraj.in.save Archive.0.0/ar2.0.cpptraj.in
 DoTest RunArchive.0.0.sh.save RunArchive.0.0.sh
 
+mkdir -p run.000/INPUT run.000/OUTPUT
+echo "input" > run.000/INPUT/in.001
+echo "output" > run.000/OUTPUT/rem.out.001
+echo "log" > run.000/rem.log
+echo "solvated" > run.000/TRAJ/wat.nc.001
+echo "stripped" > run.000/TRAJ/nowat.nc.001
+OPTLINE="--archive-exec run.000 Archive.0.0"
+RunTest "Native run archive test."
+tar -tzf run.000.tgz > archive.list
+tar -tzf Archive.0.0/traj.run.000.tgz >> archive.list
+cat Archive.0.0/archive.run.000.trajs >> archive.list
+DoTest archive.list.save archive.list
+
+OPTLINE="--archive-current run.000"
+RunTest "Archive current test."
+# Only new/changed files are archived again; in.001 is touched but unchanged.
+echo "more output" >> run.000/OUTPUT/rem.out.001
+echo "output" > run.000/OUTPUT/rem.out.002
+touch -t 202001010000 run.000/INPUT/in.001
+OPTLINE="--archive-exec run.000 Archive.0.0"
+RunTest "Incremental run archive test."
+tar -tzf run.000.1.tgz > incremental.list
+cat Archive.0.0/archive.run.000.trajs >> incremental.list
+DoTest incremental.list.save incremental.list
+# Modification times vary; compare name, size, hash, archive.
+awk 'NR > 1 {print $1, $2, $4, $5}' .remdarchive/run.000.manifest > manifest.out
+DoTest manifest.out.save manifest.out
+
 EndTest
@@ -2,16 +2,141 @@
 
 . ../MasterTest.sh
 
-CleanFiles 
+CleanFiles .remdcheck.cache check.err profile.out run.001 run.002 run.003 run.004 run.005 \
+           run.006 run.007 run.008 run.009 continuity.err cache.out
 
 OPTLINE="-b 0 --check"
 RunTest "MD check test."
 TrimTestOutputHeader
 
-if [ $HAS_NETCDF -eq 0 ] ; then
-  DoTest nonetcdf.test.out.save test.out
-else
-  DoTest netcdf.test.out.save test.out
-fi
+DoTest netcdf.test.out.save test.out
+
+# REMD runs with ASCII restarts, made from the MD run files. Trajectory
+# times in run.002 continue from run.001.
+rm -f $OUTPUT
+for RUN in 001 002 ; do
+  mkdir -p run.$RUN/OUTPUT run.$RUN/TRAJ run.$RUN/RST
+  for REP in 001 002 ; do
+    cp run.000/md.out run.$RUN/OUTPUT/rem.out.$REP
+    cp run.000/mdrst.rst7 run.$RUN/RST/$REP.rst7
+  done
+done
+cp run.000/mdcrd.nc run.001/TRAJ/rem.crd.001
+cp run.000/mdcrd.nc run.001/TRAJ/rem.crd.002
+cp mdcrd.continued.nc run.002/TRAJ/rem.crd.001
+cp mdcrd.continued.nc run.002/TRAJ/rem.crd.002
+OPTLINE="-b 1 -e 2 --check --checkall --deepcheck"
+RunTest "REMD deep check/time continuity test, ASCII restarts."
+TrimTestOutputHeader
+
+DoTest remd.ascii.test.out.save test.out
+
+# Watch progress; run.003 replica 2 is still running.
+rm -f $OUTPUT
+mkdir -p run.003/OUTPUT run.003/TRAJ
+cp run.000/md.out run.003/OUTPUT/rem.out.001
+head -n 250 run.000/md.out > run.003/OUTPUT/rem.out.002
+cp run.000/mdcrd.nc run.003/TRAJ/rem.crd.001
+OPTLINE="-b 1 -e 3 --watch --watch-count 1"
+RunTest "Watch progress test."
+TrimTestOutputHeader
+grep -v "^Progress at" $OUTPUT > watch.out
+mv watch.out $OUTPUT
+
+DoTest watch.test.out.save test.out
+
+# Performance report; run.003 replica 2 is now complete but slower.
+rm -f $OUTPUT
+sed -e 's/RunMD             3.88   82.44/RunMD             6.88   88.43/' \
+    -e 's/ns\/day =     365.55/ns\/day =     222.74/' \
+    run.000/md.out > run.003/OUTPUT/rem.out.002
+cp run.000/mdcrd.nc run.003/TRAJ/rem.crd.002
+OPTLINE="-b 3 --check --timings"
+RunTest "Check output timings test."
+TrimTestOutputHeader
+
+DoTest timings.test.out.save test.out
+
+# Machine-readable check results; only records go to stdout.
+rm -f $OUTPUT
+SAVE_ERROR=$ERROR
+ERROR=check.err
+OPTLINE="-b 1 -e 2 --check --checkall --deepcheck --check-format json"
+RunTest "Check results JSON format test."
+DoTest json.test.out.save test.out
+
+rm -f $OUTPUT
+OPTLINE="-b 3 --check --timings --check-format csv"
+RunTest "Check results CSV format test."
+DoTest csv.test.out.save test.out
+ERROR=$SAVE_ERROR
+
+# Profile; times vary so only compare region names and counts.
+rm -f $OUTPUT
+OPTLINE="-b 0 --check --nocheckcache --profile"
+RunTest "Check profile test."
+awk '/^Profile/{p=1; next} p && NF > 1 {print substr($0, 1, 42) $NF}' $OUTPUT > profile.out
+DoTest profile.out.save profile.out
+
+# Exchange statistics for 2D (temperature x Hamiltonian) REMD with 6 replicas.
+rm -f $OUTPUT
+for RUN in 004 005 ; do
+  mkdir -p run.$RUN/OUTPUT run.$RUN/TRAJ
+  for REP in 001 002 003 004 005 006 ; do
+    cp run.000/md.out run.$RUN/OUTPUT/rem.out.$REP
+  done
+  cp remd.dim.exch run.$RUN/remd.dim
+  cp rem.log.$RUN run.$RUN/rem.log
+done
+for REP in 001 002 003 004 005 006 ; do
+  cp run.000/mdcrd.nc run.004/TRAJ/rem.crd.$REP
+  cp mdcrd.continued.nc run.005/TRAJ/rem.crd.$REP
+done
+OPTLINE="-b 4 -e 5 --check --exchange-stats"
+RunTest "Exchange statistics test."
+TrimTestOutputHeader
+
+DoTest exchange.test.out.save test.out
+
+# Runs restarted from the wrong coordinates: run.007 and run.008 reuse the
+# trajectory of run.006. Only the first break for each replica is reported,
+# and the check fails.
+rm -f $OUTPUT
+for RUN in 006 007 008 ; do
+  mkdir -p run.$RUN/OUTPUT run.$RUN/TRAJ
+  for REP in 001 002 ; do
+    cp run.000/md.out run.$RUN/OUTPUT/rem.out.$REP
+    cp run.000/mdcrd.nc run.$RUN/TRAJ/rem.crd.$REP
+  done
+done
+SAVE_ERROR=$ERROR
+ERROR=continuity.err
+OPTLINE="-b 6 -e 8 --check --checkall"
+RunFailTest "Time continuity break test."
+TrimTestOutputHeader
+ERROR=$SAVE_ERROR
+
+DoTest continuity.test.out.save test.out
+DoTest continuity.err.save continuity.err
+
+# Check cache. Unchanged output/trajectory pairs are found in the cache; a
+# change in size or modification time of either file means the pair is
+# checked again. Entries for runs that have been removed are dropped.
+rm -f $OUTPUT .remdcheck.cache
+cp -r run.001 run.009
+OPTLINE="-b 1 -e 2 --check --checkall -d 1"
+RunTest "Check cache new entries test."
+OPTLINE="-b 9 --check --checkall -d 1"
+RunTest "Check cache other run test."
+OPTLINE="-b 1 -e 2 --check --checkall -d 1"
+RunTest "Check cache hit test."
+echo "" >> run.001/OUTPUT/rem.out.002
+touch -t 202001010000 run.002/TRAJ/rem.crd.001
+rm -rf run.009
+OPTLINE="-b 1 -e 2 --check --checkall -d 1"
+RunTest "Check cache invalidation test."
+grep "^Check cache:" $OUTPUT > cache.out
+awk 'NR > 1 {print $1}' .remdcheck.cache >> cache.out
+DoTest cache.out.save cache.out
 
 EndTest
@@ -0,0 +1,10 @@
+#!/bin/bash
+
+# Run executable
+TIME0=`date +%s`
+$MPIRUN $EXEPATH -O -ng 2 -groupfile groupfile -rem 3
+TIME1=`date +%s`
+((TOTAL = $TIME1 - $TIME0))
+echo "$TOTAL seconds."
+
+exit 0
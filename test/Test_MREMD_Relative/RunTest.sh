@@ -2,7 +2,7 @@
 
 . ../MasterTest.sh
 
-CleanFiles run.000 mremd.opts Hamiltonians.dat
+CleanFiles run.000 run.001 run.002 mremd.opts Hamiltonians.dat
 
 OPTLINE="-i ../relative.mremd.opts -b 0 -e 0 -c ../../CRD"
 RunTest "M-REMD relative path test."
@@ -10,4 +10,16 @@ DoTest ../mremd.dim.save run.000/remd.dim
 DoTest relative.groupfile.save run.000/groupfile
 DoTest ../in.001.save run.000/INPUT/in.001
 
+OPTLINE="-i ../relative.mremd.opts -b 0 -e 0 -c ../../CRD -O --create-threads 4"
+RunTest "M-REMD relative path test, multiple threads."
+DoTest ../mremd.dim.save run.000/remd.dim
+DoTest relative.groupfile.save run.000/groupfile
+DoTest ../in.001.save run.000/INPUT/in.001
+
+OPTLINE="-i ../relative.mremd.opts -b 0 -e 2 -c ../../CRD -O"
+RunTest "M-REMD relative path test, multiple runs."
+DoTest ../mremd.dim.save run.002/remd.dim
+DoTest relative.run.002.groupfile.save run.002/groupfile
+DoTest restart.in.001.save run.002/INPUT/in.001
+
 EndTest
@@ -0,0 +1,26 @@
+#!/bin/bash
+
+. ../MasterTest.sh
+
+CleanFiles run.000 run.001 temps.dat rebalance.out
+
+OPTLINE="-i tremd.opts -b 0 -e 0"
+RunTest "T-REMD generated temperature ladder test"
+grep "temp0" run.000/INPUT/in.* > temps.dat
+DoTest temps.dat.save temps.dat
+DoTest groupfile.save run.000/groupfile
+
+# Rebalance temperatures from exchange acceptance in run.000
+cp rem.log.000 run.000/rem.log
+for REP in `seq -f "%03g" 1 14` ; do
+  touch run.000/OUTPUT/rem.out.$REP
+done
+OPTLINE="-i tremd.opts -b 1 -c ../../CRD --rebalance"
+RunTest "T-REMD rebalance temperature ladder test"
+grep "Rebalanc\|predicted" $OUTPUT > rebalance.out
+DoTest rebalance.out.save rebalance.out
+DoTest GenTemps.dat.save run.001/GenTemps.dat
+grep "temp0" run.001/INPUT/in.* > temps.dat
+DoTest rebalance.temps.dat.save temps.dat
+
+EndTest